@@ -0,0 +1,89 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// Counts every allocation made through the global operator new, on any
+// thread, so a frame can check that it did not touch the heap. This replaces
+// operator new and delete, so include it in exactly one translation unit of
+// an executable. Plain malloc (e.g. inside GLU) is not seen.
+
+std::atomic<unsigned long> heapAllocations(0);
+
+// every delete ends in the plain one, kept out of line: inlined into a
+// caller, GCC would see free() on a pointer from operator new and warn
+#ifdef _MSC_VER
+#define ALLOCATION_NOINLINE __declspec(noinline)
+#else
+#define ALLOCATION_NOINLINE __attribute__((noinline))
+#endif
+
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+ALLOCATION_NOINLINE void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    operator delete(p);
+}
+
+inline unsigned long allocationCount() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+// allocations since construction or the last restart()
+class AllocationScope {
+public:
+    AllocationScope() : start(allocationCount()) {}
+
+    unsigned long count() const {
+        return allocationCount() - start;
+    }
+
+    void restart() {
+        start = allocationCount();
+    }
+
+private:
+    unsigned long start;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef ANTI_ALIASING_H
+#define ANTI_ALIASING_H
+
+#include <string.h>
+#include "GLExt.h"
+
+// Anti-aliasing settings for the scene. MSAA draws into a multisampled
+// render target (see SceneTarget) and costs memory bandwidth and fill rate
+// for every sample, which a software rasterizer pays in full; the post
+// filter is one full-screen pass that looks for luminance edges and blurs
+// along them (after FXAA), so its cost does not depend on the scene.
+
+enum AAMode {
+    AA_OFF,
+    AA_MSAA2,
+    AA_MSAA4,
+    AA_POST,
+    AA_MODE_COUNT
+};
+
+const char* const aaModeNames[AA_MODE_COUNT] = { "off", "msaa2", "msaa4", "post" };
+
+inline int aaSamples(AAMode mode) {
+    return mode == AA_MSAA2 ? 2 : mode == AA_MSAA4 ? 4 : 0;
+}
+
+// the mode with this name, or AA_MODE_COUNT
+inline AAMode parseAAMode(const char* name) {
+    for (int i = 0; i < AA_MODE_COUNT; i++) {
+        if (strcmp(name, aaModeNames[i]) == 0)
+            return (AAMode)i;
+    }
+    return AA_MODE_COUNT;
+}
+
+class EdgeFilter {
+public:
+    EdgeFilter() : program(0), failed(false), sceneLocation(-1), texelLocation(-1), limitLocation(-1) {}
+
+    bool supported() const {
+        return ext.shaders;
+    }
+
+    // compiles on first use; false when the driver has no GLSL or rejects it
+    bool ready() {
+        if (program == 0 && !failed)
+            create();
+        return program != 0;
+    }
+
+    // binds the filter for the quad that stretches the scene texture;
+    // width x height is the texture, u x v the part of it that was drawn
+    void begin(int width, int height, float u, float v) {
+        ext.useProgram(program);
+        ext.uniform1i(sceneLocation, 0);
+        ext.uniform2f(texelLocation, 1.0f / width, 1.0f / height);
+        // stop half a texel short so the taps never read the unused part
+        ext.uniform2f(limitLocation, u - 0.5f / width, v - 0.5f / height);
+    }
+
+    void end() {
+        ext.useProgram(0);
+    }
+
+private:
+    GLuint program;
+    bool failed;
+    GLint sceneLocation, texelLocation, limitLocation;
+
+    void create() {
+        static const char* source =
+            "uniform sampler2D scene;\n"
+            "uniform vec2 texel;\n"
+            "uniform vec2 limit;\n"
+            "vec3 tap(vec2 p) {\n"
+            "    return texture2D(scene, clamp(p, vec2(0.0), limit)).rgb;\n"
+            "}\n"
+            "void main() {\n"
+            "    vec2 p = gl_TexCoord[0].xy;\n"
+            "    vec3 luma = vec3(0.299, 0.587, 0.114);\n"
+            "    vec3 m = tap(p);\n"
+            "    float nw = dot(tap(p + vec2(-1.0, -1.0) * texel), luma);\n"
+            "    float ne = dot(tap(p + vec2(1.0, -1.0) * texel), luma);\n"
+            "    float sw = dot(tap(p + vec2(-1.0, 1.0) * texel), luma);\n"
+            "    float se = dot(tap(p + vec2(1.0, 1.0) * texel), luma);\n"
+            "    float lm = dot(m, luma);\n"
+            "    float lowest = min(lm, min(min(nw, ne), min(sw, se)));\n"
+            "    float highest = max(lm, max(max(nw, ne), max(sw, se)));\n"
+            "    if (highest - lowest < max(0.0312, highest * 0.125)) {\n"
+            "        gl_FragColor = vec4(m, 1.0);\n"
+            "        return;\n"
+            "    }\n"
+            "    vec2 dir = vec2((sw + se) - (nw + ne), (nw + sw) - (ne + se));\n"
+            "    float reduce = max((nw + ne + sw + se) * 0.03125, 0.0078125);\n"
+            "    dir = clamp(dir / (min(abs(dir.x), abs(dir.y)) + reduce), vec2(-8.0), vec2(8.0)) * texel;\n"
+            "    vec3 a = 0.5 * (tap(p - dir / 6.0) + tap(p + dir / 6.0));\n"
+            "    vec3 b = 0.5 * a + 0.25 * (tap(p - dir * 0.5) + tap(p + dir * 0.5));\n"
+            "    float lb = dot(b, luma);\n"
+            "    gl_FragColor = vec4(lb < lowest || lb > highest ? a : b, 1.0);\n"
+            "}\n";
+
+        if (!supported()) {
+            failed = true;
+            return;
+        }
+        GLuint shader = ext.createShader(GL_FRAGMENT_SHADER);
+        ext.shaderSource(shader, 1, &source, NULL);
+        ext.compileShader(shader);
+        GLint ok = 0;
+        ext.getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (ok) {
+            program = ext.createProgram();
+            ext.attachShader(program, shader);
+            ext.linkProgram(program);
+            ext.getProgramiv(program, GL_LINK_STATUS, &ok);
+        }
+        ext.deleteShader(shader);
+        if (!ok) {
+            program = 0;
+            failed = true;
+            return;
+        }
+        sceneLocation = ext.getUniformLocation(program, "scene");
+        texelLocation = ext.getUniformLocation(program, "texel");
+        limitLocation = ext.getUniformLocation(program, "limit");
+    }
+};
+
+#endif
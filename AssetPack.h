@@ -0,0 +1,215 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// One file holding everything the game would otherwise generate or decode
+// at startup: the meshes (ParkMeshes.h) and the sounds as ready-to-play WAV
+// images. ParkBake.cpp writes it at build time; the game maps it into memory
+// and hands the mapped bytes straight to GL and PlaySound, so nothing is
+// parsed or copied on the way. Entries are aligned to ASSET_ALIGNMENT from
+// the start of the file, and a pack with another version is ignored, so a
+// stale pack falls back to generating everything.
+
+const unsigned ASSET_PACK_MAGIC = 0x4b415044;   // "DPAK"
+const unsigned ASSET_PACK_VERSION = 1;          // bump whenever an entry's layout or contents change
+const unsigned ASSET_ALIGNMENT = 64;
+const int ASSET_NAME_LENGTH = 24;
+
+struct AssetPackHeader {
+    unsigned magic;
+    unsigned version;
+    unsigned entryCount;
+    unsigned reserved;
+};
+
+struct AssetEntry {
+    char name[ASSET_NAME_LENGTH];   // zero-padded
+    unsigned offset;                // from the start of the file
+    unsigned size;
+};
+
+class AssetPackWriter {
+public:
+    void add(const char* name, const void* data, size_t size) {
+        Item item;
+        item.name = name;
+        item.bytes.assign((const unsigned char*)data, (const unsigned char*)data + size);
+        items.push_back(item);
+    }
+
+    bool save(const char* path) const {
+        AssetPackHeader header = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, (unsigned)items.size(), 0 };
+        std::vector<AssetEntry> entries(items.size());
+        size_t offset = align(sizeof(header) + entries.size() * sizeof(AssetEntry));
+        for (size_t i = 0; i < items.size(); i++) {
+            if (items[i].name.size() >= ASSET_NAME_LENGTH)
+                return false;
+            memset(&entries[i], 0, sizeof(AssetEntry));
+            memcpy(entries[i].name, items[i].name.c_str(), items[i].name.size());
+            entries[i].offset = (unsigned)offset;
+            entries[i].size = (unsigned)items[i].bytes.size();
+            offset = align(offset + items[i].bytes.size());
+        }
+
+        FILE* f = fopen(path, "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+        if (!entries.empty())
+            ok = ok && fwrite(&entries[0], sizeof(AssetEntry), entries.size(), f) == entries.size();
+        for (size_t i = 0; i < items.size() && ok; i++) {
+            ok = pad(f, entries[i].offset);
+            if (!items[i].bytes.empty())
+                ok = ok && fwrite(&items[i].bytes[0], 1, items[i].bytes.size(), f) == items[i].bytes.size();
+        }
+        return fclose(f) == 0 && ok;
+    }
+
+private:
+    struct Item {
+        std::string name;
+        std::vector<unsigned char> bytes;
+    };
+    std::vector<Item> items;
+
+    static size_t align(size_t offset) {
+        return (offset + ASSET_ALIGNMENT - 1) / ASSET_ALIGNMENT * ASSET_ALIGNMENT;
+    }
+
+    static bool pad(FILE* f, long offset) {
+        while (ftell(f) < offset) {
+            if (fputc(0, f) == EOF)
+                return false;
+        }
+        return true;
+    }
+};
+
+class AssetPack {
+public:
+    AssetPack() : base(NULL), length(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+
+    ~AssetPack() {
+        close();
+    }
+
+    // false when the file is missing, damaged or from another version
+    bool open(const char* path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.HighPart == 0) {
+            length = (size_t)size.QuadPart;
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping)
+                base = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            length = (size_t)st.st_size;
+            void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+                base = (const unsigned char*)p;
+        }
+        ::close(fd);    // the mapping keeps the file
+#endif
+        if (!base || !valid()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base)
+            UnmapViewOfFile(base);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        if (base)
+            munmap((void*)base, length);
+#endif
+        base = NULL;
+        length = 0;
+    }
+
+    bool isOpen() const {
+        return base != NULL;
+    }
+
+    size_t fileSize() const {
+        return length;
+    }
+
+    // the entry's bytes inside the mapping, or NULL
+    const void* find(const char* name, size_t* size = NULL) const {
+        if (!base)
+            return NULL;
+        const AssetPackHeader* header = (const AssetPackHeader*)base;
+        const AssetEntry* entries = (const AssetEntry*)(header + 1);
+        for (unsigned i = 0; i < header->entryCount; i++) {
+            if (strncmp(entries[i].name, name, ASSET_NAME_LENGTH) == 0) {
+                if (size)
+                    *size = entries[i].size;
+                return base + entries[i].offset;
+            }
+        }
+        return NULL;
+    }
+
+private:
+    const unsigned char* base;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    bool valid() const {
+        if (length < sizeof(AssetPackHeader))
+            return false;
+        const AssetPackHeader* header = (const AssetPackHeader*)base;
+        if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION)
+            return false;
+        if (header->entryCount > (length - sizeof(AssetPackHeader)) / sizeof(AssetEntry))
+            return false;
+        const AssetEntry* entries = (const AssetEntry*)(header + 1);
+        for (unsigned i = 0; i < header->entryCount; i++) {
+            if (entries[i].offset % ASSET_ALIGNMENT != 0 || entries[i].offset > length || entries[i].size > length - entries[i].offset)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
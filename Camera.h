@@ -0,0 +1,216 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "ParkMath.h"
+
+// The orientation is a unit quaternion (the camera looks down its local -z
+// with +y up), so rotations never let the basis drift out of orthogonality.
+// View, projection, view-projection and the frustum planes are cached and
+// only rebuilt after something changed; revision counts those changes so
+// other code can tell whether the camera moved since it last looked.
+class Camera {
+public:
+    unsigned revision;
+
+    Camera(float eyeX = 0.021192, float eyeY = 0.353662, float eyeZ = 1.06366, float centerX = 0.0163718, float centerY = 0.0163718, float centerZ = 0.0163718, float upX = 0.0f, float upY = 1.0f, float upZ = 0.0f) {
+        revision = 0;
+        transitionTime = transitionDuration = 0.0f;
+        pitchAngle = yawAngle = 0.0f;
+        setPerspective(60, 2, 0.001, 1000);
+        lookAt(Vector3f(eyeX, eyeY, eyeZ), Vector3f(centerX, centerY, centerZ), Vector3f(upX, upY, upZ));
+    }
+
+    Vector3f position() const {
+        return eye;
+    }
+
+    Vector3f forward() const {
+        return orientation.rotate(Vector3f(0.0f, 0.0f, -1.0f));
+    }
+
+    Vector3f right() const {
+        return orientation.rotate(Vector3f(1.0f, 0.0f, 0.0f));
+    }
+
+    Vector3f up() const {
+        return orientation.rotate(Vector3f(0.0f, 1.0f, 0.0f));
+    }
+
+    Vector3f center() const {
+        return eye + forward() * focusDistance;
+    }
+
+    void lookAt(const Vector3f& newEye, const Vector3f& newCenter, const Vector3f& newUp = Vector3f(0.0f, 1.0f, 0.0f)) {
+        Vector3f view = newCenter - newEye;
+        focusDistance = sqrt(view.dot(view));
+        Vector3f f = view / focusDistance;
+        Vector3f s = f.cross(newUp).unit();
+        Vector3f u = s.cross(f);
+        eye = newEye;
+        orientation = Quaternion::fromBasis(s, u, f * -1.0f);
+        changed();
+    }
+
+    void setPerspective(float newFovY, float newAspect, float newNear, float newFar) {
+        fovY = newFovY;
+        aspect = newAspect;
+        zNear = newNear;
+        zFar = newFar;
+        projectionDirty = true;
+        revision++;
+    }
+
+    void setAspect(float newAspect) {
+        setPerspective(fovY, newAspect, zNear, zFar);
+    }
+
+    // moves along up x view, i.e. to the left for positive d
+    void moveX(float d) {
+        cancelTransition();
+        eye = eye - right() * d;
+        changed();
+    }
+
+    void moveY(float d) {
+        cancelTransition();
+        eye = eye + up() * d;
+        changed();
+    }
+
+    void moveZ(float d) {
+        cancelTransition();
+        eye = eye + forward() * d;
+        changed();
+    }
+
+    // pitch about the camera's own x axis, positive looks up
+    void rotateX(float a) {
+        cancelTransition();
+        if (a != pitchAngle) {
+            pitchAngle = a;
+            pitchStep = Quaternion::axisAngle(Vector3f(1.0f, 0.0f, 0.0f), a);
+        }
+        orientation = (orientation * pitchStep).unit();
+        changed();
+    }
+
+    // yaw about the camera's own y axis, positive turns left
+    void rotateY(float a) {
+        cancelTransition();
+        if (a != yawAngle) {
+            yawAngle = a;
+            yawStep = Quaternion::axisAngle(Vector3f(0.0f, 1.0f, 0.0f), a);
+        }
+        orientation = (orientation * yawStep).unit();
+        changed();
+    }
+
+    // eases from the current pose to the given one over duration seconds
+    void transitionTo(const Vector3f& newEye, const Vector3f& newCenter, float duration) {
+        fromEye = eye;
+        fromOrientation = orientation;
+        fromFocus = focusDistance;
+        lookAt(newEye, newCenter);
+        toEye = eye;
+        toOrientation = orientation;
+        toFocus = focusDistance;
+        eye = fromEye;
+        orientation = fromOrientation;
+        focusDistance = fromFocus;
+        transitionTime = 0.0f;
+        transitionDuration = duration;
+        update(0.0f);
+    }
+
+    bool inTransition() const {
+        return transitionTime < transitionDuration;
+    }
+
+    // advances a running transition by dt seconds of simulation time
+    void update(float dt) {
+        if (!inTransition())
+            return;
+        transitionTime += dt;
+        float t = transitionTime >= transitionDuration ? 1.0f : transitionTime / transitionDuration;
+        t = t * t * (3.0f - 2.0f * t);
+        eye = fromEye + (toEye - fromEye) * t;
+        orientation = Quaternion::slerp(fromOrientation, toOrientation, t);
+        focusDistance = fromFocus + (toFocus - fromFocus) * t;
+        changed();
+    }
+
+    void cancelTransition() {
+        transitionDuration = 0.0f;
+    }
+
+    const float* view() {
+        refresh();
+        return viewMatrix;
+    }
+
+    const float* projection() {
+        refresh();
+        return projectionMatrix;
+    }
+
+    const float* viewProjection() {
+        refresh();
+        return viewProjectionMatrix;
+    }
+
+    const Plane* frustum() {
+        refresh();
+        return frustumPlanes;
+    }
+
+    bool sphereVisible(const Vector3f& p, float radius) {
+        refresh();
+        for (int i = 0; i < 6; i++) {
+            if (frustumPlanes[i].distance(p) < -radius)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    Vector3f eye;
+    Quaternion orientation;
+    float focusDistance;
+    float fovY, aspect, zNear, zFar;
+    bool viewDirty, projectionDirty;
+    float viewMatrix[16], projectionMatrix[16], viewProjectionMatrix[16];
+    Plane frustumPlanes[6];
+
+    float pitchAngle, yawAngle;
+    Quaternion pitchStep, yawStep;
+
+    Vector3f fromEye, toEye;
+    Quaternion fromOrientation, toOrientation;
+    float fromFocus, toFocus;
+    float transitionTime, transitionDuration;
+
+    void changed() {
+        viewDirty = true;
+        revision++;
+    }
+
+    void refresh() {
+        if (!viewDirty && !projectionDirty)
+            return;
+        if (viewDirty) {
+            Vector3f s = right(), u = up(), f = forward();
+            float* m = viewMatrix;
+            m[0] = s.x; m[4] = s.y; m[8] = s.z;  m[12] = -s.dot(eye);
+            m[1] = u.x; m[5] = u.y; m[9] = u.z;  m[13] = -u.dot(eye);
+            m[2] = -f.x; m[6] = -f.y; m[10] = -f.z; m[14] = f.dot(eye);
+            m[3] = 0; m[7] = 0; m[11] = 0; m[15] = 1;
+        }
+        if (projectionDirty)
+            perspectiveMatrix(fovY, aspect, zNear, zFar, projectionMatrix);
+        multiplyMatrices(projectionMatrix, viewMatrix, viewProjectionMatrix);
+        extractFrustum(viewProjectionMatrix, frustumPlanes);
+        viewDirty = projectionDirty = false;
+    }
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef CLUSTER_SHADER_H
+#define CLUSTER_SHADER_H
+
+#include <stdio.h>
+#include "GLExt.h"
+#include "ClusteredLights.h"
+
+// Per-fragment lighting from a LightClusters binning: a moon, a little
+// ambient light and every point light of the fragment's cluster. The
+// cluster grid and the index list go up as textures on units 1 and 2 and
+// the lights' view-space positions and colors as uniform arrays, so it
+// needs nothing past GLSL 1.10. Geometry goes through the fixed-function
+// vertex inputs as before; set lit wherever GL_LIGHTING is switched.
+
+class ClusteredShading {
+public:
+    ClusteredShading() : program(0), clusterTexture(0), indexTexture(0), failed(false), bound(false) {}
+
+    bool supported() const {
+        return ext.shaders;
+    }
+
+    // compiles on first use; false when the driver has no GLSL, rejects
+    // it or has too few fragment uniforms for MAX_CLUSTERED_LIGHTS
+    bool ready() {
+        if (program == 0 && !failed)
+            create();
+        return program != 0;
+    }
+
+    bool active() const {
+        return bound;
+    }
+
+    // binds the program for a view at x, y, width x height in the target,
+    // with clusters binned from that view's camera; the moon shines from
+    // direction (view space, unit length)
+    void begin(const LightClusters& clusters, int x, int y, int width, int height, const float* direction) {
+        ext.activeTexture(GL_TEXTURE0 + 1);
+        glBindTexture(GL_TEXTURE_2D, clusterTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CLUSTER_TILES_X * CLUSTER_TILES_Y, CLUSTER_SLICES,
+            GL_RGBA, GL_UNSIGNED_BYTE, clusters.clusterTexels);
+        ext.activeTexture(GL_TEXTURE0 + 2);
+        glBindTexture(GL_TEXTURE_2D, indexTexture);
+        if (clusters.indexCount > 0)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CLUSTER_INDEX_WIDTH, clusters.indexRows(),
+                GL_LUMINANCE, GL_UNSIGNED_BYTE, clusters.indices);
+        ext.activeTexture(GL_TEXTURE0);
+
+        ext.useProgram(program);
+        bound = true;
+        ext.uniform1i(clustersLocation, 1);
+        ext.uniform1i(indicesLocation, 2);
+        if (clusters.lightCount > 0) {
+            ext.uniform4fv(positionsLocation, clusters.lightCount, &clusters.viewLights[0][0]);
+            ext.uniform4fv(colorsLocation, clusters.lightCount, &clusters.lightColors[0][0]);
+        }
+        float viewport[4] = { (float)x, (float)y, (float)width, (float)height };
+        ext.uniform4fv(viewportLocation, 1, viewport);
+        ext.uniform2f(sliceLocation, clusters.depthScale(), clusters.depthBias());
+        ext.uniform3f(moonLocation, direction[0], direction[1], direction[2]);
+        ext.uniform1f(litLocation, 1.0f);
+    }
+
+    void setLit(bool lit) {
+        ext.uniform1f(litLocation, lit ? 1.0f : 0.0f);
+    }
+
+    void end() {
+        ext.useProgram(0);
+        bound = false;
+    }
+
+private:
+    GLuint program;
+    GLuint clusterTexture, indexTexture;
+    bool failed;
+    bool bound;
+    GLint clustersLocation, indicesLocation, positionsLocation, colorsLocation;
+    GLint viewportLocation, sliceLocation, moonLocation, litLocation;
+
+    ClusteredShading(const ClusteredShading&);
+    ClusteredShading& operator=(const ClusteredShading&);
+
+    GLuint compile(GLenum type, const char* const* source, int parts) {
+        GLuint shader = ext.createShader(type);
+        ext.shaderSource(shader, parts, source, NULL);
+        ext.compileShader(shader);
+        GLint ok = 0;
+        ext.getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            ext.deleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    void create() {
+        static const char* vertexSource =
+            "varying vec3 position;\n"
+            "varying vec3 normal;\n"
+            "void main() {\n"
+            "    vec4 p = gl_ModelViewMatrix * gl_Vertex;\n"
+            "    position = p.xyz;\n"
+            "    normal = gl_NormalMatrix * gl_Normal;\n"
+            "    gl_FrontColor = gl_Color;\n"
+            "    gl_Position = gl_ProjectionMatrix * p;\n"
+            "}\n";
+        // the grid and texture sizes from ClusteredLights.h, then the body
+        char header[256];
+        snprintf(header, sizeof(header),
+            "#define MAX_LIGHTS %d\n"
+            "const vec3 grid = vec3(%d.0, %d.0, %d.0);\n"
+            "const vec2 indexSize = vec2(%d.0, %d.0);\n",
+            MAX_CLUSTERED_LIGHTS, CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, CLUSTER_INDEX_WIDTH, CLUSTER_INDEX_ROWS);
+        static const char* fragmentSource =
+            "uniform sampler2D clusters;\n"
+            "uniform sampler2D lightIndices;\n"
+            "uniform vec4 lightPositions[MAX_LIGHTS];\n"
+            "uniform vec4 lightColors[MAX_LIGHTS];\n"
+            "uniform vec4 viewport;\n"
+            "uniform vec2 slice;\n"
+            "uniform vec3 moon;\n"
+            "uniform float lit;\n"
+            "varying vec3 position;\n"
+            "varying vec3 normal;\n"
+            "void main() {\n"
+            "    if (lit < 0.5) {\n"
+            "        gl_FragColor = gl_Color;\n"
+            "        return;\n"
+            "    }\n"
+            "    vec3 n = normalize(normal);\n"
+            "    vec3 light = vec3(0.05, 0.06, 0.1) + vec3(0.12, 0.14, 0.22) * max(dot(n, moon), 0.0);\n"
+            "    vec2 tile = floor((gl_FragCoord.xy - viewport.xy) / viewport.zw * grid.xy);\n"
+            "    float s = clamp(floor(log(max(-position.z, 1e-4)) * slice.x + slice.y), 0.0, grid.z - 1.0);\n"
+            "    vec2 at = vec2((tile.x + tile.y * grid.x + 0.5) / (grid.x * grid.y), (s + 0.5) / grid.z);\n"
+            "    vec4 cluster = floor(texture2D(clusters, at) * 255.0 + 0.5);\n"
+            "    float first = cluster.r + cluster.g * 256.0;\n"
+            "    for (int i = 0; i < 255; i++) {\n"
+            "        if (float(i) >= cluster.b)\n"
+            "            break;\n"
+            "        float k = first + float(i);\n"
+            "        vec2 p = vec2((mod(k, indexSize.x) + 0.5) / indexSize.x, (floor(k / indexSize.x) + 0.5) / indexSize.y);\n"
+            "        int index = int(texture2D(lightIndices, p).r * 255.0 + 0.5);\n"
+            "        vec4 l = lightPositions[index];\n"
+            "        vec3 toLight = l.xyz - position;\n"
+            "        float distance = length(toLight);\n"
+            "        float falloff = clamp(1.0 - distance / l.w, 0.0, 1.0);\n"
+            "        light += lightColors[index].rgb * (falloff * falloff * max(dot(n, toLight / max(distance, 1e-4)), 0.0));\n"
+            "    }\n"
+            "    gl_FragColor = vec4(gl_Color.rgb * light, gl_Color.a);\n"
+            "}\n";
+
+        if (!supported()) {
+            failed = true;
+            return;
+        }
+        // two vec4 arrays of lights, and room for the rest
+        GLint components = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_UNIFORM_COMPONENTS, &components);
+        if (components < 8 * MAX_CLUSTERED_LIGHTS + 64) {
+            printf("clustered lighting needs %d fragment uniform components, the driver has %d\n",
+                8 * MAX_CLUSTERED_LIGHTS + 64, components);
+            failed = true;
+            return;
+        }
+
+        const char* fragmentParts[2] = { header, fragmentSource };
+        GLuint vertex = compile(GL_VERTEX_SHADER, &vertexSource, 1);
+        GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentParts, 2);
+        GLint ok = 0;
+        if (vertex && fragment) {
+            program = ext.createProgram();
+            ext.attachShader(program, vertex);
+            ext.attachShader(program, fragment);
+            ext.linkProgram(program);
+            ext.getProgramiv(program, GL_LINK_STATUS, &ok);
+        }
+        if (vertex)
+            ext.deleteShader(vertex);
+        if (fragment)
+            ext.deleteShader(fragment);
+        if (!ok) {
+            program = 0;
+            failed = true;
+            return;
+        }
+        clustersLocation = ext.getUniformLocation(program, "clusters");
+        indicesLocation = ext.getUniformLocation(program, "lightIndices");
+        positionsLocation = ext.getUniformLocation(program, "lightPositions");
+        colorsLocation = ext.getUniformLocation(program, "lightColors");
+        viewportLocation = ext.getUniformLocation(program, "viewport");
+        sliceLocation = ext.getUniformLocation(program, "slice");
+        moonLocation = ext.getUniformLocation(program, "moon");
+        litLocation = ext.getUniformLocation(program, "lit");
+
+        clusterTexture = createTexture(CLUSTER_TILES_X * CLUSTER_TILES_Y, CLUSTER_SLICES, GL_RGBA);
+        indexTexture = createTexture(CLUSTER_INDEX_WIDTH, CLUSTER_INDEX_ROWS, GL_LUMINANCE);
+    }
+
+    // exact texels: no filtering, no mipmaps
+    static GLuint createTexture(int width, int height, GLenum format) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+};
+
+#endif
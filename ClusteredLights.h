@@ -0,0 +1,379 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <math.h>
+#include <string.h>
+
+// Point lights for the park at night, far more of them than the eight the
+// fixed-function pipeline has. The view frustum is cut into a grid of
+// clusters: CLUSTER_TILES_X by CLUSTER_TILES_Y tiles across the screen and
+// CLUSTER_SLICES slices in depth, spaced exponentially between CLUSTER_NEAR
+// and CLUSTER_FAR so near clusters are as deep as they are wide. Every frame
+// and view the lights are binned into the clusters their spheres touch; a
+// fragment finds its cluster from its window position and depth and shades
+// with that cluster's lights only.
+//
+// The result is laid out for upload as two textures: one RGBA8 texel per
+// cluster (first index low and high byte, light count) and one byte per
+// light index, CLUSTER_INDEX_WIDTH to a row.
+
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 8;
+const int CLUSTER_SLICES = 24;
+const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+const float CLUSTER_NEAR = 0.05f;       // everything nearer is in the first slice
+const float CLUSTER_FAR = 20.0f;        // and everything farther in the last
+const int MAX_CLUSTERED_LIGHTS = 256;   // an index is one byte
+const int MAX_LIGHTS_PER_CLUSTER = 255;
+const int CLUSTER_INDEX_WIDTH = 256;
+const int CLUSTER_INDEX_ROWS = 128;
+const int CLUSTER_INDEX_CAPACITY = CLUSTER_INDEX_WIDTH * CLUSTER_INDEX_ROWS;
+
+// light falls off as (1 - distance / radius)^2 and is gone at the radius
+struct PointLight {
+    float x, y, z;
+    float radius;
+    float r, g, b;
+};
+
+class LightClusters {
+public:
+    int lightCount;
+    int indexCount;             // light-cluster pairs this binning
+    unsigned long overflows;    // pairs dropped since construction, for a full cluster or index texture
+    // per light, view space: position and radius, then color
+    float viewLights[MAX_CLUSTERED_LIGHTS][4];
+    float lightColors[MAX_CLUSTERED_LIGHTS][4];
+    unsigned char clusterTexels[CLUSTER_COUNT * 4];
+    unsigned char indices[CLUSTER_INDEX_CAPACITY];
+
+    LightClusters() : lightCount(0), indexCount(0), overflows(0), perspective(true), zNear(0.001f), zFar(1000) {
+        sliceScale = CLUSTER_SLICES / logf(CLUSTER_FAR / CLUSTER_NEAR);
+        sliceBias = -logf(CLUSTER_NEAR) * sliceScale;
+        for (int s = 0; s <= CLUSTER_SLICES; s++)
+            sliceDepths[s] = CLUSTER_NEAR * powf(CLUSTER_FAR / CLUSTER_NEAR, (float)s / CLUSTER_SLICES);
+        sliceDepths[0] = 0;
+        memset(clusterTexels, 0, sizeof(clusterTexels));
+        memset(indices, 0, sizeof(indices));
+    }
+
+    // slice = floor(log(depth) * scale + bias), clamped; the shader is
+    // given the same two numbers
+    float depthScale() const {
+        return sliceScale;
+    }
+
+    float depthBias() const {
+        return sliceBias;
+    }
+
+    int slice(float depth) const {
+        if (depth <= CLUSTER_NEAR)
+            return 0;
+        int s = (int)floorf(logf(depth) * sliceScale + sliceBias);
+        return s < 0 ? 0 : s >= CLUSTER_SLICES ? CLUSTER_SLICES - 1 : s;
+    }
+
+    int clusterIndex(int tileX, int tileY, int s) const {
+        return (s * CLUSTER_TILES_Y + tileY) * CLUSTER_TILES_X + tileX;
+    }
+
+    int clusterFirst(int cluster) const {
+        return clusterTexels[4 * cluster] | (clusterTexels[4 * cluster + 1] << 8);
+    }
+
+    int clusterLights(int cluster) const {
+        return clusterTexels[4 * cluster + 2];
+    }
+
+    // rows of the index texture in use
+    int indexRows() const {
+        return (indexCount + CLUSTER_INDEX_WIDTH - 1) / CLUSTER_INDEX_WIDTH;
+    }
+
+    // the lights into the clusters of a camera with these column-major
+    // view and projection matrices; the projection may be perspective or
+    // orthographic but not skewed
+    void bin(const PointLight* lights, int count, const float* view, const float* projection) {
+        lightCount = count < MAX_CLUSTERED_LIGHTS ? count : MAX_CLUSTERED_LIGHTS;
+        perspective = projection[11] != 0;
+        for (int i = 0; i < 16; i++)
+            projectionMatrix[i] = projection[i];
+        if (perspective) {
+            zNear = projection[14] / (projection[10] - 1);
+            zFar = projection[14] / (projection[10] + 1);
+        }
+        else {
+            zNear = (projection[14] + 1) / projection[10];
+            zFar = (projection[14] - 1) / projection[10];
+        }
+
+        rangeCount = 0;
+        int counts[CLUSTER_COUNT];
+        memset(counts, 0, sizeof(counts));
+        for (int i = 0; i < lightCount; i++) {
+            const PointLight& l = lights[i];
+            float* v = viewLights[i];
+            v[0] = view[0] * l.x + view[4] * l.y + view[8] * l.z + view[12];
+            v[1] = view[1] * l.x + view[5] * l.y + view[9] * l.z + view[13];
+            v[2] = view[2] * l.x + view[6] * l.y + view[10] * l.z + view[14];
+            v[3] = l.radius;
+            lightColors[i][0] = l.r;
+            lightColors[i][1] = l.g;
+            lightColors[i][2] = l.b;
+            lightColors[i][3] = 1;
+
+            float depth = -v[2];
+            if (depth + l.radius < zNear || depth - l.radius > zFar)
+                continue;
+            float front = depth - l.radius > zNear ? depth - l.radius : zNear;
+            float back = depth + l.radius;
+            int firstSlice = slice(front), lastSlice = slice(back);
+            for (int s = firstSlice; s <= lastSlice; s++) {
+                // the part of the sphere's depth range inside this slice
+                float low = front > sliceDepths[s] ? front : sliceDepths[s];
+                float high = s + 1 < CLUSTER_SLICES && back > sliceDepths[s + 1] ? sliceDepths[s + 1] : back;
+                TileRange& t = ranges[rangeCount];
+                if (!tiles(v[0], v[1], l.radius, low, high, t))
+                    continue;
+                t.light = (unsigned char)i;
+                t.slice = (unsigned char)s;
+                for (int y = t.y0; y <= t.y1; y++) {
+                    for (int x = t.x0; x <= t.x1; x++)
+                        counts[clusterIndex(x, y, s)]++;
+                }
+                rangeCount++;
+            }
+        }
+
+        // each cluster's run of indices, in cluster order
+        indexCount = 0;
+        for (int c = 0; c < CLUSTER_COUNT; c++) {
+            int n = counts[c];
+            if (n > MAX_LIGHTS_PER_CLUSTER)
+                n = MAX_LIGHTS_PER_CLUSTER;
+            if (n > CLUSTER_INDEX_CAPACITY - indexCount)
+                n = CLUSTER_INDEX_CAPACITY - indexCount;
+            overflows += counts[c] - n;
+            clusterTexels[4 * c] = (unsigned char)(indexCount & 0xff);
+            clusterTexels[4 * c + 1] = (unsigned char)(indexCount >> 8);
+            clusterTexels[4 * c + 2] = (unsigned char)n;
+            clusterTexels[4 * c + 3] = 0;
+            counts[c] = 0;
+            indexCount += n;
+        }
+        for (int r = 0; r < rangeCount; r++) {
+            const TileRange& t = ranges[r];
+            for (int y = t.y0; y <= t.y1; y++) {
+                for (int x = t.x0; x <= t.x1; x++) {
+                    int c = clusterIndex(x, y, t.slice);
+                    if (counts[c] < clusterLights(c))
+                        indices[clusterFirst(c) + counts[c]++] = t.light;
+                }
+            }
+        }
+    }
+
+    // how many lights the cluster of a window position (0 to 1 across the
+    // view) and view-space depth holds
+    int lightsAt(float u, float v, float depth) const {
+        int x = (int)(u * CLUSTER_TILES_X), y = (int)(v * CLUSTER_TILES_Y);
+        x = x < 0 ? 0 : x >= CLUSTER_TILES_X ? CLUSTER_TILES_X - 1 : x;
+        y = y < 0 ? 0 : y >= CLUSTER_TILES_Y ? CLUSTER_TILES_Y - 1 : y;
+        return clusterLights(clusterIndex(x, y, slice(depth)));
+    }
+
+    // the lights the shading loop reads, on average over every step-th
+    // pixel of a width x height depth buffer (window depths, 0 to 1) of
+    // the last binned view; pixels nothing was drawn on are left out
+    double lightsPerFragment(const float* depth, int width, int height, int step) const {
+        double lights = 0;
+        long fragments = 0;
+        for (int y = step / 2; y < height; y += step) {
+            for (int x = step / 2; x < width; x += step) {
+                float d = depth[y * width + x];
+                if (d >= 1)
+                    continue;
+                float z = 2 * d - 1;
+                float viewDepth = perspective
+                    ? 2 * zNear * zFar / (zFar + zNear - z * (zFar - zNear))
+                    : zNear + (z + 1) / 2 * (zFar - zNear);
+                lights += lightsAt((x + 0.5f) / width, (y + 0.5f) / height, viewDepth);
+                fragments++;
+            }
+        }
+        return fragments ? lights / fragments : 0;
+    }
+
+private:
+    struct TileRange {
+        unsigned char light, slice;
+        unsigned char x0, x1, y0, y1;
+    };
+
+    bool perspective;
+    float zNear, zFar;
+    float projectionMatrix[16];
+    float sliceScale, sliceBias;
+    float sliceDepths[CLUSTER_SLICES + 1];
+    TileRange ranges[MAX_CLUSTERED_LIGHTS * CLUSTER_SLICES];
+    int rangeCount;
+
+    LightClusters(const LightClusters&);
+    LightClusters& operator=(const LightClusters&);
+
+    // the screen box around a view-space sphere over depths low..high,
+    // as inclusive tile ranges; false when it misses the screen
+    bool tiles(float x, float y, float radius, float low, float high, TileRange& t) const {
+        float left, right, bottom, top;
+        const float* p = projectionMatrix;
+        if (perspective) {
+            // x / depth is smallest at the near depth for a negative x and
+            // at the far depth for a positive one, and the other way round
+            // for the largest
+            float minX = x - radius, maxX = x + radius, minY = y - radius, maxY = y + radius;
+            left = p[0] * (minX < 0 ? minX / low : minX / high) - p[8];
+            right = p[0] * (maxX > 0 ? maxX / low : maxX / high) - p[8];
+            bottom = p[5] * (minY < 0 ? minY / low : minY / high) - p[9];
+            top = p[5] * (maxY > 0 ? maxY / low : maxY / high) - p[9];
+        }
+        else {
+            left = p[0] * (x - radius) + p[12];
+            right = p[0] * (x + radius) + p[12];
+            bottom = p[5] * (y - radius) + p[13];
+            top = p[5] * (y + radius) + p[13];
+        }
+        if (right < -1 || left > 1 || top < -1 || bottom > 1)
+            return false;
+        t.x0 = (unsigned char)tile(left, CLUSTER_TILES_X);
+        t.x1 = (unsigned char)tile(right, CLUSTER_TILES_X);
+        t.y0 = (unsigned char)tile(bottom, CLUSTER_TILES_Y);
+        t.y1 = (unsigned char)tile(top, CLUSTER_TILES_Y);
+        return true;
+    }
+
+    static int tile(float ndc, int tiles) {
+        int t = (int)floorf((ndc + 1) / 2 * tiles);
+        return t < 0 ? 0 : t >= tiles ? tiles - 1 : t;
+    }
+};
+
+// x, z of the lamp posts along the paths; the game draws the posts
+const int PARK_LAMP_POSTS = 10;
+const float PARK_LAMP_HEIGHT = 0.3f;
+const float parkLampPosts[PARK_LAMP_POSTS][2] = {
+    { -0.25f, 0.85f }, { 0.25f, 0.85f }, { -0.25f, 0.6f }, { 0.25f, 0.6f }, { -0.2f, 0.2f },
+    { 0.2f, 0.3f }, { 0.1f, -0.05f }, { -0.2f, -0.25f }, { 0.2f, -0.3f }, { 0.35f, 0.45f }
+};
+
+// the park's lights after dark, at most capacity of them: string lights
+// along the fences, lamp posts over the paths, a ring of bollards at the
+// edge of the plateau, lights on the Ferris wheel's spokes turning with it,
+// burners under the balloons and bulbs on the swing and the ticket stand
+inline int parkNightLights(PointLight* out, int capacity, float wheelAngle, float balloonRise) {
+    static const float bulbColors[5][3] = {
+        { 1.0f, 0.25f, 0.2f }, { 1.0f, 0.8f, 0.2f }, { 0.3f, 1.0f, 0.3f }, { 0.3f, 0.5f, 1.0f }, { 1.0f, 0.9f, 0.7f }
+    };
+    int n = 0;
+    PointLight l;
+
+    // along the rails, the back fence and then both sides
+    for (int side = 0; side < 3; side++) {
+        for (int i = 0; i <= 25; i++) {
+            float t = -0.5f + i * 0.04f;
+            l.x = side == 0 ? t : side == 1 ? -0.5f : 0.5f;
+            l.z = side == 0 ? -0.5f : t;
+            l.y = 0.27f;
+            l.radius = 0.12f;
+            l.r = bulbColors[i % 5][0];
+            l.g = bulbColors[i % 5][1];
+            l.b = bulbColors[i % 5][2];
+            if (n < capacity)
+                out[n++] = l;
+        }
+    }
+
+    l.y = PARK_LAMP_HEIGHT;
+    l.radius = 0.6f;
+    l.r = 1.2f;
+    l.g = 0.9f;
+    l.b = 0.55f;
+    for (int i = 0; i < PARK_LAMP_POSTS; i++) {
+        l.x = parkLampPosts[i][0];
+        l.z = parkLampPosts[i][1];
+        if (n < capacity)
+            out[n++] = l;
+    }
+
+    l.y = 0.06f;
+    l.radius = 0.2f;
+    l.r = 0.5f;
+    l.g = 0.7f;
+    l.b = 1.0f;
+    for (int i = 0; i < 40; i++) {
+        float a = i * (2 * 3.14159265f / 40);
+        l.x = 0.75f * cosf(a);
+        l.z = 0.75f * sinf(a);
+        if (n < capacity)
+            out[n++] = l;
+    }
+
+    // the wheel turns about z at (0, 0.37, -0.42), rim radius 0.18
+    for (int spoke = 0; spoke < 8; spoke++) {
+        float a = (wheelAngle + spoke * 45) * (3.14159265f / 180);
+        for (int i = 1; i <= 8; i++) {
+            float r = 0.18f * i / 8;
+            l.x = r * cosf(a);
+            l.y = 0.37f + r * sinf(a);
+            l.z = -0.42f + 0.02f;
+            l.radius = 0.1f;
+            l.r = bulbColors[spoke % 5][0];
+            l.g = bulbColors[spoke % 5][1];
+            l.b = bulbColors[spoke % 5][2];
+            if (n < capacity)
+                out[n++] = l;
+        }
+    }
+
+    // just under each envelope, as the balloons are placed and scaled
+    static const float balloons[3][4] = {
+        { 0.5f, 0.4f, 0.2f, 0.3f }, { 0.6f, 0.43f, 0.3f, 0.35f }, { -0.4f, 0.43f, -0.6f, 0.35f }
+    };
+    for (int i = 0; i < 3; i++) {
+        l.x = balloons[i][0];
+        l.y = balloons[i][1] + balloons[i][3] * (balloonRise - 0.15f);
+        l.z = balloons[i][2];
+        l.radius = 0.3f;
+        l.r = 1.5f;
+        l.g = 0.7f;
+        l.b = 0.25f;
+        if (n < capacity)
+            out[n++] = l;
+    }
+
+    // the swing's top rod and the front of the ticket stand
+    l.radius = 0.15f;
+    for (int i = 0; i < 5; i++) {
+        l.x = -0.39f;
+        l.y = 0.29f;
+        l.z = -0.096f + i * 0.048f;
+        l.r = bulbColors[i][0];
+        l.g = bulbColors[i][1];
+        l.b = bulbColors[i][2];
+        if (n < capacity)
+            out[n++] = l;
+    }
+    for (int i = 0; i < 2; i++) {
+        l.x = -0.36f;
+        l.y = 0.2f;
+        l.z = 0.3f + i * 0.1f;
+        l.r = 1.0f;
+        l.g = 0.9f;
+        l.b = 0.7f;
+        if (n < capacity)
+            out[n++] = l;
+    }
+    return n;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef DRAW_COMMANDS_H
+#define DRAW_COMMANDS_H
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include "ParkMath.h"
+
+// Draw-command lists: scene traversal records what to draw (mesh id,
+// world transform, color, lighting) without touching OpenGL, so any thread
+// can fill a list, and the GL thread submits them later. Recording mirrors
+// the fixed-function matrix stack, so draw code ports over call for call.
+
+const int COMMAND_LIST_CAPACITY = 256;
+const int COMMAND_STACK_DEPTH = 16;
+
+struct DrawCommand {
+    float matrix[16];       // model to world, column-major
+    float color[3];
+    unsigned short mesh;
+    bool lit;
+    short animation;        // the ride instance moving it, -1 for none
+    unsigned sortKey;       // unlit after lit, then by mesh
+};
+
+class CommandList {
+public:
+    int count;
+    unsigned version;       // what the list was recorded for, see begin()
+    bool overflowed;
+    DrawCommand commands[COMMAND_LIST_CAPACITY];
+
+    CommandList() : count(0), version(~0u), overflowed(false), depth(0) {}
+
+    // starts a new recording; version lets the caller keep lists whose
+    // source did not change since they were recorded
+    void begin(unsigned recordedVersion, float r = 1, float g = 1, float b = 1) {
+        count = 0;
+        version = recordedVersion;
+        overflowed = false;
+        depth = 0;
+        identity(stack[0]);
+        color(r, g, b);
+        isLit = true;
+        animationId = -1;
+    }
+
+    void push() {
+        if (depth + 1 < COMMAND_STACK_DEPTH) {
+            memcpy(stack[depth + 1], stack[depth], sizeof(stack[0]));
+            depth++;
+        }
+    }
+
+    void pop() {
+        if (depth > 0)
+            depth--;
+    }
+
+    void translate(double x, double y, double z) {
+        float* m = stack[depth];
+        for (int i = 0; i < 4; i++)
+            m[12 + i] += m[i] * (float)x + m[4 + i] * (float)y + m[8 + i] * (float)z;
+    }
+
+    void scale(double x, double y, double z) {
+        float* m = stack[depth];
+        for (int i = 0; i < 4; i++) {
+            m[i] *= (float)x;
+            m[4 + i] *= (float)y;
+            m[8 + i] *= (float)z;
+        }
+    }
+
+    // same convention as glRotate: degrees about an axis that need not be unit
+    void rotate(double degrees, double x, double y, double z) {
+        Vector3f axis = Vector3f((float)x, (float)y, (float)z).unit();
+        float c = (float)cos(DEG2RAD(degrees)), s = (float)sin(DEG2RAD(degrees)), t = 1 - c;
+        float r[16] = {
+            t * axis.x * axis.x + c, t * axis.x * axis.y + s * axis.z, t * axis.x * axis.z - s * axis.y, 0,
+            t * axis.x * axis.y - s * axis.z, t * axis.y * axis.y + c, t * axis.y * axis.z + s * axis.x, 0,
+            t * axis.x * axis.z + s * axis.y, t * axis.y * axis.z - s * axis.x, t * axis.z * axis.z + c, 0,
+            0, 0, 0, 1
+        };
+        float result[16];
+        multiplyMatrices(stack[depth], r, result);
+        memcpy(stack[depth], result, sizeof(result));
+    }
+
+    void color(double r, double g, double b) {
+        currentColor[0] = (float)r;
+        currentColor[1] = (float)g;
+        currentColor[2] = (float)b;
+    }
+
+    void lighting(bool enabled) {
+        isLit = enabled;
+    }
+
+    // tags what follows as moved by a ride instance (see RideAnimation.h),
+    // -1 for nothing; the matrix stack still holds the rest pose
+    void animation(int instance) {
+        animationId = instance;
+    }
+
+    void draw(int mesh) {
+        if (count == COMMAND_LIST_CAPACITY) {
+            overflowed = true;
+            return;
+        }
+        DrawCommand& c = commands[count++];
+        memcpy(c.matrix, stack[depth], sizeof(c.matrix));
+        memcpy(c.color, currentColor, sizeof(c.color));
+        c.mesh = (unsigned short)mesh;
+        c.lit = isLit;
+        c.animation = (short)animationId;
+        c.sortKey = (isLit ? 0u : 1u << 16) | (unsigned)mesh;
+    }
+
+private:
+    float stack[COMMAND_STACK_DEPTH][16];
+    int depth;
+    float currentColor[3];
+    bool isLit;
+    int animationId;
+
+    static void identity(float* m) {
+        for (int i = 0; i < 16; i++)
+            m[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    }
+};
+
+inline bool commandBefore(const DrawCommand* a, const DrawCommand* b) {
+    if (a->sortKey != b->sortKey)
+        return a->sortKey < b->sortKey;
+    return std::less<const DrawCommand*>()(a, b);   // recording order, so the result is deterministic
+}
+
+// gathers the commands of several lists into out (room for all of them)
+// sorted by key; returns how many were written
+inline int mergeCommandLists(CommandList* const* lists, int listCount, const DrawCommand** out) {
+    int n = 0;
+    for (int l = 0; l < listCount; l++) {
+        for (int i = 0; i < lists[l]->count; i++)
+            out[n++] = &lists[l]->commands[i];
+    }
+    std::sort(out, out + n, commandBefore);
+    return n;
+}
+
+#endif
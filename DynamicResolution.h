@@ -0,0 +1,200 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <math.h>
+#include "GLExt.h"
+
+// Dynamic resolution: the 3D scene is drawn into an offscreen framebuffer
+// covering only part of the window and stretched over it afterwards, so a
+// frame that would take too long is drawn with fewer pixels. The controller
+// picks the scale from the measured frame time; the render target is
+// allocated once at window size and only a corner of it is used. With
+// samples set, the scene is drawn multisampled and resolved into the
+// texture before it is stretched.
+
+class ResolutionController {
+public:
+    double targetMs;
+    float minScale, maxScale;
+    float scale;            // of each window dimension
+
+    ResolutionController(double target = 16.0, float low = 0.5f, float high = 1.0f)
+        : targetMs(target), minScale(low), maxScale(high), scale(high) {}
+
+    // feeds the time of a frame drawn at the current scale; returns true when
+    // the scale changed for the next one
+    bool update(double frameMs) {
+        if (frameMs < 0.1)
+            frameMs = 0.1;
+        // rasterization cost follows the pixel count, i.e. the scale squared
+        float wanted = scale * (float)sqrt(targetMs / frameMs);
+        if (wanted < minScale)
+            wanted = minScale;
+        if (wanted > maxScale)
+            wanted = maxScale;
+        // leave small differences alone so one noisy frame does not change
+        // the picture, and go only part of the way otherwise
+        if (fabs(wanted - scale) < 0.02f && wanted < maxScale)
+            return false;
+        float next = scale + (wanted - scale) * 0.5f;
+        next = floor(next * 64 + 0.5f) / 64;
+        if (next == scale)
+            return false;
+        scale = next;
+        return true;
+    }
+};
+
+class SceneTarget {
+public:
+    int width, height;      // the part drawn this frame
+
+    SceneTarget() : width(0), height(0), fullWidth(0), fullHeight(0), samples(0), framebuffer(0), texture(0), depth(0),
+        multisampleFramebuffer(0), multisampleColor(0), multisampleDepth(0), complete(false) {}
+
+    bool supported() const {
+        return ext.framebuffers;
+    }
+
+    int maxSamples() const {
+        if (!ext.multisampleFramebuffers)
+            return 0;
+        GLint n = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &n);
+        return n;
+    }
+
+    // (re)allocates for a window of this size and sample count; false
+    // without framebuffer support, in which case the scene goes straight to
+    // the window
+    bool resize(int w, int h, int sampleCount) {
+        if (!supported())
+            return false;
+        if (sampleCount > maxSamples())
+            sampleCount = maxSamples();
+        if (w == fullWidth && h == fullHeight && sampleCount == samples)
+            return complete;
+        if (framebuffer == 0) {
+            ext.genFramebuffers(1, &framebuffer);
+            ext.genRenderbuffers(1, &depth);
+            glGenTextures(1, &texture);
+        }
+        fullWidth = w;
+        fullHeight = h;
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        ext.bindRenderbuffer(GL_RENDERBUFFER, depth);
+        ext.renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+        ext.bindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        ext.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        ext.framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        ext.framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        complete = ext.checkFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        samples = sampleCount;
+        if (samples > 0) {
+            if (multisampleFramebuffer == 0) {
+                ext.genFramebuffers(1, &multisampleFramebuffer);
+                ext.genRenderbuffers(1, &multisampleColor);
+                ext.genRenderbuffers(1, &multisampleDepth);
+            }
+            ext.bindRenderbuffer(GL_RENDERBUFFER, multisampleColor);
+            ext.renderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, w, h);
+            ext.bindRenderbuffer(GL_RENDERBUFFER, multisampleDepth);
+            ext.renderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, w, h);
+            ext.bindRenderbuffer(GL_RENDERBUFFER, 0);
+
+            ext.bindFramebuffer(GL_FRAMEBUFFER, multisampleFramebuffer);
+            ext.framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, multisampleColor);
+            ext.framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, multisampleDepth);
+            complete = complete && ext.checkFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+        ext.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    bool ready() const {
+        return complete;
+    }
+
+    int sampleCount() const {
+        return samples;
+    }
+
+    int targetWidth() const {
+        return fullWidth;
+    }
+
+    int targetHeight() const {
+        return fullHeight;
+    }
+
+    // redirects drawing into the lower left scale x scale of the target
+    void begin(float scale) {
+        width = (int)(fullWidth * scale + 0.5f);
+        height = (int)(fullHeight * scale + 0.5f);
+        if (width < 1)
+            width = 1;
+        if (height < 1)
+            height = 1;
+        ext.bindFramebuffer(GL_FRAMEBUFFER, samples > 0 ? multisampleFramebuffer : framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // back to the window, stretching what was drawn over all of it; a
+    // shader bound by the caller runs over every window pixel
+    void end() {
+        if (samples > 0) {
+            ext.bindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFramebuffer);
+            ext.bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+            ext.blitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        ext.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, fullWidth, fullHeight);
+
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        float u = (float)width / fullWidth, v = (float)height / fullHeight;
+        glBegin(GL_QUADS);
+        glTexCoord2f(0, 0); glVertex2f(-1, -1);
+        glTexCoord2f(u, 0); glVertex2f(1, -1);
+        glTexCoord2f(u, v); glVertex2f(1, 1);
+        glTexCoord2f(0, v); glVertex2f(-1, 1);
+        glEnd();
+
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+    }
+
+private:
+    int fullWidth, fullHeight;
+    int samples;
+    GLuint framebuffer, texture, depth;
+    GLuint multisampleFramebuffer, multisampleColor, multisampleDepth;
+    bool complete;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Bump allocator for data that only lives until the end of a frame, such as
+// vertex streams built on the CPU. The buffer is allocated once; reset() at
+// the start of each frame hands all of it out again. A request that does not
+// fit returns NULL and is counted instead of falling back to the heap.
+
+class FrameArena {
+public:
+    size_t peak;            // most bytes used by one frame
+    unsigned overflows;     // requests that did not fit
+
+    FrameArena(size_t bytes) : peak(0), overflows(0), capacity(bytes), used(0) {
+        buffer = (unsigned char*)malloc(bytes);
+        if (!buffer)
+            capacity = 0;
+    }
+
+    ~FrameArena() {
+        free(buffer);
+    }
+
+    // align must be a power of two no larger than 16
+    void* allocate(size_t bytes, size_t align = 16) {
+        size_t start = (used + align - 1) & ~(align - 1);
+        if (start + bytes > capacity) {
+            overflows++;
+            return NULL;
+        }
+        used = start + bytes;
+        if (used > peak)
+            peak = used;
+        return buffer + start;
+    }
+
+    template <class T>
+    T* allocateArray(size_t count) {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    void reset() {
+        used = 0;
+    }
+
+    size_t bytesUsed() const {
+        return used;
+    }
+
+    size_t size() const {
+        return capacity;
+    }
+
+private:
+    unsigned char* buffer;
+    size_t capacity;
+    size_t used;
+
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+};
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "GLExt.h"
+
+// Captures rendered frames without stalling the render thread. glReadPixels
+// goes into a ring of pixel buffer objects and each buffer is only mapped a
+// couple of frames later, once its transfer has finished. The pixels are
+// copied into a fixed pool of frame slots that a background thread encodes
+// as a Y4M video (path ending in .y4m) or a numbered PNG sequence (any other
+// path, used as the file name prefix). When the encoder falls behind and no
+// slot is free the frame is dropped rather than waited for.
+
+const int CAPTURE_PBO_COUNT = 3;
+const int CAPTURE_SLOT_COUNT = 8;
+
+class FrameCapture {
+public:
+    unsigned framesCaptured;
+    unsigned framesDropped;
+    double captureMs;   // render-thread time spent in captureFrame
+
+    FrameCapture() : framesCaptured(0), framesDropped(0), captureMs(0), active(false), width(0), height(0),
+        pbosIssued(0), queueHead(0), queueCount(0), stopping(false), file(NULL), frameNumber(0) {
+        for (int i = 0; i < CAPTURE_PBO_COUNT; i++)
+            pbos[i] = 0;
+    }
+
+    ~FrameCapture() {
+        stop();
+    }
+
+    bool isActive() const {
+        return active;
+    }
+
+    bool start(const char* path, int w, int h) {
+        stop();
+        width = w;
+        height = h;
+        y4m = strlen(path) > 4 && strcmp(path + strlen(path) - 4, ".y4m") == 0;
+        strncpy(outputPath, path, sizeof(outputPath) - 1);
+        outputPath[sizeof(outputPath) - 1] = '\0';
+        if (y4m) {
+            file = fopen(path, "wb");
+            if (!file)
+                return false;
+            fprintf(file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", width, height);
+        }
+
+        for (int i = 0; i < CAPTURE_SLOT_COUNT; i++) {
+            slots[i].resize((size_t)width * height * 4);
+            slotFree[i] = true;
+        }
+        if (ext.pixelBuffers) {
+            ext.genBuffers(CAPTURE_PBO_COUNT, pbos);
+            for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+                ext.bindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+                ext.bufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptrExt)width * height * 4, NULL, GL_STREAM_READ);
+            }
+            ext.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        pbosIssued = 0;
+        framesCaptured = framesDropped = 0;
+        captureMs = 0;
+        frameNumber = 0;
+        stopping = false;
+        encoder = std::thread(&FrameCapture::encoderLoop, this);
+        active = true;
+        return true;
+    }
+
+    // call after the frame is complete, before swapping/flushing
+    void captureFrame() {
+        if (!active)
+            return;
+        auto begin = std::chrono::high_resolution_clock::now();
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+        if (ext.pixelBuffers) {
+            int index = pbosIssued % CAPTURE_PBO_COUNT;
+            // the buffer about to be reused was filled CAPTURE_PBO_COUNT frames ago
+            if (pbosIssued >= CAPTURE_PBO_COUNT)
+                collect(index);
+            ext.bindBuffer(GL_PIXEL_PACK_BUFFER, pbos[index]);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            ext.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            pbosIssued++;
+        }
+        else {
+            // no pixel buffers: synchronous read straight into a slot
+            int slot = acquireSlot();
+            if (slot >= 0) {
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &slots[slot][0]);
+                submit(slot);
+            }
+        }
+
+        captureMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+    }
+
+    void stop() {
+        if (!active)
+            return;
+        if (ext.pixelBuffers) {
+            // drain the frames still in flight, oldest first
+            int pending = pbosIssued < CAPTURE_PBO_COUNT ? pbosIssued : CAPTURE_PBO_COUNT;
+            for (int i = pending; i > 0; i--)
+                collect((pbosIssued - i) % CAPTURE_PBO_COUNT);
+            ext.deleteBuffers(CAPTURE_PBO_COUNT, pbos);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        encoder.join();
+        if (file) {
+            fclose(file);
+            file = NULL;
+        }
+        active = false;
+        printf("capture %s: %u frames, %u dropped, %.3f ms per frame on the render thread\n", outputPath,
+            framesCaptured, framesDropped, framesCaptured + framesDropped ? captureMs / (framesCaptured + framesDropped) : 0.0);
+    }
+
+private:
+    bool active;
+    bool y4m;
+    char outputPath[256];
+    int width, height;
+    GLuint pbos[CAPTURE_PBO_COUNT];
+    int pbosIssued;
+
+    std::vector<unsigned char> slots[CAPTURE_SLOT_COUNT];
+    bool slotFree[CAPTURE_SLOT_COUNT];
+    int queue[CAPTURE_SLOT_COUNT];
+    int queueHead, queueCount;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread encoder;
+
+    FILE* file;
+    int frameNumber;
+    std::vector<unsigned char> planes;  // encoder scratch, sized once
+
+    void collect(int index) {
+        int slot = acquireSlot();
+        if (slot < 0)
+            return;
+        ext.bindBuffer(GL_PIXEL_PACK_BUFFER, pbos[index]);
+        const void* pixels = ext.mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (pixels) {
+            memcpy(&slots[slot][0], pixels, slots[slot].size());
+            ext.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        ext.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (pixels)
+            submit(slot);
+        else
+            releaseSlot(slot);
+    }
+
+    int acquireSlot() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < CAPTURE_SLOT_COUNT; i++) {
+            if (slotFree[i]) {
+                slotFree[i] = false;
+                return i;
+            }
+        }
+        framesDropped++;
+        return -1;
+    }
+
+    void releaseSlot(int slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        slotFree[slot] = true;
+    }
+
+    void submit(int slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue[(queueHead + queueCount) % CAPTURE_SLOT_COUNT] = slot;
+            queueCount++;
+            framesCaptured++;
+        }
+        wake.notify_one();
+    }
+
+    void encoderLoop() {
+        while (true) {
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || queueCount > 0; });
+                if (queueCount == 0)
+                    return;
+                slot = queue[queueHead];
+                queueHead = (queueHead + 1) % CAPTURE_SLOT_COUNT;
+                queueCount--;
+            }
+            if (y4m)
+                writeY4MFrame(&slots[slot][0]);
+            else
+                writePNGFrame(&slots[slot][0]);
+            releaseSlot(slot);
+        }
+    }
+
+    // RGBA bottom-up -> planar 4:2:0, top-down
+    void writeY4MFrame(const unsigned char* rgba) {
+        int cw = (width + 1) / 2, ch = (height + 1) / 2;
+        planes.resize((size_t)width * height + 2 * cw * ch);
+        unsigned char* yPlane = &planes[0];
+        unsigned char* uPlane = yPlane + width * height;
+        unsigned char* vPlane = uPlane + cw * ch;
+        for (int y = 0; y < height; y++) {
+            const unsigned char* row = rgba + (size_t)(height - 1 - y) * width * 4;
+            for (int x = 0; x < width; x++) {
+                const unsigned char* p = row + x * 4;
+                yPlane[y * width + x] = (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8);
+            }
+        }
+        for (int y = 0; y < ch; y++) {
+            const unsigned char* row = rgba + (size_t)(height - 1 - 2 * y) * width * 4;
+            for (int x = 0; x < cw; x++) {
+                const unsigned char* p = row + 2 * x * 4;
+                uPlane[y * cw + x] = (unsigned char)(((-43 * p[0] - 85 * p[1] + 128 * p[2]) >> 8) + 128);
+                vPlane[y * cw + x] = (unsigned char)(((128 * p[0] - 107 * p[1] - 21 * p[2]) >> 8) + 128);
+            }
+        }
+        fputs("FRAME\n", file);
+        fwrite(&planes[0], 1, planes.size(), file);
+    }
+
+    static unsigned crc32(unsigned crc, const unsigned char* data, size_t length) {
+        static unsigned table[256];
+        if (table[1] == 0) {
+            for (unsigned n = 0; n < 256; n++) {
+                unsigned c = n;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    static void putBigEndian(unsigned char* out, unsigned value) {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+
+    void writeChunk(FILE* f, const char* type, const unsigned char* data, unsigned length) {
+        unsigned char header[8];
+        putBigEndian(header, length);
+        memcpy(header + 4, type, 4);
+        fwrite(header, 1, 8, f);
+        if (length)
+            fwrite(data, 1, length, f);
+        unsigned crc = crc32(crc32(0, header + 4, 4), data, length);
+        unsigned char tail[4];
+        putBigEndian(tail, crc);
+        fwrite(tail, 1, 4, f);
+    }
+
+    // uncompressed (stored deflate) RGB PNG: cheap to write, any viewer reads it
+    void writePNGFrame(const unsigned char* rgba) {
+        char name[300];
+        snprintf(name, sizeof(name), "%s_%05d.png", outputPath, frameNumber++);
+        FILE* f = fopen(name, "wb");
+        if (!f)
+            return;
+
+        size_t rowBytes = (size_t)width * 3 + 1;
+        size_t raw = rowBytes * height;
+        size_t blocks = (raw + 65534) / 65535;
+        planes.resize(2 + raw + blocks * 5 + 4);
+        unsigned char* out = &planes[0];
+        size_t n = 0;
+        out[n++] = 0x78;
+        out[n++] = 0x01;
+
+        unsigned a = 1, b = 0;
+        size_t left = raw, inBlock = 0;
+        for (int y = 0; y < height; y++) {
+            const unsigned char* row = rgba + (size_t)(height - 1 - y) * width * 4;
+            for (size_t i = 0; i < rowBytes; i++) {
+                if (inBlock == 0) {
+                    size_t length = left < 65535 ? left : 65535;
+                    out[n++] = left == length ? 1 : 0;
+                    out[n++] = (unsigned char)length;
+                    out[n++] = (unsigned char)(length >> 8);
+                    out[n++] = (unsigned char)~length;
+                    out[n++] = (unsigned char)(~length >> 8);
+                    inBlock = length;
+                }
+                unsigned char byte = i == 0 ? 0 : row[(i - 1) / 3 * 4 + (i - 1) % 3];
+                out[n++] = byte;
+                a = (a + byte) % 65521;
+                b = (b + a) % 65521;
+                inBlock--;
+                left--;
+            }
+        }
+        putBigEndian(out + n, (b << 16) | a);
+        n += 4;
+
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        fwrite(signature, 1, 8, f);
+        unsigned char ihdr[13];
+        putBigEndian(ihdr, width);
+        putBigEndian(ihdr + 4, height);
+        ihdr[8] = 8;    // bit depth
+        ihdr[9] = 2;    // RGB
+        ihdr[10] = ihdr[11] = ihdr[12] = 0;
+        writeChunk(f, "IHDR", ihdr, 13);
+        writeChunk(f, "IDAT", out, (unsigned)n);
+        writeChunk(f, "IEND", NULL, 0);
+        fclose(f);
+    }
+};
+
+#endif
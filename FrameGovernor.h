@@ -0,0 +1,58 @@
+#ifndef FRAME_GOVERNOR_H
+#define FRAME_GOVERNOR_H
+
+// Decides whether a frame is worth drawing. The caller passes revision
+// counters for the scene, the camera and the HUD; a frame is only drawn when
+// one of them moved since the last decision, and only the HUD region is
+// redrawn when nothing but the HUD changed.
+
+enum RedrawKind {
+    REDRAW_NONE,
+    REDRAW_HUD,
+    REDRAW_FULL
+};
+
+class FrameGovernor {
+public:
+    unsigned framesDrawn;
+    unsigned hudFramesDrawn;
+    unsigned framesSkipped;
+
+    FrameGovernor() : framesDrawn(0), hudFramesDrawn(0), framesSkipped(0),
+        lastScene(~0u), lastCamera(~0u), lastHud(~0u), forceFull(true) {}
+
+    RedrawKind decide(unsigned scene, unsigned camera, unsigned hud) {
+        RedrawKind kind = REDRAW_NONE;
+        if (forceFull || scene != lastScene || camera != lastCamera)
+            kind = REDRAW_FULL;
+        else if (hud != lastHud)
+            kind = REDRAW_HUD;
+        lastScene = scene;
+        lastCamera = camera;
+        lastHud = hud;
+        forceFull = false;
+        return kind;
+    }
+
+    // the next decision redraws everything (window exposed or resized)
+    void invalidate() {
+        forceFull = true;
+    }
+
+    void frameDrawn(RedrawKind kind) {
+        if (kind == REDRAW_HUD)
+            hudFramesDrawn++;
+        else
+            framesDrawn++;
+    }
+
+    void frameSkipped() {
+        framesSkipped++;
+    }
+
+private:
+    unsigned lastScene, lastCamera, lastHud;
+    bool forceFull;
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <stddef.h>
+#include <string.h>
+#include <glut.h>
+#ifndef _WIN32
+extern "C" void (*glXGetProcAddressARB(const GLubyte* name))();
+#endif
+
+// OpenGL entry points newer than the 1.1 headers that ship with Windows,
+// loaded at runtime once a context exists. Every feature that uses them
+// checks its flag and falls back to plain 1.1 when the driver lacks it.
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_STREAM_COPY
+#define GL_STREAM_COPY 0x88E2
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE 0x8861
+#endif
+#ifndef GL_COORD_REPLACE
+#define GL_COORD_REPLACE 0x8862
+#endif
+#ifndef GL_POINT_SIZE_MIN
+#define GL_POINT_SIZE_MIN 0x8126
+#endif
+#ifndef GL_POINT_SIZE_MAX
+#define GL_POINT_SIZE_MAX 0x8127
+#endif
+#ifndef GL_POINT_DISTANCE_ATTENUATION
+#define GL_POINT_DISTANCE_ATTENUATION 0x8129
+#endif
+#ifndef GL_SAMPLES_PASSED
+#define GL_SAMPLES_PASSED 0x8914
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_RENDERBUFFER
+#define GL_RENDERBUFFER 0x8D41
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_DEPTH_ATTACHMENT
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_READ_FRAMEBUFFER
+#define GL_READ_FRAMEBUFFER 0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+#define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+#ifndef GL_MAX_SAMPLES
+#define GL_MAX_SAMPLES 0x8D57
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_MAX_FRAGMENT_UNIFORM_COMPONENTS
+#define GL_MAX_FRAGMENT_UNIFORM_COMPONENTS 0x8B49
+#endif
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#endif
+
+typedef ptrdiff_t GLsizeiptrExt;
+typedef char GLcharExt;
+
+typedef void (APIENTRY* GenBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY* DeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+typedef void (APIENTRY* BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY* BufferDataProc)(GLenum target, GLsizeiptrExt size, const void* data, GLenum usage);
+typedef void* (APIENTRY* MapBufferProc)(GLenum target, GLenum access);
+typedef GLboolean (APIENTRY* UnmapBufferProc)(GLenum target);
+typedef void (APIENTRY* PointParameterfProc)(GLenum pname, GLfloat param);
+typedef void (APIENTRY* PointParameterfvProc)(GLenum pname, const GLfloat* params);
+typedef void (APIENTRY* GenQueriesProc)(GLsizei n, GLuint* ids);
+typedef void (APIENTRY* DeleteQueriesProc)(GLsizei n, const GLuint* ids);
+typedef void (APIENTRY* BeginQueryProc)(GLenum target, GLuint id);
+typedef void (APIENTRY* EndQueryProc)(GLenum target);
+typedef void (APIENTRY* GetQueryObjectuivProc)(GLuint id, GLenum pname, GLuint* params);
+typedef void (APIENTRY* GenFramebuffersProc)(GLsizei n, GLuint* ids);
+typedef void (APIENTRY* DeleteFramebuffersProc)(GLsizei n, const GLuint* ids);
+typedef void (APIENTRY* BindFramebufferProc)(GLenum target, GLuint framebuffer);
+typedef void (APIENTRY* FramebufferTexture2DProc)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum (APIENTRY* CheckFramebufferStatusProc)(GLenum target);
+typedef void (APIENTRY* GenRenderbuffersProc)(GLsizei n, GLuint* ids);
+typedef void (APIENTRY* DeleteRenderbuffersProc)(GLsizei n, const GLuint* ids);
+typedef void (APIENTRY* BindRenderbufferProc)(GLenum target, GLuint renderbuffer);
+typedef void (APIENTRY* RenderbufferStorageProc)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRY* FramebufferRenderbufferProc)(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+typedef void (APIENTRY* RenderbufferStorageMultisampleProc)(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRY* BlitFramebufferProc)(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+typedef GLuint (APIENTRY* CreateShaderProc)(GLenum type);
+typedef void (APIENTRY* DeleteShaderProc)(GLuint shader);
+typedef void (APIENTRY* ShaderSourceProc)(GLuint shader, GLsizei count, const GLcharExt* const* source, const GLint* length);
+typedef void (APIENTRY* CompileShaderProc)(GLuint shader);
+typedef void (APIENTRY* GetShaderivProc)(GLuint shader, GLenum pname, GLint* params);
+typedef GLuint (APIENTRY* CreateProgramProc)();
+typedef void (APIENTRY* AttachShaderProc)(GLuint program, GLuint shader);
+typedef void (APIENTRY* LinkProgramProc)(GLuint program);
+typedef void (APIENTRY* GetProgramivProc)(GLuint program, GLenum pname, GLint* params);
+typedef void (APIENTRY* UseProgramProc)(GLuint program);
+typedef GLint (APIENTRY* GetUniformLocationProc)(GLuint program, const GLcharExt* name);
+typedef void (APIENTRY* Uniform1iProc)(GLint location, GLint v0);
+typedef void (APIENTRY* Uniform2fProc)(GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRY* Uniform1fProc)(GLint location, GLfloat v0);
+typedef void (APIENTRY* Uniform3fProc)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+typedef void (APIENTRY* Uniform4fvProc)(GLint location, GLsizei count, const GLfloat* value);
+typedef void (APIENTRY* ActiveTextureProc)(GLenum texture);
+typedef void (APIENTRY* UniformMatrix4fvProc)(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+typedef void (APIENTRY* BindAttribLocationProc)(GLuint program, GLuint index, const GLcharExt* name);
+typedef void (APIENTRY* VertexAttrib4fvProc)(GLuint index, const GLfloat* v);
+
+struct GLExtensions {
+    bool loaded;
+    bool pixelBuffers;
+    bool pointParameters;   // point size attenuated by distance
+    bool pointSprites;      // textured points
+    bool occlusionQueries;
+    bool framebuffers;      // render to texture
+    bool multisampleFramebuffers;
+    bool shaders;           // GLSL, no ARB_shader_objects fallback
+
+    GenBuffersProc genBuffers;
+    DeleteBuffersProc deleteBuffers;
+    BindBufferProc bindBuffer;
+    BufferDataProc bufferData;
+    MapBufferProc mapBuffer;
+    UnmapBufferProc unmapBuffer;
+    PointParameterfProc pointParameterf;
+    PointParameterfvProc pointParameterfv;
+    GenQueriesProc genQueries;
+    DeleteQueriesProc deleteQueries;
+    BeginQueryProc beginQuery;
+    EndQueryProc endQuery;
+    GetQueryObjectuivProc getQueryObjectuiv;
+    GenFramebuffersProc genFramebuffers;
+    DeleteFramebuffersProc deleteFramebuffers;
+    BindFramebufferProc bindFramebuffer;
+    FramebufferTexture2DProc framebufferTexture2D;
+    CheckFramebufferStatusProc checkFramebufferStatus;
+    GenRenderbuffersProc genRenderbuffers;
+    DeleteRenderbuffersProc deleteRenderbuffers;
+    BindRenderbufferProc bindRenderbuffer;
+    RenderbufferStorageProc renderbufferStorage;
+    FramebufferRenderbufferProc framebufferRenderbuffer;
+    RenderbufferStorageMultisampleProc renderbufferStorageMultisample;
+    BlitFramebufferProc blitFramebuffer;
+    CreateShaderProc createShader;
+    DeleteShaderProc deleteShader;
+    ShaderSourceProc shaderSource;
+    CompileShaderProc compileShader;
+    GetShaderivProc getShaderiv;
+    CreateProgramProc createProgram;
+    AttachShaderProc attachShader;
+    LinkProgramProc linkProgram;
+    GetProgramivProc getProgramiv;
+    UseProgramProc useProgram;
+    GetUniformLocationProc getUniformLocation;
+    Uniform1iProc uniform1i;
+    Uniform2fProc uniform2f;
+    Uniform1fProc uniform1f;
+    Uniform3fProc uniform3f;
+    Uniform4fvProc uniform4fv;
+    ActiveTextureProc activeTexture;
+    UniformMatrix4fvProc uniformMatrix4fv;
+    BindAttribLocationProc bindAttribLocation;
+    VertexAttrib4fvProc vertexAttrib4fv;
+};
+
+// one for the program, however many files include this
+inline GLExtensions ext;
+
+inline void* getGLProc(const char* name) {
+#ifdef _WIN32
+    return (void*)wglGetProcAddress(name);
+#else
+    return (void*)glXGetProcAddressARB((const GLubyte*)name);
+#endif
+}
+
+inline void* getGLProc(const char* name, const char* suffix) {
+    char full[64];
+    strcpy(full, name);
+    strcat(full, suffix);
+    return getGLProc(full);
+}
+
+inline bool hasGLExtension(const char* name) {
+    const char* all = (const char*)glGetString(GL_EXTENSIONS);
+    if (!all)
+        return false;
+    size_t length = strlen(name);
+    for (const char* p = strstr(all, name); p; p = strstr(p + length, name)) {
+        if ((p == all || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+// major * 10 + minor of the current context, e.g. 21 for OpenGL 2.1
+inline int glVersion() {
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (!version || version[0] < '0' || version[0] > '9' || version[1] != '.')
+        return 11;
+    return (version[0] - '0') * 10 + (version[2] - '0');
+}
+
+// call once after glutCreateWindow
+inline void loadGLExtensions() {
+    if (ext.loaded)
+        return;
+    ext.loaded = true;
+    int version = glVersion();
+
+    ext.genBuffers = (GenBuffersProc)getGLProc("glGenBuffers");
+    ext.deleteBuffers = (DeleteBuffersProc)getGLProc("glDeleteBuffers");
+    ext.bindBuffer = (BindBufferProc)getGLProc("glBindBuffer");
+    ext.bufferData = (BufferDataProc)getGLProc("glBufferData");
+    ext.mapBuffer = (MapBufferProc)getGLProc("glMapBuffer");
+    ext.unmapBuffer = (UnmapBufferProc)getGLProc("glUnmapBuffer");
+    ext.pixelBuffers = (version >= 21 || hasGLExtension("GL_ARB_pixel_buffer_object"))
+        && ext.genBuffers && ext.deleteBuffers && ext.bindBuffer && ext.bufferData && ext.mapBuffer && ext.unmapBuffer;
+
+    ext.pointParameterf = (PointParameterfProc)getGLProc("glPointParameterf");
+    ext.pointParameterfv = (PointParameterfvProc)getGLProc("glPointParameterfv");
+    if (!ext.pointParameterf || !ext.pointParameterfv) {
+        ext.pointParameterf = (PointParameterfProc)getGLProc("glPointParameterfARB");
+        ext.pointParameterfv = (PointParameterfvProc)getGLProc("glPointParameterfvARB");
+    }
+    ext.pointParameters = (version >= 14 || hasGLExtension("GL_ARB_point_parameters"))
+        && ext.pointParameterf && ext.pointParameterfv;
+    ext.pointSprites = version >= 20 || hasGLExtension("GL_ARB_point_sprite");
+
+    // core since 1.5, ARB-suffixed before that
+    const char* suffix = version >= 15 ? "" : "ARB";
+    ext.genQueries = (GenQueriesProc)getGLProc("glGenQueries", suffix);
+    ext.deleteQueries = (DeleteQueriesProc)getGLProc("glDeleteQueries", suffix);
+    ext.beginQuery = (BeginQueryProc)getGLProc("glBeginQuery", suffix);
+    ext.endQuery = (EndQueryProc)getGLProc("glEndQuery", suffix);
+    ext.getQueryObjectuiv = (GetQueryObjectuivProc)getGLProc("glGetQueryObjectuiv", suffix);
+    ext.occlusionQueries = (version >= 15 || hasGLExtension("GL_ARB_occlusion_query"))
+        && ext.genQueries && ext.deleteQueries && ext.beginQuery && ext.endQuery && ext.getQueryObjectuiv;
+
+    // core since 3.0 and in ARB_framebuffer_object without a suffix, EXT
+    // before that; the enums are the same
+    bool coreFramebuffers = version >= 30 || hasGLExtension("GL_ARB_framebuffer_object");
+    suffix = coreFramebuffers ? "" : "EXT";
+    ext.genFramebuffers = (GenFramebuffersProc)getGLProc("glGenFramebuffers", suffix);
+    ext.deleteFramebuffers = (DeleteFramebuffersProc)getGLProc("glDeleteFramebuffers", suffix);
+    ext.bindFramebuffer = (BindFramebufferProc)getGLProc("glBindFramebuffer", suffix);
+    ext.framebufferTexture2D = (FramebufferTexture2DProc)getGLProc("glFramebufferTexture2D", suffix);
+    ext.checkFramebufferStatus = (CheckFramebufferStatusProc)getGLProc("glCheckFramebufferStatus", suffix);
+    ext.genRenderbuffers = (GenRenderbuffersProc)getGLProc("glGenRenderbuffers", suffix);
+    ext.deleteRenderbuffers = (DeleteRenderbuffersProc)getGLProc("glDeleteRenderbuffers", suffix);
+    ext.bindRenderbuffer = (BindRenderbufferProc)getGLProc("glBindRenderbuffer", suffix);
+    ext.renderbufferStorage = (RenderbufferStorageProc)getGLProc("glRenderbufferStorage", suffix);
+    ext.framebufferRenderbuffer = (FramebufferRenderbufferProc)getGLProc("glFramebufferRenderbuffer", suffix);
+    ext.framebuffers = (coreFramebuffers || hasGLExtension("GL_EXT_framebuffer_object"))
+        && ext.genFramebuffers && ext.deleteFramebuffers && ext.bindFramebuffer && ext.framebufferTexture2D
+        && ext.checkFramebufferStatus && ext.genRenderbuffers && ext.deleteRenderbuffers && ext.bindRenderbuffer
+        && ext.renderbufferStorage && ext.framebufferRenderbuffer;
+
+    // EXT_framebuffer_multisample and EXT_framebuffer_blit before 3.0
+    ext.renderbufferStorageMultisample = (RenderbufferStorageMultisampleProc)getGLProc("glRenderbufferStorageMultisample", suffix);
+    ext.blitFramebuffer = (BlitFramebufferProc)getGLProc("glBlitFramebuffer", suffix);
+    ext.multisampleFramebuffers = ext.framebuffers
+        && (coreFramebuffers || (hasGLExtension("GL_EXT_framebuffer_multisample") && hasGLExtension("GL_EXT_framebuffer_blit")))
+        && ext.renderbufferStorageMultisample && ext.blitFramebuffer;
+
+    ext.createShader = (CreateShaderProc)getGLProc("glCreateShader");
+    ext.deleteShader = (DeleteShaderProc)getGLProc("glDeleteShader");
+    ext.shaderSource = (ShaderSourceProc)getGLProc("glShaderSource");
+    ext.compileShader = (CompileShaderProc)getGLProc("glCompileShader");
+    ext.getShaderiv = (GetShaderivProc)getGLProc("glGetShaderiv");
+    ext.createProgram = (CreateProgramProc)getGLProc("glCreateProgram");
+    ext.attachShader = (AttachShaderProc)getGLProc("glAttachShader");
+    ext.linkProgram = (LinkProgramProc)getGLProc("glLinkProgram");
+    ext.getProgramiv = (GetProgramivProc)getGLProc("glGetProgramiv");
+    ext.useProgram = (UseProgramProc)getGLProc("glUseProgram");
+    ext.getUniformLocation = (GetUniformLocationProc)getGLProc("glGetUniformLocation");
+    ext.uniform1i = (Uniform1iProc)getGLProc("glUniform1i");
+    ext.uniform2f = (Uniform2fProc)getGLProc("glUniform2f");
+    ext.uniform1f = (Uniform1fProc)getGLProc("glUniform1f");
+    ext.uniform3f = (Uniform3fProc)getGLProc("glUniform3f");
+    ext.uniform4fv = (Uniform4fvProc)getGLProc("glUniform4fv");
+    // core since 1.3, so always there with GLSL
+    ext.activeTexture = (ActiveTextureProc)getGLProc("glActiveTexture");
+    ext.uniformMatrix4fv = (UniformMatrix4fvProc)getGLProc("glUniformMatrix4fv");
+    ext.bindAttribLocation = (BindAttribLocationProc)getGLProc("glBindAttribLocation");
+    ext.vertexAttrib4fv = (VertexAttrib4fvProc)getGLProc("glVertexAttrib4fv");
+    ext.shaders = version >= 20
+        && ext.createShader && ext.deleteShader && ext.shaderSource && ext.compileShader && ext.getShaderiv
+        && ext.createProgram && ext.attachShader && ext.linkProgram && ext.getProgramiv && ext.useProgram
+        && ext.getUniformLocation && ext.uniform1i && ext.uniform2f && ext.uniform1f && ext.uniform3f
+        && ext.uniform4fv && ext.activeTexture && ext.uniformMatrix4fv && ext.bindAttribLocation && ext.vertexAttrib4fv;
+}
+
+#endif
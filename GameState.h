@@ -0,0 +1,148 @@
+#ifndef GAME_STATE_H
+#define GAME_STATE_H
+
+#include "Scheduler.h"
+
+// Game rules as a state machine driven by simulation ticks and typed events.
+// Nothing here draws or plays audio: sound cues are queued for the platform
+// layer to drain, and rendering only reads the state, so frames can be
+// skipped or repeated without changing the game. The countdown and the
+// jingles are sequences on the scheduler, timed in simulation ticks.
+
+enum GameStatus {
+    STATE_PLAYING,
+    STATE_PAUSED,   // rides frozen with the space bar, the countdown keeps running
+    STATE_WON,
+    STATE_LOST
+};
+
+enum GameEventType {
+    GAME_EVENT_TOGGLE_PAUSE,
+    GAME_EVENT_TICKET_COLLECTED
+};
+
+enum SoundCue {
+    SOUND_NONE,
+    SOUND_ANIM,
+    SOUND_BACKGROUND,
+    SOUND_TICKET,
+    SOUND_WIN,
+    SOUND_LOSE
+};
+
+const int GAME_QUEUE_SIZE = 16;
+const int TICKS_PER_SECOND = 60;
+
+class GameState {
+public:
+    GameStatus status;
+    int timer;
+    bool ticketCollected;
+    bool countdownOver;
+
+    Scheduler scheduler;
+
+    GameState() : status(STATE_PLAYING), timer(120), ticketCollected(false), countdownOver(false),
+        jingles(0), eventCount(0), soundHead(0), soundCount(0) {
+        scheduler.spawn(countdown(scheduler, *this));
+    }
+
+    void post(GameEventType e) {
+        if (eventCount < GAME_QUEUE_SIZE)
+            events[eventCount++] = e;
+    }
+
+    // applies the events posted since the last tick, in order, then moves
+    // the sequences on by one tick
+    void tick() {
+        for (int i = 0; i < eventCount; i++)
+            handle(events[i]);
+        eventCount = 0;
+        scheduler.advance();
+    }
+
+    bool ridesMoving() const {
+        return status == STATE_PLAYING;
+    }
+
+    bool acceptsInput() const {
+        return timer > 0;
+    }
+
+    bool canCollectTicket() const {
+        return !ticketCollected && (status == STATE_PLAYING || status == STATE_PAUSED);
+    }
+
+    SoundCue nextSound() {
+        if (soundCount == 0)
+            return SOUND_NONE;
+        SoundCue cue = sounds[soundHead];
+        soundHead = (soundHead + 1) % GAME_QUEUE_SIZE;
+        soundCount--;
+        return cue;
+    }
+
+private:
+    unsigned jingles;       // started so far; only the latest resumes the music
+    GameEventType events[GAME_QUEUE_SIZE];
+    int eventCount;
+    SoundCue sounds[GAME_QUEUE_SIZE];
+    int soundHead, soundCount;
+
+    void playSound(SoundCue cue) {
+        if (soundCount < GAME_QUEUE_SIZE) {
+            sounds[(soundHead + soundCount) % GAME_QUEUE_SIZE] = cue;
+            soundCount++;
+        }
+    }
+
+    // the sequences run inside tick(), and the state they refer to is this
+    // object, so it must not be copied
+    GameState(const GameState&);
+    GameState& operator=(const GameState&);
+
+    static Sequence countdown(Scheduler& clock, GameState& game) {
+        while (game.timer > 0) {
+            co_await clock.wait(TICKS_PER_SECOND);
+            game.timer--;
+            if (game.timer == 0 && !game.ticketCollected)
+                game.status = STATE_LOST;
+        }
+        co_await clock.wait(TICKS_PER_SECOND);
+        game.countdownOver = true;
+        game.playSound(game.ticketCollected ? SOUND_WIN : SOUND_LOSE);
+    }
+
+    // background music resumes a second after the anim and ticket jingles
+    static Sequence jingle(Scheduler& clock, GameState& game, SoundCue cue) {
+        unsigned id = ++game.jingles;
+        game.playSound(cue);
+        co_await clock.wait(TICKS_PER_SECOND);
+        if (id == game.jingles && !game.countdownOver)
+            game.playSound(SOUND_BACKGROUND);
+    }
+
+    void handle(GameEventType e) {
+        switch (e) {
+        case GAME_EVENT_TOGGLE_PAUSE:
+            if (status == STATE_PLAYING)
+                status = STATE_PAUSED;
+            else if (status == STATE_PAUSED)
+                status = STATE_PLAYING;
+            else
+                break;
+            scheduler.spawn(jingle(scheduler, *this, SOUND_ANIM));
+            break;
+
+        case GAME_EVENT_TICKET_COLLECTED:
+            if (!canCollectTicket())
+                break;
+            ticketCollected = true;
+            status = STATE_WON;
+            scheduler.spawn(jingle(scheduler, *this, SOUND_TICKET));
+            break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef IMPOSTORS_H
+#define IMPOSTORS_H
+
+#include <math.h>
+#include <vector>
+#include "ParkMath.h"
+
+// Distant trees and rides drawn as camera-facing textured quads. Each kind
+// is rendered once, from IMPOSTOR_ANGLES directions around it, into a cell
+// of an atlas; a far object becomes one quad showing the cell nearest to
+// the direction it is seen from. Geometry is drawn until an object is
+// IMPOSTOR_DETAIL of its own heights away, and over the last IMPOSTOR_FADE
+// of that distance its quad fades in on top of it, so the switch is a
+// crossfade rather than a pop.
+//
+// The forest is tens of thousands of trees in a ring around the park. They
+// are binned into a grid once; every frame only the cells within the view
+// distance are visited, and each cell's quads stay together so every view
+// can cull them by cell.
+
+enum ImpostorKind {
+    IMPOSTOR_TREE,
+    IMPOSTOR_RED_BALLOON,
+    IMPOSTOR_BLUE_BALLOON,
+    IMPOSTOR_GREEN_BALLOON,
+    IMPOSTOR_FERRIS_WHEEL,
+    IMPOSTOR_KINDS
+};
+
+// the square of model space each kind is captured in: x from -size / 2 to
+// size / 2, y from bottom to bottom + size
+struct ImpostorFrame {
+    float bottom;
+    float size;
+};
+
+const ImpostorFrame impostorFrames[IMPOSTOR_KINDS] = {
+    { -0.06f, 0.3f },   // tree
+    { -0.29f, 0.45f },  // balloons
+    { -0.29f, 0.45f },
+    { -0.29f, 0.45f },
+    { -0.41f, 0.64f }   // Ferris wheel
+};
+
+const int IMPOSTOR_ANGLES = 8;
+const int IMPOSTOR_CELL = 96;           // pixels; the used part of the atlas must fit the window
+const int IMPOSTOR_ATLAS_WIDTH = 1024;
+const int IMPOSTOR_ATLAS_HEIGHT = 512;
+const float IMPOSTOR_DETAIL = 4.0f;
+const float IMPOSTOR_FADE = 0.25f;
+const float FOREST_CELL = 4.0f;         // world units per grid cell
+
+struct Impostor {
+    float x, y, z;
+    float scale;
+    float yaw;      // degrees about y, as the model would be rotated
+    int kind;
+};
+
+struct ImpostorVertex {
+    float x, y, z;
+    float u, v;
+    unsigned char r, g, b, a;
+};
+
+// quads [first, first + count) of one forest cell, with its bounds
+struct ImpostorBatch {
+    int first, count;
+    Vector3f center;
+    float radius;
+};
+
+// how much of an object's quad shows at this distance, 0 to 1; geometry
+// is set when the object itself still has to be drawn
+inline float impostorAlpha(const Impostor& o, float distance, bool& geometry) {
+    float detail = IMPOSTOR_DETAIL * impostorFrames[o.kind].size * o.scale;
+    geometry = distance < detail;
+    float t = (distance - detail * (1 - IMPOSTOR_FADE)) / (detail * IMPOSTOR_FADE);
+    return t < 0 ? 0 : t > 1 ? 1 : t;
+}
+
+// the quad turns about y to face the eye, keeping the object upright
+inline void writeImpostorQuad(const Impostor& o, const Vector3f& eye, float alpha, ImpostorVertex* out) {
+    float dx = eye.x - o.x, dz = eye.z - o.z;
+    float length = sqrtf(dx * dx + dz * dz);
+    if (length < 1e-6f) {
+        dx = 0;
+        dz = 1;
+    }
+    else {
+        dx /= length;
+        dz /= length;
+    }
+
+    // the cell captured nearest to the direction the eye is in, in the
+    // object's own frame
+    float angle = atan2f(dx, dz) * (180.0f / 3.14159265f) - o.yaw;
+    int cell = (int)floorf(angle / (360.0f / IMPOSTOR_ANGLES) + 0.5f) % IMPOSTOR_ANGLES;
+    if (cell < 0)
+        cell += IMPOSTOR_ANGLES;
+
+    const ImpostorFrame& frame = impostorFrames[o.kind];
+    float half = frame.size * o.scale / 2;
+    float rx = dz * half, rz = -dx * half;
+    float low = o.y + frame.bottom * o.scale, high = low + frame.size * o.scale;
+    // half a texel in, so filtering never reaches the next cell
+    float u0 = (cell * IMPOSTOR_CELL + 0.5f) / IMPOSTOR_ATLAS_WIDTH, u1 = ((cell + 1) * IMPOSTOR_CELL - 0.5f) / IMPOSTOR_ATLAS_WIDTH;
+    float v0 = (o.kind * IMPOSTOR_CELL + 0.5f) / IMPOSTOR_ATLAS_HEIGHT, v1 = ((o.kind + 1) * IMPOSTOR_CELL - 0.5f) / IMPOSTOR_ATLAS_HEIGHT;
+    unsigned char a = (unsigned char)(alpha * 255 + 0.5f);
+
+    ImpostorVertex corners[4] = {
+        { o.x - rx, low, o.z - rz, u0, v0, 255, 255, 255, a },
+        { o.x + rx, low, o.z + rz, u1, v0, 255, 255, 255, a },
+        { o.x + rx, high, o.z + rz, u1, v1, 255, 255, 255, a },
+        { o.x - rx, high, o.z - rz, u0, v1, 255, 255, 255, a }
+    };
+    for (int i = 0; i < 4; i++)
+        out[i] = corners[i];
+}
+
+class Forest {
+public:
+    Forest() : gridSize(0), extent(0) {}
+
+    int size() const {
+        return (int)trees.size();
+    }
+
+    // count trees scattered evenly over the ring between the two radii;
+    // height(x, z) is the ground under a tree
+    template <class Height>
+    void plant(int count, float innerRadius, float outerRadius, unsigned seed, Height height) {
+        extent = outerRadius;
+        gridSize = (int)ceilf(2 * outerRadius / FOREST_CELL);
+        std::vector<Impostor> planted;
+        planted.reserve(count);
+        while ((int)planted.size() < count) {
+            float x = (random(seed) * 2 - 1) * outerRadius, z = (random(seed) * 2 - 1) * outerRadius;
+            float r = sqrtf(x * x + z * z);
+            if (r < innerRadius || r > outerRadius)
+                continue;
+            Impostor tree;
+            tree.scale = 0.7f + 0.6f * random(seed);
+            tree.yaw = 360 * random(seed);
+            tree.x = x;
+            tree.z = z;
+            // the trunk's foot on the ground
+            tree.y = height(x, z) + 0.055f * tree.scale;
+            tree.kind = IMPOSTOR_TREE;
+            planted.push_back(tree);
+        }
+
+        // grouped by cell, so a cell is a range
+        cells.assign(gridSize * gridSize, Cell());
+        for (size_t i = 0; i < planted.size(); i++)
+            cells[cellOf(planted[i])].count++;
+        int first = 0;
+        for (size_t c = 0; c < cells.size(); c++) {
+            cells[c].first = first;
+            first += cells[c].count;
+            cells[c].count = 0;
+        }
+        trees.resize(planted.size());
+        for (size_t i = 0; i < planted.size(); i++) {
+            Cell& c = cells[cellOf(planted[i])];
+            trees[c.first + c.count++] = planted[i];
+            float top = planted[i].y + (impostorFrames[IMPOSTOR_TREE].bottom + impostorFrames[IMPOSTOR_TREE].size) * planted[i].scale;
+            if (c.count == 1 || planted[i].y < c.low)
+                c.low = planted[i].y;
+            if (c.count == 1 || top > c.high)
+                c.high = top;
+        }
+    }
+
+    // the quads of every tree within maxDistance of the eye, grouped into
+    // one batch per cell, from memory from alloc (a FrameArena); trees
+    // close enough to need their geometry go to nearTrees, up to
+    // nearCapacity, and the rest of them are drawn as opaque quads instead
+    template <class Allocator>
+    int prepare(const Vector3f& eye, float maxDistance, Allocator& alloc, ImpostorVertex*& vertices, ImpostorBatch*& batches,
+        const Impostor** nearTrees, int nearCapacity, int& nearCount) {
+        nearCount = 0;
+        if (trees.empty())
+            return 0;
+        int lowX = cellIndex(eye.x - maxDistance), highX = cellIndex(eye.x + maxDistance);
+        int lowZ = cellIndex(eye.z - maxDistance), highZ = cellIndex(eye.z + maxDistance);
+        int candidates = 0, candidateCells = 0;
+        for (int cz = lowZ; cz <= highZ; cz++) {
+            for (int cx = lowX; cx <= highX; cx++) {
+                candidates += cells[cz * gridSize + cx].count;
+                candidateCells++;
+            }
+        }
+        vertices = alloc.template allocateArray<ImpostorVertex>(candidates * 4);
+        batches = alloc.template allocateArray<ImpostorBatch>(candidateCells);
+        if (!vertices || !batches)
+            return 0;
+
+        float halfCell = FOREST_CELL / 2;
+        int batchCount = 0, quads = 0;
+        float maxSquared = maxDistance * maxDistance;
+        for (int cz = lowZ; cz <= highZ; cz++) {
+            for (int cx = lowX; cx <= highX; cx++) {
+                const Cell& cell = cells[cz * gridSize + cx];
+                if (cell.count == 0)
+                    continue;
+                ImpostorBatch& batch = batches[batchCount];
+                batch.first = quads * 4;
+                for (int i = cell.first; i < cell.first + cell.count; i++) {
+                    const Impostor& tree = trees[i];
+                    float dx = tree.x - eye.x, dy = tree.y - eye.y, dz = tree.z - eye.z;
+                    float squared = dx * dx + dy * dy + dz * dz;
+                    if (squared > maxSquared)
+                        continue;
+                    bool geometry;
+                    float alpha = impostorAlpha(tree, sqrtf(squared), geometry);
+                    if (geometry) {
+                        if (nearCount < nearCapacity)
+                            nearTrees[nearCount++] = &tree;
+                        else
+                            alpha = 1;
+                    }
+                    if (alpha > 0)
+                        writeImpostorQuad(tree, eye, alpha, &vertices[4 * quads++]);
+                }
+                batch.count = quads * 4 - batch.first;
+                if (batch.count == 0)
+                    continue;
+                float rise = (cell.high - cell.low) / 2;
+                batch.center = Vector3f(-extent + (cx + 0.5f) * FOREST_CELL, cell.low + rise, -extent + (cz + 0.5f) * FOREST_CELL);
+                batch.radius = sqrtf(2 * halfCell * halfCell + rise * rise) + impostorFrames[IMPOSTOR_TREE].size;
+                batchCount++;
+            }
+        }
+        return batchCount;
+    }
+
+private:
+    struct Cell {
+        int first, count;
+        float low, high;
+        Cell() : first(0), count(0), low(0), high(0) {}
+    };
+
+    std::vector<Impostor> trees;
+    std::vector<Cell> cells;
+    int gridSize;
+    float extent;
+
+    int cellIndex(float x) const {
+        int c = (int)floorf((x + extent) / FOREST_CELL);
+        return c < 0 ? 0 : c >= gridSize ? gridSize - 1 : c;
+    }
+
+    int cellOf(const Impostor& tree) const {
+        return cellIndex(tree.z) * gridSize + cellIndex(tree.x);
+    }
+
+    // the same sequence on every platform, unlike rand()
+    static float random(unsigned& seed) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+};
+
+#endif
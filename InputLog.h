@@ -0,0 +1,169 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Compact binary log of everything that drives the simulation: key presses,
+// special keys, simulation ticks and rendered frames. Each record is one type
+// byte, one key byte and the milliseconds since the previous record as a
+// variable-length integer, so an idle tick costs three bytes.
+
+enum InputEventType {
+    EVENT_KEY = 1,
+    EVENT_SPECIAL = 2,
+    EVENT_ANIM_TICK = 3,
+    // 4 was the 1 Hz countdown tick of version 1; the countdown now runs on anim ticks
+    EVENT_FRAME = 5,
+    EVENT_TICKET_PICKUP = 6
+};
+
+struct InputEvent {
+    unsigned time; // ms since the start of the recording
+    unsigned char type;
+    int key;
+};
+
+const char INPUT_LOG_MAGIC[4] = { 'D', 'P', 'R', 'L' };
+const unsigned char INPUT_LOG_VERSION = 2;
+
+class InputLog {
+public:
+    std::vector<InputEvent> events;
+
+    InputLog() : lastTime(0) {}
+
+    void add(unsigned time, InputEventType type, int key = 0) {
+        InputEvent e;
+        e.time = time < lastTime ? lastTime : time;
+        e.type = (unsigned char)type;
+        e.key = key;
+        events.push_back(e);
+        lastTime = e.time;
+    }
+
+    bool save(const char* path) const {
+        FILE* f = fopen(path, "wb");
+        if (!f)
+            return false;
+        fwrite(INPUT_LOG_MAGIC, 1, 4, f);
+        fputc(INPUT_LOG_VERSION, f);
+        unsigned previous = 0;
+        for (size_t i = 0; i < events.size(); i++) {
+            fputc(events[i].type, f);
+            fputc(events[i].key & 0xff, f);
+            unsigned delta = events[i].time - previous;
+            previous = events[i].time;
+            do {
+                unsigned char byte = delta & 0x7f;
+                delta >>= 7;
+                fputc(delta ? byte | 0x80 : byte, f);
+            } while (delta);
+        }
+        fclose(f);
+        return true;
+    }
+
+    bool load(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+            return false;
+        char magic[4];
+        if (fread(magic, 1, 4, f) != 4 || magic[0] != 'D' || magic[1] != 'P' || magic[2] != 'R' || magic[3] != 'L'
+            || fgetc(f) != INPUT_LOG_VERSION) {
+            fclose(f);
+            return false;
+        }
+        events.clear();
+        lastTime = 0;
+        int type;
+        while ((type = fgetc(f)) != EOF) {
+            int key = fgetc(f);
+            unsigned delta = 0;
+            int shift = 0;
+            int byte;
+            do {
+                byte = fgetc(f);
+                if (byte == EOF || key == EOF) {
+                    fclose(f);
+                    return false;
+                }
+                delta |= (unsigned)(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            add(lastTime + delta, (InputEventType)type, key);
+        }
+        fclose(f);
+        return true;
+    }
+
+private:
+    unsigned lastTime;
+};
+
+// Frame-time distribution of a replay, written as "name value" lines so two
+// builds can be compared with --compare.
+class FrameStats {
+public:
+    std::vector<double> frameMs;
+
+    double percentile(double p) const {
+        if (frameMs.empty())
+            return 0;
+        std::vector<double> sorted(frameMs);
+        std::sort(sorted.begin(), sorted.end());
+        size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[i];
+    }
+
+    double mean() const {
+        double sum = 0;
+        for (size_t i = 0; i < frameMs.size(); i++)
+            sum += frameMs[i];
+        return frameMs.empty() ? 0 : sum / frameMs.size();
+    }
+
+    void print(FILE* f) const {
+        fprintf(f, "frames %d\n", (int)frameMs.size());
+        fprintf(f, "mean_ms %.4f\n", mean());
+        fprintf(f, "p50_ms %.4f\n", percentile(50));
+        fprintf(f, "p90_ms %.4f\n", percentile(90));
+        fprintf(f, "p99_ms %.4f\n", percentile(99));
+        fprintf(f, "max_ms %.4f\n", percentile(100));
+    }
+
+    // prints this run next to a baseline written by print()
+    void compare(const char* baselinePath, FILE* out) const {
+        FILE* f = fopen(baselinePath, "r");
+        if (!f) {
+            fprintf(out, "cannot open baseline %s\n", baselinePath);
+            return;
+        }
+        char name[32];
+        double base;
+        fprintf(out, "%-8s %10s %10s %8s\n", "stat", "baseline", "current", "change");
+        while (fscanf(f, "%31s %lf", name, &base) == 2) {
+            double current;
+            if (strcmp(name, "frames") == 0)
+                current = (double)frameMs.size();
+            else if (strcmp(name, "mean_ms") == 0)
+                current = mean();
+            else if (strcmp(name, "p50_ms") == 0)
+                current = percentile(50);
+            else if (strcmp(name, "p90_ms") == 0)
+                current = percentile(90);
+            else if (strcmp(name, "p99_ms") == 0)
+                current = percentile(99);
+            else if (strcmp(name, "max_ms") == 0)
+                current = percentile(100);
+            else
+                continue;
+            fprintf(out, "%-8s %10.4f %10.4f %+7.1f%%\n", name, base, current, base > 0 ? (current - base) / base * 100.0 : 0.0);
+        }
+        fclose(f);
+    }
+};
+
+#endif
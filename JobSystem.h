@@ -0,0 +1,269 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool with one work-stealing deque per thread.
+// Thread 0 is the thread that called start() (the GLUT main thread); it
+// takes part in the work whenever it waits on a job. Running out of job
+// slots or continuations is a bug in the caller, so it aborts rather than
+// reuse a job that is still live.
+
+typedef void (*JobFunction)(void* data, int begin, int end);
+
+const int MAX_JOB_THREADS = 16;
+const int MAX_JOB_CONTINUATIONS = 8;
+const int JOB_POOL_SIZE = 4096; // per thread, must be a power of two
+
+struct Job {
+    JobFunction function;
+    void* data;
+    int begin, end;
+    int grain;                          // > 0 splits [begin, end) into children of at most grain items
+    Job* parent;
+    std::atomic<int> unfinished;        // this job plus its unfinished children
+    std::atomic<int> dependencies;      // unfinished predecessors plus one until run() is called
+    Job* continuations[MAX_JOB_CONTINUATIONS];
+    std::atomic<int> continuationCount;
+};
+
+class JobQueue {
+public:
+    JobQueue() : top(0), bottom(0) {}
+
+    void push(Job* job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bottom - top >= JOB_POOL_SIZE) {
+            fprintf(stderr, "job queue holds more than %d jobs\n", JOB_POOL_SIZE);
+            abort();
+        }
+        jobs[bottom & (JOB_POOL_SIZE - 1)] = job;
+        bottom++;
+    }
+
+    // owner end (LIFO, keeps caches warm)
+    Job* pop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bottom == top)
+            return nullptr;
+        bottom--;
+        return jobs[bottom & (JOB_POOL_SIZE - 1)];
+    }
+
+    // thief end (FIFO, takes the biggest remaining ranges)
+    Job* steal() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bottom == top)
+            return nullptr;
+        Job* job = jobs[top & (JOB_POOL_SIZE - 1)];
+        top++;
+        return job;
+    }
+
+private:
+    std::mutex mutex;
+    Job* jobs[JOB_POOL_SIZE];
+    long top, bottom;
+};
+
+class JobSystem {
+public:
+    JobSystem() : threadCount(1), running(false), queuedJobs(0) {
+        for (int i = 0; i < MAX_JOB_THREADS; i++) {
+            poolNext[i] = 0;
+            for (int j = 0; j < JOB_POOL_SIZE; j++)
+                pools[i][j].unfinished = 0;
+        }
+    }
+
+    ~JobSystem() {
+        stop();
+    }
+
+    void start(int threads) {
+        stop();
+        if (threads < 1)
+            threads = 1;
+        if (threads > MAX_JOB_THREADS)
+            threads = MAX_JOB_THREADS;
+        threadCount = threads;
+        threadIndex() = 0;
+        running = true;
+        for (int i = 1; i < threadCount; i++)
+            workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+
+    void stop() {
+        if (!running)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+        workers.clear();
+        threadCount = 1;
+    }
+
+    int getThreadCount() const {
+        return threadCount;
+    }
+
+    static int defaultThreadCount() {
+        int n = (int)std::thread::hardware_concurrency();
+        return n < 1 ? 1 : (n > MAX_JOB_THREADS ? MAX_JOB_THREADS : n);
+    }
+
+    Job* createJob(JobFunction function, void* data, int begin = 0, int end = 1, int grain = 0) {
+        return allocateJob(nullptr, function, data, begin, end, grain);
+    }
+
+    // predecessor must not have been run yet, and takes at most
+    // MAX_JOB_CONTINUATIONS dependents
+    void addDependency(Job* job, Job* predecessor) {
+        int slot = predecessor->continuationCount++;
+        if (slot >= MAX_JOB_CONTINUATIONS) {
+            fprintf(stderr, "job has more than %d continuations\n", MAX_JOB_CONTINUATIONS);
+            abort();
+        }
+        job->dependencies++;
+        predecessor->continuations[slot] = job;
+    }
+
+    // queues the job once all of its predecessors have finished
+    void run(Job* job) {
+        if (--job->dependencies == 0)
+            enqueue(job);
+    }
+
+    // executes other jobs until the given one has finished
+    void wait(const Job* job) {
+        while (job->unfinished.load() > 0) {
+            Job* next = findJob();
+            if (next)
+                execute(next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void parallelFor(int count, int grain, JobFunction function, void* data) {
+        if (count <= 0)
+            return;
+        if (threadCount == 1 || count <= grain) {
+            function(data, 0, count);
+            return;
+        }
+        Job* job = createJob(function, data, 0, count, grain);
+        run(job);
+        wait(job);
+    }
+
+private:
+    int threadCount;
+    std::vector<std::thread> workers;
+    JobQueue queues[MAX_JOB_THREADS];
+    Job pools[MAX_JOB_THREADS][JOB_POOL_SIZE];
+    unsigned poolNext[MAX_JOB_THREADS];
+    bool running;
+    std::atomic<int> queuedJobs;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    static int& threadIndex() {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    Job* allocateJob(Job* parent, JobFunction function, void* data, int begin, int end, int grain) {
+        int t = threadIndex();
+        Job* job = &pools[t][poolNext[t]++ & (JOB_POOL_SIZE - 1)];
+        if (job->unfinished.load() > 0) {
+            fprintf(stderr, "more than %d unfinished jobs on thread %d\n", JOB_POOL_SIZE, t);
+            abort();
+        }
+        job->function = function;
+        job->data = data;
+        job->begin = begin;
+        job->end = end;
+        job->grain = grain;
+        job->parent = parent;
+        job->unfinished = 1;
+        job->dependencies = 1;
+        job->continuationCount = 0;
+        if (parent)
+            parent->unfinished++;
+        return job;
+    }
+
+    void enqueue(Job* job) {
+        queues[threadIndex()].push(job);
+        queuedJobs++;
+        if (threadCount > 1) {
+            // taking the lock orders the increment before a sleeping worker's predicate check
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            wake.notify_one();
+        }
+    }
+
+    Job* findJob() {
+        int t = threadIndex();
+        Job* job = queues[t].pop();
+        if (!job) {
+            for (int i = 1; i < threadCount && !job; i++)
+                job = queues[(t + i) % threadCount].steal();
+        }
+        if (job)
+            queuedJobs--;
+        return job;
+    }
+
+    void execute(Job* job) {
+        if (job->grain > 0 && job->end - job->begin > job->grain) {
+            int mid = job->begin + (job->end - job->begin) / 2;
+            Job* left = allocateJob(job, job->function, job->data, job->begin, mid, job->grain);
+            Job* right = allocateJob(job, job->function, job->data, mid, job->end, job->grain);
+            run(right);
+            run(left);
+        }
+        else {
+            job->function(job->data, job->begin, job->end);
+        }
+        finish(job);
+    }
+
+    void finish(Job* job) {
+        if (--job->unfinished > 0)
+            return;
+        int count = job->continuationCount.load();
+        for (int i = 0; i < count; i++)
+            run(job->continuations[i]);
+        if (job->parent)
+            finish(job->parent);
+    }
+
+    void workerLoop(int index) {
+        threadIndex() = index;
+        while (true) {
+            Job* job = findJob();
+            if (job) {
+                execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (!running)
+                return;
+            wake.wait(lock, [this] { return !running || queuedJobs.load() > 0; });
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,481 @@
+#ifndef NAVIGATION_H
+#define NAVIGATION_H
+
+#include <algorithm>
+#include <vector>
+
+// Visitors find their way around the park floor by flow fields instead of
+// searching for a path each. The floor is a grid of NAV_CELL squares, open
+// or blocked (fences, the footprints of the rides); every destination has
+// a field holding, for each cell, the cost of the cheapest walk to the
+// destination and the one of the eight neighbours that walk starts with.
+// An agent looks up the cell it stands in and walks that way, whatever the
+// number of agents heading to the same place.
+//
+// Fields are built once, when the destination is added. When part of the
+// floor is blocked or opened again, only the cells whose walk went through
+// the change are cleared and filled in again from the cells around them,
+// so a barrier across one path costs about as much as the cells behind it.
+// Steps cost 10 straight and 14 diagonally, and a diagonal step may not
+// cut the corner of a blocked cell, so an agent moving less than a cell a
+// tick never enters one. With small integer costs the cells waiting to be
+// expanded sit in a ring of buckets, one per cost, rather than a heap.
+
+const float NAV_CELL = 0.01f;
+const unsigned NAV_STRAIGHT_COST = 10;
+const unsigned NAV_DIAGONAL_COST = 14;
+const unsigned NAV_UNREACHABLE = 0xffffffffu;
+const int NAV_BUCKETS = 16;            // more than the dearest step
+
+// directions 0 to 7 go anticlockwise from +x, odd ones diagonal
+const int navStepX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+const int navStepZ[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+const unsigned char NAV_GOAL = 8;      // in the destination
+const unsigned char NAV_NONE = 9;      // blocked, or the destination cannot be reached
+const float navDirectionX[10] = { 1, 0.7071068f, 0, -0.7071068f, -1, -0.7071068f, 0, 0.7071068f, 0, 0 };
+const float navDirectionZ[10] = { 0, 0.7071068f, 1, 0.7071068f, 0, -0.7071068f, -1, -0.7071068f, 0, 0 };
+
+class Navigation {
+public:
+    Navigation(float minX, float minZ, float maxX, float maxZ, float cellSize = NAV_CELL)
+        : originX(minX), originZ(minZ), cell(cellSize) {
+        columns = (int)((maxX - minX) / cellSize + 0.5f);
+        rows = (int)((maxZ - minZ) / cellSize + 0.5f);
+        blockedCells.assign(columns * rows, 0);
+    }
+
+    int width() const {
+        return columns;
+    }
+
+    int height() const {
+        return rows;
+    }
+
+    int destinations() const {
+        return (int)fields.size();
+    }
+
+    bool blocked(float x, float z) const {
+        return blockedCells[cellAt(x, z)] != 0;
+    }
+
+    // cells the layout change touches; fields follow on the next update()
+    void setBlocked(float minX, float minZ, float maxX, float maxZ, bool block) {
+        int x0 = column(minX), x1 = column(maxX), z0 = row(minZ), z1 = row(maxZ);
+        for (int z = z0; z <= z1; z++) {
+            for (int x = x0; x <= x1; x++) {
+                int c = z * columns + x;
+                if ((blockedCells[c] != 0) == block)
+                    continue;
+                blockedCells[c] = block;
+                changes.push_back(c);
+            }
+        }
+    }
+
+    // the open cells of the rectangle are the destination; returns its index
+    int addDestination(float minX, float minZ, float maxX, float maxZ) {
+        fields.push_back(Field());
+        Field& f = fields.back();
+        f.goalX0 = column(minX);
+        f.goalX1 = column(maxX);
+        f.goalZ0 = row(minZ);
+        f.goalZ1 = row(maxZ);
+        f.repairedCells = 0;
+        build(f);
+        return (int)fields.size() - 1;
+    }
+
+    bool layoutChanged() const {
+        return !changes.empty();
+    }
+
+    // brings one field up to date with the layout; fields can be repaired
+    // in parallel, then finishRepairs() once all of them are
+    void repair(int destination) {
+        Field& f = fields[destination];
+        f.invalid.clear();
+        f.stack.clear();
+        f.seeds.clear();
+        for (size_t i = 0; i < changes.size(); i++) {
+            int c = changes[i];
+            if (blockedCells[c]) {
+                invalidate(f, c, false);
+                // diagonal steps past the new corner
+                int cx = c % columns, cz = c / columns;
+                for (int d = 0; d < 8; d++) {
+                    int nx = cx + navStepX[d], nz = cz + navStepZ[d];
+                    if (nx < 0 || nx >= columns || nz < 0 || nz >= rows)
+                        continue;
+                    int n = nz * columns + nx;
+                    if (f.directions[n] < NAV_GOAL && !legal(n, f.directions[n]))
+                        invalidate(f, n, true);
+                }
+            }
+            else if (inGoal(f, c)) {
+                f.costs[c] = 0;
+                f.directions[c] = NAV_GOAL;
+                push(f, c);
+            }
+            else {
+                f.invalid.push_back(c);
+            }
+        }
+
+        // everything whose walk led through a cleared cell
+        while (!f.stack.empty()) {
+            int c = f.stack.back();
+            f.stack.pop_back();
+            int cx = c % columns, cz = c / columns;
+            for (int d = 0; d < 8; d++) {
+                int nx = cx + navStepX[d], nz = cz + navStepZ[d];
+                if (nx < 0 || nx >= columns || nz < 0 || nz >= rows)
+                    continue;
+                int n = nz * columns + nx;
+                // n steps back the opposite way to reach c
+                if (f.directions[n] == ((d + 4) & 7))
+                    invalidate(f, n, true);
+            }
+        }
+
+        // filled in again from the valid cells around them
+        for (size_t i = 0; i < f.invalid.size(); i++) {
+            int c = f.invalid[i];
+            int cx = c % columns, cz = c / columns;
+            for (int d = 0; d < 8; d++) {
+                int nx = cx + navStepX[d], nz = cz + navStepZ[d];
+                if (nx < 0 || nx >= columns || nz < 0 || nz >= rows)
+                    continue;
+                int n = nz * columns + nx;
+                if (f.costs[n] != NAV_UNREACHABLE)
+                    push(f, n);
+            }
+        }
+        propagate(f);
+    }
+
+    void finishRepairs() {
+        changes.clear();
+    }
+
+    void update() {
+        if (changes.empty())
+            return;
+        for (size_t i = 0; i < fields.size(); i++)
+            repair((int)i);
+        finishRepairs();
+    }
+
+    // which way to walk from (x, z): 0 to 7, NAV_GOAL or NAV_NONE
+    unsigned char direction(int destination, float x, float z) const {
+        return fields[destination].directions[cellAt(x, z)];
+    }
+
+    // steps to the destination, times NAV_STRAIGHT_COST
+    unsigned cost(int destination, float x, float z) const {
+        return fields[destination].costs[cellAt(x, z)];
+    }
+
+    // cells the repairs have visited so far, over all fields
+    unsigned long repairedCells() const {
+        unsigned long total = 0;
+        for (size_t i = 0; i < fields.size(); i++)
+            total += fields[i].repairedCells;
+        return total;
+    }
+
+    // somewhere open in the destination, e.g. to start an agent from
+    void goalPoint(int destination, unsigned& seed, float& x, float& z) const {
+        const Field& f = fields[destination];
+        for (int tries = 0; tries < 64; tries++) {
+            int cx = f.goalX0 + (int)(random(seed) * (f.goalX1 - f.goalX0 + 1));
+            int cz = f.goalZ0 + (int)(random(seed) * (f.goalZ1 - f.goalZ0 + 1));
+            x = originX + (cx + 0.5f) * cell;
+            z = originZ + (cz + 0.5f) * cell;
+            if (!blockedCells[cz * columns + cx])
+                return;
+        }
+    }
+
+    // the same sequence on every platform, unlike rand()
+    static float random(unsigned& seed) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+
+private:
+    struct Seed {
+        unsigned cost;
+        int cell;
+
+        bool operator<(const Seed& other) const {
+            return cost < other.cost;
+        }
+    };
+
+    struct Field {
+        std::vector<unsigned> costs;
+        std::vector<unsigned char> directions;
+        int goalX0, goalX1, goalZ0, goalZ1;
+        // scratch for repairs, kept so a repair does not allocate
+        std::vector<Seed> seeds;
+        std::vector<int> buckets[NAV_BUCKETS];
+        std::vector<int> stack;
+        std::vector<int> invalid;
+        unsigned long repairedCells;
+    };
+
+    float originX, originZ, cell;
+    int columns, rows;
+    std::vector<unsigned char> blockedCells;
+    std::vector<int> changes;
+    std::vector<Field> fields;
+
+    int column(float x) const {
+        int c = (int)((x - originX) / cell);
+        return c < 0 ? 0 : c >= columns ? columns - 1 : c;
+    }
+
+    int row(float z) const {
+        int r = (int)((z - originZ) / cell);
+        return r < 0 ? 0 : r >= rows ? rows - 1 : r;
+    }
+
+    int cellAt(float x, float z) const {
+        return row(z) * columns + column(x);
+    }
+
+    bool inGoal(const Field& f, int c) const {
+        int cx = c % columns, cz = c / columns;
+        return cx >= f.goalX0 && cx <= f.goalX1 && cz >= f.goalZ0 && cz <= f.goalZ1;
+    }
+
+    // the step stays on the grid, on open floor, and cuts no corner
+    bool legal(int c, int d) const {
+        int cx = c % columns, cz = c / columns;
+        int nx = cx + navStepX[d], nz = cz + navStepZ[d];
+        if (nx < 0 || nx >= columns || nz < 0 || nz >= rows || blockedCells[nz * columns + nx])
+            return false;
+        return (d & 1) == 0 || (!blockedCells[cz * columns + nx] && !blockedCells[nz * columns + cx]);
+    }
+
+    void invalidate(Field& f, int c, bool refill) {
+        if (f.costs[c] == NAV_UNREACHABLE)
+            return;
+        f.costs[c] = NAV_UNREACHABLE;
+        f.directions[c] = NAV_NONE;
+        f.stack.push_back(c);
+        if (refill)
+            f.invalid.push_back(c);
+    }
+
+    void push(Field& f, int c) {
+        Seed s = { f.costs[c], c };
+        f.seeds.push_back(s);
+    }
+
+    void build(Field& f) {
+        f.costs.assign(columns * rows, NAV_UNREACHABLE);
+        f.directions.assign(columns * rows, NAV_NONE);
+        f.seeds.clear();
+        for (int z = f.goalZ0; z <= f.goalZ1; z++) {
+            for (int x = f.goalX0; x <= f.goalX1; x++) {
+                int c = z * columns + x;
+                if (blockedCells[c])
+                    continue;
+                f.costs[c] = 0;
+                f.directions[c] = NAV_GOAL;
+                push(f, c);
+            }
+        }
+        propagate(f);
+    }
+
+    // Dijkstra from the seeds; costs only ever go down, so it serves a
+    // first build and a repair alike. Every cost waiting in the buckets is
+    // within a step of the one being expanded, so the ring never wraps onto
+    // itself, and the seeds join in as the expanded cost reaches theirs.
+    void propagate(Field& f) {
+        std::sort(f.seeds.begin(), f.seeds.end());
+        size_t nextSeed = 0;
+        int pending = 0;
+        unsigned current = 0;
+        while (pending > 0 || nextSeed < f.seeds.size()) {
+            if (pending == 0 && f.seeds[nextSeed].cost > current)
+                current = f.seeds[nextSeed].cost;
+            std::vector<int>& bucket = f.buckets[current % NAV_BUCKETS];
+            for (; nextSeed < f.seeds.size() && f.seeds[nextSeed].cost == current; nextSeed++) {
+                bucket.push_back(f.seeds[nextSeed].cell);
+                pending++;
+            }
+            // steps add at least NAV_STRAIGHT_COST, so this bucket only shrinks
+            for (size_t i = 0; i < bucket.size(); i++) {
+                int c = bucket[i];
+                pending--;
+                if (f.costs[c] == current)
+                    pending += expand(f, c, current);
+            }
+            bucket.clear();
+            current++;
+        }
+    }
+
+    // relaxes the eight neighbours of c; returns how many were queued
+    int expand(Field& f, int c, unsigned cost) {
+        f.repairedCells++;
+        int cx = c % columns, cz = c / columns;
+        const unsigned char* b = &blockedCells[c];
+        bool east = cx + 1 < columns && !b[1], west = cx > 0 && !b[-1];
+        bool north = cz + 1 < rows && !b[columns], south = cz > 0 && !b[-columns];
+        int queued = 0;
+        if (east)
+            queued += relax(f, c + 1, cost + NAV_STRAIGHT_COST, 4);
+        if (north)
+            queued += relax(f, c + columns, cost + NAV_STRAIGHT_COST, 6);
+        if (west)
+            queued += relax(f, c - 1, cost + NAV_STRAIGHT_COST, 0);
+        if (south)
+            queued += relax(f, c - columns, cost + NAV_STRAIGHT_COST, 2);
+        if (east && north && !b[columns + 1])
+            queued += relax(f, c + columns + 1, cost + NAV_DIAGONAL_COST, 5);
+        if (west && north && !b[columns - 1])
+            queued += relax(f, c + columns - 1, cost + NAV_DIAGONAL_COST, 7);
+        if (west && south && !b[-columns - 1])
+            queued += relax(f, c - columns - 1, cost + NAV_DIAGONAL_COST, 1);
+        if (east && south && !b[-columns + 1])
+            queued += relax(f, c - columns + 1, cost + NAV_DIAGONAL_COST, 3);
+        return queued;
+    }
+
+    // n is reached for cost by stepping back the way given
+    int relax(Field& f, int n, unsigned cost, int back) {
+        if (cost >= f.costs[n])
+            return 0;
+        f.costs[n] = cost;
+        f.directions[n] = (unsigned char)back;
+        f.buckets[cost % NAV_BUCKETS].push_back(n);
+        return 1;
+    }
+
+    Navigation(const Navigation&);
+    Navigation& operator=(const Navigation&);
+};
+
+// a visitor: walks to its first destination, then to ridesPerVisit others
+// picked at random, then out of the exit, where the next visitor comes in
+struct NavAgent {
+    float x, z;
+    int destination;
+    unsigned char heading;      // the direction it last walked
+    unsigned char ridesLeft;
+    unsigned seed;
+};
+
+class Crowd {
+public:
+    std::vector<NavAgent> agents;
+
+    Crowd() : firstDestination(0), exitDestination(0), ridesPerVisit(0) {}
+
+    // count agents at the exit, on their way to the first destination
+    void spawn(const Navigation& nav, int count, int first, int exit, int rides, unsigned seed) {
+        firstDestination = first;
+        exitDestination = exit;
+        ridesPerVisit = rides;
+        agents.resize(count);
+        for (int i = 0; i < count; i++) {
+            NavAgent& a = agents[i];
+            a.seed = seed + i * 2654435761u;
+            enter(nav, a);
+            // spread over their visits, rather than all arriving at once
+            int skip = (int)(Navigation::random(a.seed) * (ridesPerVisit + 1));
+            for (int s = 0; s < skip; s++)
+                next(nav, a);
+            nav.goalPoint(a.destination, a.seed, a.x, a.z);
+        }
+    }
+
+    // one tick for agents [begin, end); ranges can run in parallel
+    void step(const Navigation& nav, int begin, int end, float speed) {
+        for (int i = begin; i < end; i++) {
+            NavAgent& a = agents[i];
+            unsigned char d = nav.direction(a.destination, a.x, a.z);
+            if (d == NAV_GOAL || d == NAV_NONE) {
+                next(nav, a);
+                continue;
+            }
+            a.x += navDirectionX[d] * speed;
+            a.z += navDirectionZ[d] * speed;
+            a.heading = d;
+        }
+    }
+
+private:
+    int firstDestination, exitDestination, ridesPerVisit;
+
+    void enter(const Navigation& nav, NavAgent& a) {
+        nav.goalPoint(exitDestination, a.seed, a.x, a.z);
+        a.destination = firstDestination;
+        a.heading = 2;
+        a.ridesLeft = (unsigned char)ridesPerVisit;
+    }
+
+    void next(const Navigation& nav, NavAgent& a) {
+        if (a.destination == exitDestination) {
+            enter(nav, a);
+            return;
+        }
+        if (a.ridesLeft == 0 || nav.destinations() <= 2) {
+            a.destination = exitDestination;
+            return;
+        }
+        a.ridesLeft--;
+        int rides = nav.destinations() - 2, d;
+        do
+            d = (int)(Navigation::random(a.seed) * nav.destinations());
+        while (d == firstDestination || d == exitDestination || (d == a.destination && rides > 1));
+        a.destination = d;
+    }
+};
+
+// the fenced park on the plateau, in world units; the side of the park
+// facing +z is open and is where visitors come and go
+enum ParkDestination {
+    DEST_TICKET_STAND,
+    DEST_FERRIS_WHEEL,
+    DEST_SWING,
+    DEST_RED_BALLOON,
+    DEST_BLUE_BALLOON,
+    DEST_GREEN_BALLOON,
+    DEST_EXIT,
+    PARK_DESTINATIONS
+};
+
+const float PARK_NAV_EXTENT = 1.0f;
+
+inline void layOutPark(Navigation& nav) {
+    // fences: back and both sides
+    nav.setBlocked(-0.51f, -0.51f, 0.51f, -0.49f, true);
+    nav.setBlocked(-0.51f, -0.51f, -0.49f, 0.51f, true);
+    nav.setBlocked(0.49f, -0.51f, 0.51f, 0.51f, true);
+    // Ferris wheel, ticket stand, swing and the two trees
+    nav.setBlocked(-0.2f, -0.46f, 0.2f, -0.38f, true);
+    nav.setBlocked(-0.45f, 0.26f, -0.39f, 0.44f, true);
+    nav.setBlocked(-0.45f, -0.12f, -0.33f, 0.12f, true);
+    nav.setBlocked(0.27f, -0.23f, 0.33f, -0.17f, true);
+    nav.setBlocked(0.395f, 0.075f, 0.445f, 0.125f, true);
+
+    // where each is queued for: the ticket window, in front of the rides,
+    // under the balloons (two of them hang outside the fence)
+    nav.addDestination(-0.37f, 0.31f, -0.34f, 0.39f);
+    nav.addDestination(-0.05f, -0.36f, 0.05f, -0.33f);
+    nav.addDestination(-0.31f, -0.05f, -0.28f, 0.05f);
+    nav.addDestination(0.44f, 0.17f, 0.47f, 0.23f);
+    nav.addDestination(0.57f, 0.27f, 0.63f, 0.33f);
+    nav.addDestination(-0.43f, -0.63f, -0.37f, -0.57f);
+    nav.addDestination(-0.3f, 0.92f, 0.3f, 0.98f);
+    nav.finishRepairs();
+}
+
+#endif
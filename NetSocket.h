@@ -0,0 +1,137 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "ParkNet.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Non-blocking IPv4 UDP socket for ParkServer and ParkClient. Lost or
+// reordered datagrams are fine: snapshots are deltas against acknowledged
+// state and inputs are repeated until acknowledged.
+
+class NetSocket {
+public:
+    NetSocket() : handle(INVALID) {}
+
+    ~NetSocket() {
+        close();
+    }
+
+    // port 0 picks any free port, as a client does
+    bool open(unsigned short port) {
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+            return false;
+#endif
+        handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (handle == INVALID)
+            return false;
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons(port);
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        bool ok = bind(handle, (sockaddr*)&local, sizeof(local)) == 0 && ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+        bool ok = bind(handle, (sockaddr*)&local, sizeof(local)) == 0 && fcntl(handle, F_SETFL, O_NONBLOCK) == 0;
+#endif
+        if (!ok)
+            close();
+        return ok;
+    }
+
+    void close() {
+        if (handle == INVALID)
+            return;
+#ifdef _WIN32
+        closesocket(handle);
+        WSACleanup();
+#else
+        ::close(handle);
+#endif
+        handle = INVALID;
+    }
+
+    void sendTo(const NetAddress& to, const unsigned char* data, int size) {
+        sockaddr_in remote = socketAddress(to);
+        sendto(handle, (const char*)data, size, 0, (sockaddr*)&remote, sizeof(remote));
+    }
+
+    // one waiting datagram, or 0 when there is none
+    int receiveFrom(NetAddress& from, unsigned char* data, int capacity) {
+        sockaddr_in remote;
+        socklen_t length = sizeof(remote);
+        int size = (int)recvfrom(handle, (char*)data, capacity, 0, (sockaddr*)&remote, &length);
+        if (size <= 0)
+            return 0;
+        from.host = ntohl(remote.sin_addr.s_addr);
+        from.port = ntohs(remote.sin_port);
+        return size;
+    }
+
+    // NetSendFunction for a NetSocket passed as the context
+    static void send(void* context, const NetAddress& to, const unsigned char* data, int size) {
+        ((NetSocket*)context)->sendTo(to, data, size);
+    }
+
+private:
+#ifdef _WIN32
+    typedef SOCKET Handle;
+    static const SOCKET INVALID = INVALID_SOCKET;
+#else
+    typedef int Handle;
+    static const int INVALID = -1;
+#endif
+    Handle handle;
+
+    static sockaddr_in socketAddress(const NetAddress& address) {
+        sockaddr_in s;
+        memset(&s, 0, sizeof(s));
+        s.sin_family = AF_INET;
+        s.sin_addr.s_addr = htonl(address.host);
+        s.sin_port = htons(address.port);
+        return s;
+    }
+};
+
+// "host:port" with a dotted IPv4 host or a name to look up
+inline bool parseNetAddress(const char* text, NetAddress& address) {
+    const char* colon = strrchr(text, ':');
+    if (!colon || colon == text)
+        return false;
+    char host[256];
+    size_t length = colon - text;
+    if (length >= sizeof(host))
+        return false;
+    memcpy(host, text, length);
+    host[length] = '\0';
+    int port = atoi(colon + 1);
+    if (port <= 0 || port > 65535)
+        return false;
+    hostent* entry = gethostbyname(host);
+    if (!entry || entry->h_addrtype != AF_INET)
+        return false;
+    in_addr ip;
+    memcpy(&ip, entry->h_addr_list[0], sizeof(ip));
+    address.host = ntohl(ip.s_addr);
+    address.port = (unsigned short)port;
+    return true;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include "GLExt.h"
+#include "ParkMath.h"
+
+// Occlusion culling with hardware queries whose results are only read once
+// the GPU has them, never waiting. Objects are drawn after the big
+// occluders; one that was visible last time is drawn inside a query, one
+// that was hidden is skipped and only its bounding box is tested, so it
+// reappears one frame after it comes into view. Without query support
+// everything is drawn.
+
+const int MAX_OCCLUSION_OBJECTS = 16;
+
+class OcclusionCuller {
+public:
+    bool enabled;
+    int tested, skipped;                    // this frame
+    unsigned totalTested, totalSkipped;     // since start
+
+    OcclusionCuller() : enabled(true), tested(0), skipped(0), totalTested(0), totalSkipped(0), created(false), active(-1) {
+        for (int i = 0; i < MAX_OCCLUSION_OBJECTS; i++) {
+            objects[i].query = 0;
+            objects[i].pending = false;
+            objects[i].visible = true;
+        }
+    }
+
+    bool supported() const {
+        return ext.occlusionQueries;
+    }
+
+    void beginFrame(const Vector3f& eyePosition) {
+        eye = eyePosition;
+        tested = 0;
+        skipped = 0;
+    }
+
+    // true: draw the object now and call endDraw() after it; false: it was
+    // hidden last time and a box query has been issued in its place
+    bool beginDraw(int id, const Vector3f& low, const Vector3f& high) {
+        if (!enabled || !supported())
+            return true;
+        create();
+        Object& o = objects[id];
+        collect(o);
+        tested++;
+        totalTested++;
+
+        // the near plane would clip the box away from a camera inside it
+        if (eye.x > low.x && eye.y > low.y && eye.z > low.z && eye.x < high.x && eye.y < high.y && eye.z < high.z) {
+            o.visible = true;
+            return true;
+        }
+
+        // the last query is still in flight, go with what it said before
+        if (o.pending) {
+            if (!o.visible)
+                countSkipped();
+            return o.visible;
+        }
+
+        o.pending = true;
+        if (o.visible) {
+            ext.beginQuery(GL_SAMPLES_PASSED, o.query);
+            active = id;
+            return true;
+        }
+
+        countSkipped();
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        ext.beginQuery(GL_SAMPLES_PASSED, o.query);
+        drawBox(low, high);
+        ext.endQuery(GL_SAMPLES_PASSED);
+        glPopAttrib();
+        return false;
+    }
+
+    void endDraw(int id) {
+        if (active == id) {
+            ext.endQuery(GL_SAMPLES_PASSED);
+            active = -1;
+        }
+    }
+
+    // picks up finished queries without waiting; true when a hidden object
+    // has come into view, so the caller should draw another frame
+    bool poll() {
+        if (!created)
+            return false;
+        bool appeared = false;
+        for (int i = 0; i < MAX_OCCLUSION_OBJECTS; i++) {
+            bool wasVisible = objects[i].visible;
+            collect(objects[i]);
+            if (!wasVisible && objects[i].visible)
+                appeared = true;
+        }
+        return appeared;
+    }
+
+    // everything counts as visible again, e.g. after turning culling back on
+    void reset() {
+        for (int i = 0; i < MAX_OCCLUSION_OBJECTS; i++) {
+            objects[i].pending = false;
+            objects[i].visible = true;
+        }
+    }
+
+    float skippedPercent() const {
+        return tested == 0 ? 0.0f : 100.0f * skipped / tested;
+    }
+
+    float totalSkippedPercent() const {
+        return totalTested == 0 ? 0.0f : 100.0f * totalSkipped / totalTested;
+    }
+
+private:
+    struct Object {
+        GLuint query;
+        bool pending;
+        bool visible;
+    };
+
+    Object objects[MAX_OCCLUSION_OBJECTS];
+    bool created;
+    int active;
+    Vector3f eye;
+
+    void create() {
+        if (created)
+            return;
+        created = true;
+        GLuint queries[MAX_OCCLUSION_OBJECTS];
+        ext.genQueries(MAX_OCCLUSION_OBJECTS, queries);
+        for (int i = 0; i < MAX_OCCLUSION_OBJECTS; i++)
+            objects[i].query = queries[i];
+    }
+
+    void collect(Object& o) {
+        if (!o.pending)
+            return;
+        GLuint available = 0;
+        ext.getQueryObjectuiv(o.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint samples = 0;
+        ext.getQueryObjectuiv(o.query, GL_QUERY_RESULT, &samples);
+        o.visible = samples > 0;
+        o.pending = false;
+    }
+
+    void countSkipped() {
+        skipped++;
+        totalSkipped++;
+    }
+
+    static void drawBox(const Vector3f& l, const Vector3f& h) {
+        glBegin(GL_QUADS);
+        glVertex3f(l.x, l.y, l.z); glVertex3f(h.x, l.y, l.z); glVertex3f(h.x, h.y, l.z); glVertex3f(l.x, h.y, l.z);
+        glVertex3f(l.x, l.y, h.z); glVertex3f(l.x, h.y, h.z); glVertex3f(h.x, h.y, h.z); glVertex3f(h.x, l.y, h.z);
+        glVertex3f(l.x, l.y, l.z); glVertex3f(l.x, h.y, l.z); glVertex3f(l.x, h.y, h.z); glVertex3f(l.x, l.y, h.z);
+        glVertex3f(h.x, l.y, l.z); glVertex3f(h.x, l.y, h.z); glVertex3f(h.x, h.y, h.z); glVertex3f(h.x, h.y, l.z);
+        glVertex3f(l.x, l.y, l.z); glVertex3f(l.x, l.y, h.z); glVertex3f(h.x, l.y, h.z); glVertex3f(h.x, l.y, l.z);
+        glVertex3f(l.x, h.y, l.z); glVertex3f(h.x, h.y, l.z); glVertex3f(h.x, h.y, h.z); glVertex3f(l.x, h.y, h.z);
+        glEnd();
+    }
+};
+
+#endif
@@ -1,832 +1,1516 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <winsock2.h>   // before windows.h, which would pull in the old winsock.h
 #include <windows.h>
 #include <glut.h>
+#include "Park.h"
+#include "Camera.h"
+#include "JobSystem.h"
+#include "InputLog.h"
+#include "GameState.h"
+#include "FrameGovernor.h"
+#include "GLExt.h"
+#include "FrameCapture.h"
+#include "TextRenderer.h"
+#include "ParticleSystem.h"
+#include "OcclusionCuller.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "DrawCommands.h"
+#include "DynamicResolution.h"
+#include "AntiAliasing.h"
+#include "ParkNet.h"
+#include "NetSocket.h"
+#include "ParkMeshes.h"
+#include "AssetPack.h"
+#include "Terrain.h"
+#include "Impostors.h"
+#include "Navigation.h"
+#include "ClusterShader.h"
+#include "RideShader.h"
 
 #define GLUT_KEY_ESCAPE 27
-#define DEG2RAD(a) (a * 0.0174532925)
-
-const int screenWidth = 1200;
-const int screenHeight = 600;
-int timer = 120;
-bool animationsActive = true;
-int ticketSoundDelay = 1;
-int animationSoundDelay = -1;
-GLboolean win = false;
-GLboolean lose = false;
-bool soundPlayed = false;
-
-class Vector3f {
-public:
-    float x, y, z;
-
-    Vector3f(float _x = 0.0f, float _y = 0.0f, float _z = 0.0f) {
-        x = _x;
-        y = _y;
-        z = _z;
-    }
-
-    Vector3f operator+(const Vector3f& v) const {
-        return Vector3f(x + v.x, y + v.y, z + v.z);
-    }
 
-    Vector3f operator-(const Vector3f& v) const {
-        return Vector3f(x - v.x, y - v.y, z - v.z);
-    }
+// window size, starting at 1200x600 and updated by Reshape
+int screenWidth = 1200;
+int screenHeight = 600;
+bool soundEnabled = true;
+
+// --record / --replay
+InputLog inputLog;
+const char* recordPath = NULL;
+const char* replayPath = NULL;
+const char* frameTimesPath = NULL;
+const char* comparePath = NULL;
+bool replayFast = false;
+bool replayDiverged = false;
+size_t replayCursor = 0;
+int replayStartTime = 0;
+FrameStats frameStats;
+
+// baked meshes and sounds, mapped for the whole run (--pack)
+AssetPack assetPack;
+const char* packPath = "park.pack";
+std::chrono::steady_clock::time_point startTime;
+bool firstFrameDrawn = false;
+
+// from the pack when it has the sound, otherwise loaded by PlaySound
+void playSound(const char* name) {
+    if (!soundEnabled)
+        return;
+    char key[ASSET_NAME_LENGTH];
+    snprintf(key, sizeof(key), "sound/%s", name);
+    const void* wav = assetPack.find(key);
+    if (wav)
+        PlaySoundA((LPCSTR)wav, NULL, SND_ASYNC | SND_MEMORY);
+    else
+        PlaySoundA(name, NULL, SND_ASYNC);
+}
 
-    Vector3f operator*(float n) const {
-        return Vector3f(x * n, y * n, z * n);
-    }
+void recordEvent(InputEventType type, int key = 0) {
+    if (recordPath)
+        inputLog.add(glutGet(GLUT_ELAPSED_TIME), type, key);
+}
 
-    Vector3f operator/(float n) const {
-        return Vector3f(x / n, y / n, z / n);
-    }
+void saveRecording() {
+    if (recordPath && !inputLog.save(recordPath))
+        printf("could not write recording %s\n", recordPath);
+}
 
-    Vector3f unit() const {
-        float magnitude = sqrt(x * x + y * y + z * z);
-        return (*this) / magnitude;
-    }
+Camera camera;
+Fence fence;
+Player player;
+FerrisWheel ferrisWheel;
+HotAirBalloon hotAirBalloon;
+Swing swing;
+Tree tree;
+TicketStand ticketStand;
+Ticket ticket;
+JobSystem jobs;
+GameState game;
+
+// --server <port> runs a headless shared park; --connect <host:port> plays
+// in one, with the rides, the ticket and the other players coming from it
+const char* connectAddress = NULL;
+int serverPort = 0;
+NetSocket netSocket;
+ParkClient* netClient = NULL;
+unsigned char netPacket[MAX_PACKET_SIZE];
+int netTickets = 0;
+
+// render on demand
+FrameGovernor governor;
+RedrawKind pendingRedraw = REDRAW_NONE;
+unsigned sceneRevision = 0;
+// the strip runs down past the descenders of the lowest hud line
+int hudX = 0, hudY = screenHeight - 110, hudWidth = screenWidth, hudHeight = 110;
+std::vector<unsigned char> hudBackdrop(hudWidth * hudHeight * 4);
+GLuint hudBackdropBuffer = 0;         // pixel buffer holding it on the GPU, if any
+size_t hudBackdropBufferSize = 0;
+
+// the scene is drawn at a fraction of the window size chosen to hold the
+// frame time, then stretched; the HUD stays at window resolution ('r')
+ResolutionController resolution(16.0);
+SceneTarget sceneTarget;
+bool dynamicResolution = true;
+const char* scaleLogPath = NULL;
+FILE* scaleLog = NULL;
+
+// anti-aliasing ('x' cycles, --aa picks one), with the cost of full frames
+// drawn in each mode
+AAMode aaMode = AA_OFF;
+EdgeFilter edgeFilter;
+unsigned aaFrames[AA_MODE_COUNT];
+double aaFrameMs[AA_MODE_COUNT];
+double aaScale[AA_MODE_COUNT];
+
+// HUD text, drawn from the glyph atlas in one batch
+enum TextSlot {
+    TEXT_MESSAGE,
+    TEXT_SCORE,
+    TEXT_TIMER,
+    TEXT_DIAGNOSTICS,
+    TEXT_LIGHTING,
+    TEXT_ANIMATION,
+    TEXT_VIEW_LABEL     // one per view, VIEW_COUNT slots
+};
 
-    Vector3f cross(const Vector3f& v) const {
-        return Vector3f(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
-    }
+TextRenderer text;
+bool showDiagnostics = false;   // 'h'
+unsigned diagnosticsRevision = 0;
+unsigned diagnosticsTicks = 0;
+double lastFrameMs = 0;
+
+// --capture / 'v'
+FrameCapture capture;
+const char* capturePath = "capture.y4m";
+
+// confetti at the ticket, then fireworks over the Ferris wheel after a win
+ParticleSystem particles;
+GLuint particleTexture = 0;
+const int FIREWORK_SHELLS = 12;
+const int FIREWORK_INTERVAL = 40;   // ticks between shells
+const int FIREWORK_SPARKS = 8000;
+int fireworksLaunched = 0;
+int fireworkTicks = 0;
+
+// attractions drawn after the big rides and tested against them ('o')
+bool occlusionEnabled = true;
+const int OCCLUDEE_COUNT = 8;
+const int OCCLUDEE_TICKET = 7;
+
+// 't', 'f' and 'c' camera presets, also the fixed views of the split screen
+const Vector3f presetEyes[3] = {
+    Vector3f(0.0160754, 1.27918, -0.048015),
+    Vector3f(0.0212869, 0.205086, 1.08428),
+    Vector3f(-0.992256, 0.227585, 0.0032941)
+};
+const Vector3f presetCenters[3] = {
+    Vector3f(0.016228, 0.016228, 0.016228),
+    Vector3f(0.0167281, 0.0167281, 0.0167281),
+    Vector3f(0.00435436, 0.00435436, 0.00435436)
 };
 
+// split screen ('m'): the free camera and the three presets in quadrants.
+// The scene is animated and recorded once per frame; only culling and
+// submission run per view, each with its own occlusion queries.
+enum ViewId {
+    VIEW_FREE,
+    VIEW_TOP,
+    VIEW_FRONT,
+    VIEW_SIDE,
+    VIEW_COUNT
+};
 
-class Camera {
-public:
-    Vector3f eye, center, up;
+struct View {
+    const char* name;
+    Camera* camera;
+    OcclusionCuller occlusion;
+    int commands;           // submitted in the last frame
+    int frustumCulled;
+};
 
-    Camera(float eyeX = 0.021192, float eyeY = 0.353662, float eyeZ = 1.06366, float centerX = 0.0163718, float centerY = 0.0163718, float centerZ = 0.0163718, float upX = 0.0f, float upY = 1.0f, float upZ = 0.0f) {
-        eye = Vector3f(eyeX, eyeY, eyeZ);
-        center = Vector3f(centerX, centerY, centerZ);
-        up = Vector3f(upX, upY, upZ);
-    }
+Camera presetCameras[3];
+View views[VIEW_COUNT];
+bool splitScreen = false;
+
+GLuint meshLists = 0;
+bool meshBaked[MESH_COUNT];
+
+// the ground: chunks stream in around the camera from the tiles in
+// --terrain, at most --chunkbudget of them at once
+TerrainStreamer* terrain = NULL;
+const char* terrainPath = NULL;
+int chunkBudget = 256;
+TerrainBatch* terrainBatches = NULL;
+int terrainBatchCount = 0;
+
+// --forest trees around the park, and the atlas the far ones and the far
+// rides are drawn from
+const float FOREST_RADIUS = 45;
+const int FOREST_LISTS = 2;
+const int NEAR_TREE_CAPACITY = FOREST_LISTS * (COMMAND_LIST_CAPACITY / 4);  // a tree is four draws
+const int RIDE_IMPOSTORS = 6;
+Forest forest;
+int forestSize = 50000;
+GLuint impostorTexture = 0;
+bool impostorAtlasTried = false;
+ImpostorVertex* impostorVertices = NULL;
+ImpostorBatch* impostorBatches = NULL;
+int impostorBatchCount = 0;
+ImpostorVertex* rideImpostorVertices = NULL;
+int rideImpostorQuads = 0;
+CommandList forestLists[FOREST_LISTS];
+
+// --visitors people walking between the attractions by the park's flow
+// fields; a visitor is three boxes: legs, shirt and head
+const float VISITOR_SPEED = 0.004f;    // world units a tick, under a cell
+const int VISITOR_RIDES = 3;
+const int VISITOR_VERTICES = 3 * 24;
+Navigation parkNavigation(-PARK_NAV_EXTENT, -PARK_NAV_EXTENT, PARK_NAV_EXTENT, PARK_NAV_EXTENT);
+Crowd visitors;
+int visitorCount = 150;
+
+struct VisitorVertex {
+    float x, y, z;
+    float nx, ny, nz;
+    unsigned char r, g, b, a;
+};
 
+VisitorVertex* visitorVertices = NULL;
+int visitorVertexCount = 0;
+
+// --night / 'n': the park after dark, lit by its own lamps and ride lights
+// through clustered shading, or by the nearest seven of them in plain
+// OpenGL lighting when the driver has no GLSL
+bool nightMode = false;
+const float MOON_DIRECTION[3] = { -0.36f, 0.8f, 0.48f };
+ClusteredShading clusteredShading;
+LightClusters lightClusters;
+PointLight parkLights[MAX_CLUSTERED_LIGHTS];
+int parkLightCount = 0;
+ParticleVertex* bulbVertices = NULL;
+const int LIGHT_SAMPLE_INTERVAL = 60;   // frames between depth readbacks
+const int LIGHT_SAMPLE_STEP = 4;        // pixels between samples
+std::vector<float> lightDepthSamples;
+double lightBinningMs = 0, lightBinningTotalMs = 0;
+unsigned lightBinnings = 0;
+double lightsPerFragment = 0, lightsPerFragmentTotal = 0;
+unsigned lightSamples = 0;
+
+// --gpuanim / 'g': the rides recorded once at rest and moved by the ride
+// shader from the tick count, instead of posed on the CPU and recorded
+// again every tick; --balloons adds a flotilla of bobbing balloons to
+// show what posing costs at scale. Daylight only, and not in a shared
+// park, whose rides come from the server.
+enum AnimatedRide {
+    ANIMATED_WHEEL,
+    ANIMATED_RED_BALLOON,
+    ANIMATED_BLUE_BALLOON,
+    ANIMATED_GREEN_BALLOON,
+    ANIMATED_SWING,
+    ANIMATED_NEAR_TREE,
+    ANIMATED_FAR_TREE,
+    ANIMATED_TICKET_STAND,
+    ANIMATED_TICKET,
+    ANIMATED_RIDES
+};
 
-    void moveX(float d) {
-        Vector3f right = up.cross(center - eye).unit();
-        eye = eye + right * d;
-        center = center + right * d;
-    }
+bool gpuAnimation = false;
+bool ridesOnGpu = false;        // this frame
+RideShading rideShading;
+RideInstance rideInstances[ANIMATED_RIDES];
+unsigned rideTicks = 0;         // the rides' clock, 60 a second while they move
+const int FLOTILLA_COLORS = 3;
+const float FLOTILLA_SCALE = 0.3f;
+int flotillaSize = 0;
+RideInstance* flotilla = NULL;
+GLuint flotillaLists = 0;
+double posingMs = 0;            // recording the scene and posing the flotilla, this frame
+double posingTotalMs[2];        // by ridesOnGpu
+unsigned posingFrames[2];
+
+// the rides are evaluated at the tick when a frame is drawn, each as often
+// as the views it is in need it; --fullanim / 'b' evaluates them all every
+// frame instead
+AnimationLod animationLod;
+bool animationLevels = true;
+int dueRides[ANIM_COUNT];
+
+// the player may walk the whole map, less a chunk at the edges
+const PlayerBounds TERRAIN_BOUNDS = {
+    (-TERRAIN_EXTENT / 2 + CHUNK_SIZE) / 0.8, (TERRAIN_EXTENT / 2 - CHUNK_SIZE) / 0.8,
+    (-TERRAIN_EXTENT / 2 + CHUNK_SIZE) / 0.8, (TERRAIN_EXTENT / 2 - CHUNK_SIZE) / 0.8
+};
 
-    void moveY(float d) {
-        eye = eye + up.unit() * d;
-        center = center + up.unit() * d;
-    }
+// the scene is recorded as one command list per part, in parallel on the
+// job system; the big rides come first, then one part per occludee
+enum PartId {
+    PART_SKY,
+    PART_FENCES,
+    PART_FERRIS_WHEEL,
+    PART_TICKET_STAND,
+    PART_REMOTE_PLAYERS,
+    OCCLUDER_PARTS
+};
 
-    void moveZ(float d) {
-        Vector3f view = (center - eye).unit();
-        eye = eye + view * d;
-        center = center + view * d;
-    }
+const int PART_COUNT = OCCLUDER_PARTS + OCCLUDEE_COUNT;
+CommandList partLists[PART_COUNT];
+bool partIsImpostor[PART_COUNT];   // this frame, too far away for its geometry
+CommandList noCommands;
+unsigned partVersions[PART_COUNT];
+unsigned partChanges[PART_COUNT];  // by partChanged(), outside the rides and the modes
+int partsRecorded = 0;
+int commandsSubmitted = 0;
+const DrawCommand** sortedOccluders = NULL;
+int sortedOccluderCount = 0;
+ParticleVertex* particleVertices = NULL;
+int particleVertexCount = 0;
+
+// transient render data lives in the frame arena; once warmed up, frames
+// are expected not to touch the heap at all
+FrameArena frameArena(8 << 20);
+const unsigned ALLOCATION_WARMUP_FRAMES = 120;
+AllocationScope frameAllocations;
+unsigned long lastFrameAllocations = 0;
+unsigned steadyFrames = 0;
+unsigned allocatingFrames = 0;
+
+void partChanged(int part) {
+    partChanges[part]++;
+}
 
-    void rotateX(float a) {
-        Vector3f view = (center - eye).unit();
-        Vector3f right = up.cross(view).unit();
-        view = view * cos(DEG2RAD(a)) + up * sin(DEG2RAD(a));
-        up = view.cross(right);
-        center = eye + view;
+void evaluateRides(void* data, int begin, int end) {
+    const int* rides = (const int*)data;
+    for (int i = begin; i < end; i++) {
+        switch (rides[i]) {
+        case ANIM_FENCE: fence.evaluate(rideTicks); break;
+        case ANIM_WHEEL: ferrisWheel.evaluate(rideTicks); break;
+        case ANIM_BALLOONS: hotAirBalloon.evaluate(rideTicks); break;
+        case ANIM_SWING: swing.evaluate(rideTicks); break;
+        case ANIM_TREES: tree.evaluate(rideTicks); break;
+        case ANIM_TICKET_STAND: ticketStand.evaluate(rideTicks); break;
+        case ANIM_TICKET: ticket.evaluate(rideTicks); break;
+        }
     }
+}
 
-    void rotateY(float a) {
-        Vector3f view = (center - eye).unit();
-        Vector3f right = up.cross(view).unit();
-        view = view * cos(DEG2RAD(a)) + right * sin(DEG2RAD(a));
-        right = view.cross(up);
-        center = eye + view;
-    }
+void moveVisitors(void* data, int begin, int end) {
+    visitors.step(parkNavigation, begin, end, VISITOR_SPEED);
+}
 
-    void look() {
-        gluLookAt(
-            eye.x, eye.y, eye.z,
-            center.x, center.y, center.z,
-            up.x, up.y, up.z
-        );
+void playSounds() {
+    SoundCue cue;
+    while ((cue = game.nextSound()) != SOUND_NONE) {
+        switch (cue) {
+        case SOUND_ANIM: playSound("anim"); break;
+        case SOUND_BACKGROUND: playSound("backGround"); break;
+        case SOUND_TICKET: playSound("ticket"); break;
+        case SOUND_WIN: playSound("win"); break;
+        case SOUND_LOSE: playSound("lose"); break;
+        default: break;
+        }
     }
-};
+}
 
-class Fence {
-public:
-    float r, g, b;
-    float colorChangeSpeed;
+unsigned hudRevision() {
+    return (diagnosticsRevision * 128 + game.timer) * 4 + game.status;
+}
 
-    Fence() : r(0.5f), g(0.3f), b(0.0f), colorChangeSpeed(0.03f) {}
+// posts a redisplay only if something visible changed since the last one
+RedrawKind requestRedraw() {
+    RedrawKind kind = governor.decide(sceneRevision, camera.revision, hudRevision());
+    if (kind > pendingRedraw)
+        pendingRedraw = kind;
+    if (kind != REDRAW_NONE)
+        glutPostRedisplay();
+    return kind;
+}
 
-    void animate() {
-        r += colorChangeSpeed;
-        g += colorChangeSpeed * 0.6f;
-        b -= colorChangeSpeed * 0.2f;
+void launchFireworks() {
+    static const unsigned char colors[4][3] = {
+        { 255, 80, 40 }, { 255, 230, 80 }, { 80, 200, 255 }, { 200, 120, 255 }
+    };
+    if (game.status != STATE_WON || fireworksLaunched == FIREWORK_SHELLS)
+        return;
+    if (fireworkTicks++ % FIREWORK_INTERVAL != 0)
+        return;
 
-        if (r > 0.8f || r < 0.2f) {
-            colorChangeSpeed = -colorChangeSpeed;
-        }
-    }
-};
+    // shells spread over the top of the Ferris wheel
+    float offset = (fireworksLaunched % 5 - 2) * 0.12;
+    float height = 0.85 + (fireworksLaunched % 3) * 0.08;
+    const unsigned char* c = colors[fireworksLaunched % 4];
+    particles.burst(Vector3f(offset, height, -0.42), FIREWORK_SPARKS, 0.45, 1.8, c[0], c[1], c[2]);
+    fireworksLaunched++;
+}
 
-class Player {
-public:
-    float posX, posY, posZ;
-    float rotY;
+// reads what the server sent and takes the park from it
+void netStep() {
+    NetAddress from;
+    int size;
+    while ((size = netSocket.receiveFrom(from, netPacket, sizeof(netPacket))) > 0)
+        netClient->receive(netPacket, size);
+    netClient->update();
+    if (!netClient->hasSnapshot())
+        return;
 
-    Player() : posX(0.0f), posY(0.0f), posZ(0.0f), rotY(0.0f) {}
+    player.posX = netClient->predicted.posX;
+    player.posZ = netClient->predicted.posZ;
+    player.rotY = netClient->predicted.rotY;
+    fence.r = netClient->ride(RIDE_FENCE_R);
+    fence.g = netClient->ride(RIDE_FENCE_G);
+    fence.b = netClient->ride(RIDE_FENCE_B);
+    ferrisWheel.rotationAngle = netClient->ride(RIDE_WHEEL_ANGLE);
+    hotAirBalloon.translationY = netClient->ride(RIDE_BALLOON_Y);
+    swing.rotationAngle = netClient->ride(RIDE_SWING_ANGLE);
+    tree.scale = netClient->ride(RIDE_TREE_SCALE);
+    ticketStand.scale = netClient->ride(RIDE_STAND_SCALE);
+    ticket.translationX = netClient->ride(RIDE_TICKET_SHIFT);
+    ticket.posX = netClient->ride(RIDE_TICKET_X);
+    ticket.posZ = netClient->ride(RIDE_TICKET_Z);
+    // everyone and every ride may have moved
+    for (int i = PART_FENCES; i < PART_COUNT; i++)
+        partChanged(i);
+    sceneRevision++;
+
+    // the server decides who got the ticket; the first one wins this kiosk's game
+    int tickets = netClient->playerTickets(netClient->playerId);
+    if (tickets > netTickets && game.canCollectTicket())
+        game.post(GAME_EVENT_TICKET_COLLECTED);
+    netTickets = tickets;
+}
 
-    void moveX(float dx) {
-        posX += dx;
+// new chunks to draw, and the player standing on whatever is under them;
+// the player is drawn scaled by 0.8 and 0.25 up, feet at the old ground
+void updateTerrain() {
+    Vector3f eye = camera.position();
+    if (terrain->update(eye.x, eye.z))
+        sceneRevision++;
+    float y = (terrain->height(0.8f * player.posX, 0.8f * player.posZ) - GROUND_LEVEL) / 0.8f;
+    if (y != player.posY) {
+        player.posY = y;
+        partChanged(OCCLUDER_PARTS + 0);
+        sceneRevision++;
     }
+}
 
-    void moveZ(float dz) {
-        posZ += dz;
+// one 60 Hz simulation tick
+void animStep() {
+    if (netClient) {
+        netStep();
     }
-
-    void rotateY(float angle) {
-        rotY = angle;
+    else if (game.ridesMoving()) {
+        rideTicks++;
+        sceneRevision++;
     }
-};
-
-class FerrisWheel {
-public:
-    float rotationAngle;
-    FerrisWheel() : rotationAngle(0.0f) {}
-
-    void animate() {
-        rotationAngle += 3.0f;
-        if (rotationAngle > 360.0f) {
-            rotationAngle -= 360.0f;
-        }
+    // the visitors keep time with the rides
+    if (!visitors.agents.empty() && (netClient || game.ridesMoving())) {
+        parkNavigation.update();
+        jobs.parallelFor((int)visitors.agents.size(), 256, moveVisitors, NULL);
+        sceneRevision++;
     }
-};
-
-class HotAirBalloon {
-public:
-    float translationY;
-    float translationSpeed;
-    float minHeight;
-    float maxHeight;
+    camera.update(1.0f / 60);
+    updateTerrain();
 
-    HotAirBalloon() : translationY(0.0f), translationSpeed(0.01f), minHeight(-0.03f), maxHeight(0.03f) {}
+    // the diagnostics line refreshes twice a second rather than every frame
+    if (showDiagnostics && ++diagnosticsTicks % 30 == 0)
+        diagnosticsRevision++;
 
-    void animate() {
-        translationY += translationSpeed;
-        if (translationY > maxHeight || translationY < minHeight) {
-            translationSpeed = -translationSpeed;
-        }
+    if (!netClient && game.canCollectTicket() && checkCollision(player, ticket)) {
+        recordEvent(EVENT_TICKET_PICKUP);
+        game.post(GAME_EVENT_TICKET_COLLECTED);
     }
-};
-
-class Swing {
-public:
-    float rotationAngle;
-    float rotationSpeed;
-    float maxRotationAngle;
-    bool swingForward;
-
-    Swing() : rotationAngle(0.0f), rotationSpeed(3.0f), maxRotationAngle(20.0f), swingForward(true) {}
-
-    void animate() {
-        if (swingForward) {
-            rotationAngle += rotationSpeed;
-            if (rotationAngle >= maxRotationAngle) {
-                swingForward = false;
-            }
-        }
-        else {
-            rotationAngle -= rotationSpeed;
-            if (rotationAngle <= -maxRotationAngle) {
-                swingForward = true;
-            }
-        }
+    game.tick();
+    if (ticket.isHit != game.ticketCollected) {
+        ticket.isHit = game.ticketCollected;
+        sceneRevision++;
+        if (ticket.isHit)
+            particles.confetti(Vector3f(ticket.posX + ticket.translationX, 0.05, ticket.posZ), 20000, 0.9, 2.5);
     }
-};
-
-class Tree {
-public:
-    float scale;
-    float scaleSpeed;
-    float minScale;
-    float maxScale;
+    launchFireworks();
+    if (particles.update(1.0f / 60))
+        sceneRevision++;
+    // something hidden in the last frame is in view now
+    for (int v = 0; v < VIEW_COUNT; v++) {
+        if (views[v].occlusion.poll())
+            sceneRevision++;
+    }
+    playSounds();
 
-    Tree() : scale(1.0f), scaleSpeed(0.02f), minScale(0.8f), maxScale(1.2f) {}
+    // a capture needs every frame
+    if (capture.isActive())
+        governor.invalidate();
+    if (requestRedraw() == REDRAW_NONE)
+        governor.frameSkipped();
+}
 
-    void animate() {
-        scale += scaleSpeed;
-        if (scale > maxScale || scale < minScale) {
-            scaleSpeed = -scaleSpeed;
-        }
-    }
-};
+// the simulation clock: GameState times the countdown and jingles in these ticks
+void anim(int value) {
+    recordEvent(EVENT_ANIM_TICK);
+    animStep();
 
-class TicketStand {
-public:
-    float scale;
-    float scaleSpeed;
-    float minScale;
-    float maxScale;
+    glutTimerFunc(1000 / 60, anim, 0);
+}
 
-    TicketStand() : scale(1.0f), scaleSpeed(0.01f), minScale(1.0f), maxScale(1.2f) {}
+void drawMeshImmediate(int mesh) {
+    static GLUquadric* quadric = NULL;
+    if (!quadric) {
+        quadric = gluNewQuadric();
+        gluQuadricNormals(quadric, GL_SMOOTH);
+    }
 
-    void animate() {
-        scale += scaleSpeed;
-        if (scale > maxScale || scale < minScale) {
-            scaleSpeed = -scaleSpeed;
+    switch (mesh) {
+    case MESH_CUBE: glutSolidCube(1.0); break;
+    case MESH_HEAD_SPHERE: glutSolidSphere(0.1, 100, 100); break;
+    case MESH_SMALL_SPHERE: glutSolidSphere(0.02, 20, 20); break;
+    case MESH_BALLOON_SPHERE: glutSolidSphere(40.0, 100, 100); break;
+    case MESH_CONE: glutSolidCone(0.5, 1.5, 50, 50); break;
+    case MESH_SLEEVE_CONE: glutSolidCone(0.6, 1.6, 50, 50); break;
+    case MESH_WHEEL_TORUS: glutWireTorus(0.02, 0.2, 1000, 1000); break;
+    case MESH_HUB_TORUS: glutWireTorus(0.009, 0.1, 1000, 1000); break;
+    case MESH_WINDOW_DISK:
+        gluQuadricTexture(quadric, false);
+        gluDisk(quadric, 0, 0.1, 50, 50);
+        break;
+    case MESH_SKY:
+        gluQuadricTexture(quadric, true);
+        gluSphere(quadric, 100, 100, 100);
+        break;
+    case MESH_MOUTH: {
+        glBegin(GL_LINE_STRIP);
+
+        GLfloat ctrlPoints[4][3] = {
+            {0.03, -0.05, 0.05},
+            {0.01, -0.065, 0.05},
+            {-0.01, -0.065, 0.05},
+            {-0.03, -0.05, 0.05}
+        };
+
+        for (float t = 0.0; t <= 1.0; t += 0.01) {
+            Vector3f p = bezierPoint(ctrlPoints, t);
+            glVertex3f(p.x, p.y, p.z);
         }
+        glEnd();
+        break;
     }
-};
+    }
+}
 
-class Ticket {
-public:
-    float posX, posY, posZ;
-    bool isHit;
-    float translationX;
-    float translationSpeed;
-    float minX;
-    float maxX;
-
-    Ticket() : posX(0.3f), posY(0.0f), posZ(0.3f), isHit(false), translationX(0.0f), translationSpeed(0.01f), minX(-0.03f), maxX(0.03f) {}
-
-    void animate() {
-        translationX += translationSpeed;
-        if (translationX > maxX || translationX < minX) {
-            translationSpeed = -translationSpeed;
-        }
+// the vertex arrays point into the mapped pack, and the list being
+// compiled copies them from there
+void drawBakedMesh(const MeshView& view) {
+    if (view.flags & MESH_WIREFRAME) {
+        glPushAttrib(GL_POLYGON_BIT);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     }
-};
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), view.vertices[0].position);
+    if (view.flags & MESH_NORMALS) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, sizeof(MeshVertex), view.vertices[0].normal);
+    }
+    if (view.flags & MESH_TEXCOORDS) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(MeshVertex), view.vertices[0].texCoord);
+    }
+    for (unsigned i = 0; i < view.runCount; i++)
+        glDrawArrays(view.runs[i].primitive, view.runs[i].first, view.runs[i].count);
+    glPopClientAttrib();
+    if (view.flags & MESH_WIREFRAME)
+        glPopAttrib();
+}
 
-Camera camera;
-Fence fence;
-Player player;
-FerrisWheel ferrisWheel;
-HotAirBalloon hotAirBalloon;
-Swing swing;
-Tree tree;
-TicketStand ticketStand;
-Ticket ticket;
+// the GLUT wire tori have a million segments each, too many to keep in a
+// list; the baked ones have fewer sides and fit
+bool meshInList(int mesh) {
+    return meshBaked[mesh] || (mesh != MESH_WHEEL_TORUS && mesh != MESH_HUB_TORUS);
+}
 
-void anim(int value) {
-    if (animationsActive) {
-        fence.animate();
-        ferrisWheel.animate();
-        hotAirBalloon.animate();
-        swing.animate();
-        tree.animate();
-        ticketStand.animate();
-        ticket.animate();
+// once, after the window is created; meshes missing from the pack are
+// generated by GLUT and GLU as before
+void createMeshes() {
+    if (!assetPack.open(packPath))
+        printf("no asset pack at %s (or built for another version), generating meshes\n", packPath);
+    meshLists = glGenLists(MESH_COUNT);
+    for (int mesh = 0; mesh < MESH_COUNT; mesh++) {
+        size_t size = 0;
+        const void* data = assetPack.find(meshNames[mesh], &size);
+        MeshView view;
+        meshBaked[mesh] = readMesh(data, size, view);
+        if (!meshInList(mesh))
+            continue;
+        glNewList(meshLists + mesh, GL_COMPILE);
+        if (meshBaked[mesh])
+            drawBakedMesh(view);
+        else
+            drawMeshImmediate(mesh);
+        glEndList();
     }
+}
 
-    glutPostRedisplay();
-
-    glutTimerFunc(1000 / 60, anim, 0);
+void drawMesh(int mesh) {
+    if (meshInList(mesh))
+        glCallList(meshLists + mesh);
+    else
+        drawMeshImmediate(mesh);
 }
 
-void drawGround(double thickness) {
-    glPushMatrix();
-    glColor3f(0.4, 0.6, 0.2);
-    glScaled(1.0, thickness, 1.0);
-    glutSolidCube(1);
-    glPopMatrix();
+// the value to record a ride's pose with: its live one, or its rest value
+// while the ride shader moves it
+double posed(double value, double rest) {
+    return ridesOnGpu ? rest : value;
 }
 
-void drawSky() {
-    glPushMatrix();
-    glDisable(GL_LIGHTING);
-    glColor3f(0.6 * 0.9, 0.8 * 0.9, 1 * 0.9);
-    GLUquadricObj* qobj;
-    qobj = gluNewQuadric();
-    glTranslated(50, 0, 0);
-    glRotated(90, 1, 0, 1);
-    gluQuadricTexture(qobj, true);
-    gluQuadricNormals(qobj, GL_SMOOTH);
-    gluSphere(qobj, 100, 100, 100);
-    gluDeleteQuadric(qobj);
-    glEnable(GL_LIGHTING);
-    glPopMatrix();
+void drawSky(CommandList& c) {
+    c.push();
+    c.lighting(false);
+    if (nightMode)
+        c.color(0.02, 0.03, 0.08);
+    else
+        c.color(0.6 * 0.9, 0.8 * 0.9, 1 * 0.9);
+    c.translate(50, 0, 0);
+    c.rotate(90, 1, 0, 1);
+    c.draw(MESH_SKY);
+    c.lighting(true);
+    c.pop();
 }
 
-void drawFence(double legThick, double legLen) {
-    glPushMatrix();
+void drawFence(CommandList& c, double legThick, double legLen) {
+    c.push();
 
-    glColor3f(fence.r, fence.g, fence.b);
+    c.color(fence.r, fence.g, fence.b);
 
     for (int i = -6; i < 7; i++) {
-        glPushMatrix();
-        glTranslated(i * 0.08, legLen / 2, 0);
-        glScaled(legThick, legLen, legThick);
-        glutSolidCube(1.0);
-        glPopMatrix();
+        c.push();
+        c.translate(i * 0.08, legLen / 2, 0);
+        c.scale(legThick, legLen, legThick);
+        c.draw(MESH_CUBE);
+        c.pop();
     }
 
-    glPushMatrix();
-    glTranslated(0, 0.25, 0);
-    glScaled(1, 0.02, 0.02);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.translate(0, 0.25, 0);
+    c.scale(1, 0.02, 0.02);
+    c.draw(MESH_CUBE);
+    c.pop();
 
-    glPopMatrix();
+    c.pop();
 }
 
-void drawPlayer() {
-    glPushMatrix();
+// put up for the night, with their lamps glowing
+void drawLampPosts(CommandList& c) {
+    for (int i = 0; i < PARK_LAMP_POSTS; i++) {
+        c.push();
+        c.translate(parkLampPosts[i][0], 0, parkLampPosts[i][1]);
+
+        c.push();
+        c.color(0.2, 0.2, 0.25);
+        c.translate(0, PARK_LAMP_HEIGHT / 2, 0);
+        c.scale(0.01, PARK_LAMP_HEIGHT, 0.01);
+        c.draw(MESH_CUBE);
+        c.pop();
+
+        c.push();
+        c.lighting(false);
+        c.color(1.0, 0.9, 0.6);
+        c.translate(0, PARK_LAMP_HEIGHT + 0.01, 0);
+        c.scale(0.03, 0.02, 0.03);
+        c.draw(MESH_CUBE);
+        c.lighting(true);
+        c.pop();
+
+        c.pop();
+    }
+}
+
+// the other players in a shared park, with less detail than this kiosk's
+// own: head, shirt in the player's color, legs
+void drawRemotePlayers(CommandList& c) {
+    static const float colors[8][3] = {
+        { 0.9, 0.3, 0.3 }, { 0.3, 0.8, 0.3 }, { 0.9, 0.6, 0.2 }, { 0.7, 0.3, 0.9 },
+        { 0.2, 0.8, 0.8 }, { 0.9, 0.9, 0.3 }, { 0.9, 0.4, 0.7 }, { 0.5, 0.5, 0.5 }
+    };
+    if (!netClient)
+        return;
+    c.scale(0.8, 0.8, 0.8);
+    c.translate(0, 0.25, 0);
+    for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+        if (i == netClient->playerId || !netClient->playerActive(i))
+            continue;
+        Player p = netClient->player(i);
+        c.push();
+        c.translate(p.posX, p.posY, p.posZ);
+        c.rotate(p.rotY, 0.0f, 1.0f, 0.0f);
+
+        c.color(0.9765, 0.8784, 0.7529);
+        c.push();
+        c.scale(0.5, 0.5, 0.5);
+        c.draw(MESH_HEAD_SPHERE);
+        c.pop();
+
+        c.push();
+        c.translate(0, -0.21, 0);
+        c.scale(0.065, 0.04, 0.025);
+        c.draw(MESH_CUBE);
+        c.pop();
+
+        c.color(colors[i % 8][0], colors[i % 8][1], colors[i % 8][2]);
+        c.push();
+        c.translate(0, -0.15, 0);
+        c.rotate(-90, 1, 0, 0);
+        c.scale(0.1, 0.1, 0.1);
+        c.draw(MESH_CONE);
+        c.pop();
+
+        c.pop();
+    }
+}
+
+void drawPlayer(CommandList& c) {
+    c.push();
 
-    glTranslatef(player.posX, player.posY, player.posZ);
-    glRotatef(player.rotY, 0.0f, 1.0f, 0.0f);
+    c.translate(player.posX, player.posY, player.posZ);
+    c.rotate(player.rotY, 0.0f, 1.0f, 0.0f);
 
     // head
-    glColor3f(0.9765, 0.8784, 0.7529);
-    glPushMatrix();
-    glScaled(0.5, 0.5, 0.5);
-    glutSolidSphere(0.1, 100, 100);
-    glPopMatrix();
+    c.color(0.9765, 0.8784, 0.7529);
+    c.push();
+    c.scale(0.5, 0.5, 0.5);
+    c.draw(MESH_HEAD_SPHERE);
+    c.pop();
 
     // eyes
-    glColor3f(0.0, 0.3, 0.0);
-    glPushMatrix();
-    glTranslated(0.015, 0.03, 0.04);
-    glScaled(0.05, 0.05, 0.05);
-    glutSolidSphere(0.1, 100, 100);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-0.015, 0.03, 0.04);
-    glScaled(0.05, 0.05, 0.05);
-    glutSolidSphere(0.1, 100, 100);
-    glPopMatrix();
+    c.color(0.0, 0.3, 0.0);
+    c.push();
+    c.translate(0.015, 0.03, 0.04);
+    c.scale(0.05, 0.05, 0.05);
+    c.draw(MESH_HEAD_SPHERE);
+    c.pop();
+
+    c.push();
+    c.translate(-0.015, 0.03, 0.04);
+    c.scale(0.05, 0.05, 0.05);
+    c.draw(MESH_HEAD_SPHERE);
+    c.pop();
 
     // mouth
-    glColor3f(1.0, 0.0, 0.0);
-    glPushMatrix();
-    glTranslated(0, 0.047, 0.01);
-    glScaled(0.8, 1, 0.8);
-    glBegin(GL_LINE_STRIP);
-
-    GLfloat ctrlPoints[4][3] = {
-        {0.03, -0.05, 0.05},
-        {0.01, -0.065, 0.05},
-        {-0.01, -0.065, 0.05},
-        {-0.03, -0.05, 0.05}
-    };
-
-    for (float t = 0.0; t <= 1.0; t += 0.01) {
-        float x = (1 - t) * (1 - t) * (1 - t) * ctrlPoints[0][0] +
-            3 * (1 - t) * (1 - t) * t * ctrlPoints[1][0] +
-            3 * (1 - t) * t * t * ctrlPoints[2][0] +
-            t * t * t * ctrlPoints[3][0];
-
-        float y = (1 - t) * (1 - t) * (1 - t) * ctrlPoints[0][1] +
-            3 * (1 - t) * (1 - t) * t * ctrlPoints[1][1] +
-            3 * (1 - t) * t * t * ctrlPoints[2][1] +
-            t * t * t * ctrlPoints[3][1];
-
-        float z = (1 - t) * (1 - t) * (1 - t) * ctrlPoints[0][2] +
-            3 * (1 - t) * (1 - t) * t * ctrlPoints[1][2] +
-            3 * (1 - t) * t * t * ctrlPoints[2][2] +
-            t * t * t * ctrlPoints[3][2];
-
-        glVertex3f(x, y, z);
-    }
-    glEnd();
-    glPopMatrix();
+    c.color(1.0, 0.0, 0.0);
+    c.push();
+    c.translate(0, 0.047, 0.01);
+    c.scale(0.8, 1, 0.8);
+    c.draw(MESH_MOUTH);
+    c.pop();
 
     // t-shirt
-    glColor3f(0.5, 0.7, 1);
-    glPushMatrix();
-    glTranslated(0, -0.15, 0);
-    glRotated(-90, 1, 0, 0);
-    glScaled(0.1, 0.1, 0.1);
-    glutSolidCone(0.5, 1.5, 50, 50);
-    glPopMatrix();
+    c.color(0.5, 0.7, 1);
+    c.push();
+    c.translate(0, -0.15, 0);
+    c.rotate(-90, 1, 0, 0);
+    c.scale(0.1, 0.1, 0.1);
+    c.draw(MESH_CONE);
+    c.pop();
 
     // sleeves
-    glPushMatrix();
-    glTranslated(0.04, -0.085, 0.0);
-    glRotated(-90, 1, 0, 0);
-    glRotated(-30, 0, 1, 0);
-    glScaled(0.03, 0.055, 0.03);
-    glutSolidCone(0.6, 1.6, 50, 50);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-0.04, -0.085, 0.0);
-    glRotated(-90, 1, 0, 0);
-    glRotated(30, 0, 1, 0);
-    glScaled(0.03, 0.055, 0.03);
-    glutSolidCone(0.6, 1.6, 50, 50);
-    glPopMatrix();
+    c.push();
+    c.translate(0.04, -0.085, 0.0);
+    c.rotate(-90, 1, 0, 0);
+    c.rotate(-30, 0, 1, 0);
+    c.scale(0.03, 0.055, 0.03);
+    c.draw(MESH_SLEEVE_CONE);
+    c.pop();
+
+    c.push();
+    c.translate(-0.04, -0.085, 0.0);
+    c.rotate(-90, 1, 0, 0);
+    c.rotate(30, 0, 1, 0);
+    c.scale(0.03, 0.055, 0.03);
+    c.draw(MESH_SLEEVE_CONE);
+    c.pop();
 
     // shorts
-    glColor3f(1.0, 1.0, 1.0);
-    glPushMatrix();
-    glTranslated(0.02, -0.15, 0);
-    glScaled(0.025, 0.08, 0.025);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-0.02, -0.15, 0);
-    glScaled(0.025, 0.08, 0.025);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.color(1.0, 1.0, 1.0);
+    c.push();
+    c.translate(0.02, -0.15, 0);
+    c.scale(0.025, 0.08, 0.025);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.translate(-0.02, -0.15, 0);
+    c.scale(0.025, 0.08, 0.025);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // legs
-    glColor3f(0.9765, 0.8784, 0.7529);
-    glPushMatrix();
-    glTranslated(0.02, -0.21, 0);
-    glScaled(0.025, 0.04, 0.025);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-0.02, -0.21, 0);
-    glScaled(0.025, 0.04, 0.025);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.color(0.9765, 0.8784, 0.7529);
+    c.push();
+    c.translate(0.02, -0.21, 0);
+    c.scale(0.025, 0.04, 0.025);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.translate(-0.02, -0.21, 0);
+    c.scale(0.025, 0.04, 0.025);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // arms
-    glColor3f(0.9765, 0.8784, 0.7529);
-    glPushMatrix();
-    glTranslated(0.05, -0.09, 0);
-    glRotated(36, 0, 0, 1);
-    glScaled(0.015, 0.045, 0.015);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glColor3f(0.9765, 0.8784, 0.7529);
-    glPushMatrix();
-    glTranslated(-0.05, -0.09, 0);
-    glRotated(-36, 0, 0, 1);
-    glScaled(0.015, 0.045, 0.015);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.color(0.9765, 0.8784, 0.7529);
+    c.push();
+    c.translate(0.05, -0.09, 0);
+    c.rotate(36, 0, 0, 1);
+    c.scale(0.015, 0.045, 0.015);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.color(0.9765, 0.8784, 0.7529);
+    c.push();
+    c.translate(-0.05, -0.09, 0);
+    c.rotate(-36, 0, 0, 1);
+    c.scale(0.015, 0.045, 0.015);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // shoes
-    glColor3f(0.0, 0.0, 0.0);
-    glPushMatrix();
-    glTranslated(0.02, -0.23, 0.005);
-    glScaled(0.03, 0.007, 0.05);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-0.02, -0.23, 0.005);
-    glScaled(0.03, 0.007, 0.05);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPopMatrix();
+    c.color(0.0, 0.0, 0.0);
+    c.push();
+    c.translate(0.02, -0.23, 0.005);
+    c.scale(0.03, 0.007, 0.05);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.translate(-0.02, -0.23, 0.005);
+    c.scale(0.03, 0.007, 0.05);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.pop();
 }
 
-void darwFerrisWheel() {
-    glPushMatrix();
+void darwFerrisWheel(CommandList& c) {
+    c.push();
+    c.animation(ANIMATED_WHEEL);
 
-    glRotatef(ferrisWheel.rotationAngle, 0, 0, 1);
+    c.rotate(posed(ferrisWheel.rotationAngle, 0), 0, 0, 1);
 
     // wheel
-    glPushMatrix();
-    glColor3f(1.0, 0.75, 0.5);
-    glutWireTorus(0.02, 0.2, 1000, 1000);
-    glPopMatrix();
+    c.push();
+    c.color(1.0, 0.75, 0.5);
+    c.draw(MESH_WHEEL_TORUS);
+    c.pop();
 
-    glPushMatrix();
-    glutWireTorus(0.009, 0.1, 1000, 1000);
-    glPopMatrix();
+    c.push();
+    c.draw(MESH_HUB_TORUS);
+    c.pop();
 
     // rods
-    glPushMatrix();
-    glColor3f(1.0 * 0.65, 0.0, 0.0);
-    glScaled(0.012, 0.4, 0.012);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(0.0, 1.0 * 0.65, 0.0);
-    glRotated(45, 0, 0, 1);
-    glScaled(0.012, 0.4, 0.012);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 1.0 * 0.65);
-    glRotated(-45, 0, 0, 1);
-    glScaled(0.012, 0.4, 0.012);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(1.0 * 0.65, 1.0 * 0.65, 0.0);
-    glRotated(90, 0, 0, 1);
-    glScaled(0.012, 0.4, 0.012);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPopMatrix();
+    c.push();
+    c.color(1.0 * 0.65, 0.0, 0.0);
+    c.scale(0.012, 0.4, 0.012);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(0.0, 1.0 * 0.65, 0.0);
+    c.rotate(45, 0, 0, 1);
+    c.scale(0.012, 0.4, 0.012);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(0.0, 0.0, 1.0 * 0.65);
+    c.rotate(-45, 0, 0, 1);
+    c.scale(0.012, 0.4, 0.012);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(1.0 * 0.65, 1.0 * 0.65, 0.0);
+    c.rotate(90, 0, 0, 1);
+    c.scale(0.012, 0.4, 0.012);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.animation(-1);
+    c.pop();
 }
 
-void drawFerrisWheelStructure() {
-    darwFerrisWheel();
-
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.0);
-    glTranslated(-0.08, -0.2, 0.0);
-    glRotated(-22.5, 0, 0, 1);
-    glScaled(0.015, 0.4, 0.015);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.0);
-    glTranslated(0.08, -0.2, 0.0);
-    glRotated(22.5, 0, 0, 1);
-    glScaled(0.015, 0.4, 0.015);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.0);
-    glTranslated(0.0, -0.38, 0.0);
-    glRotated(90, 0, 0, 1);
-    glScaled(0.015, 0.4, 0.015);
-    glutSolidCube(1.0);
-    glPopMatrix();
+void drawFerrisWheelStructure(CommandList& c) {
+    darwFerrisWheel(c);
+
+    c.push();
+    c.color(0.0, 0.0, 0.0);
+    c.translate(-0.08, -0.2, 0.0);
+    c.rotate(-22.5, 0, 0, 1);
+    c.scale(0.015, 0.4, 0.015);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(0.0, 0.0, 0.0);
+    c.translate(0.08, -0.2, 0.0);
+    c.rotate(22.5, 0, 0, 1);
+    c.scale(0.015, 0.4, 0.015);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(0.0, 0.0, 0.0);
+    c.translate(0.0, -0.38, 0.0);
+    c.rotate(90, 0, 0, 1);
+    c.scale(0.015, 0.4, 0.015);
+    c.draw(MESH_CUBE);
+    c.pop();
 }
 
-void drawHotAirBalloon() {
-    glPushMatrix();
+void drawHotAirBalloon(CommandList& c, double rise) {
+    c.push();
 
-    glTranslated(0.0, hotAirBalloon.translationY, 0.0);
+    c.translate(0.0, rise, 0.0);
 
     // balloon
-    glPushMatrix();
-    glScaled(0.0024, 0.0036, 0.0024);
-    glutSolidSphere(40.0, 100, 100);
-    glPopMatrix();
+    c.push();
+    c.scale(0.0024, 0.0036, 0.0024);
+    c.draw(MESH_BALLOON_SPHERE);
+    c.pop();
 
     // basket
-    glPushMatrix();
-    glColor3f(0.8, 0.6, 0.4);
-    glTranslated(0.0, -0.25, 0.0);
-    glScaled(0.1, 0.05, 0.1);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.color(0.8, 0.6, 0.4);
+    c.translate(0.0, -0.25, 0.0);
+    c.scale(0.1, 0.05, 0.1);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // basket details
-    glColor3f(0.5, 0.3, 0.0);
+    c.color(0.5, 0.3, 0.0);
     for (int i = -3; i < 4; i++) {
-        glPushMatrix();
-        glTranslated(i * 0.016, -0.25, 0.053);
-        glScaled(0.0025, 0.05, 0.0025);
-        glutSolidCube(1.0);
-        glPopMatrix();
+        c.push();
+        c.translate(i * 0.016, -0.25, 0.053);
+        c.scale(0.0025, 0.05, 0.0025);
+        c.draw(MESH_CUBE);
+        c.pop();
     }
 
     // support
-    glPushMatrix();
-    glRotated(10, 0, 0, 1);
-    glTranslated(-0.05, -0.18, 0);
-    glScaled(0.01, 0.15, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glRotated(-10, 0, 0, 1);
-    glTranslated(0.05, -0.18, 0);
-    glScaled(0.01, 0.15, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPopMatrix();
+    c.push();
+    c.rotate(10, 0, 0, 1);
+    c.translate(-0.05, -0.18, 0);
+    c.scale(0.01, 0.15, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.rotate(-10, 0, 0, 1);
+    c.translate(0.05, -0.18, 0);
+    c.scale(0.01, 0.15, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.pop();
 }
 
-void drawSwing() {
-    glPushMatrix();
+void drawSwing(CommandList& c) {
+    c.push();
+    c.animation(ANIMATED_SWING);
 
     // translate to the top rod
-    glTranslatef(0, 0.2, -0.05);
+    c.translate(0, 0.2, -0.05);
     // rotate about x
-    glRotatef(-swing.rotationAngle, 1, 0, 0);
+    c.rotate(-posed(swing.rotationAngle, 0), 1, 0, 0);
     // translate back to the original position
-    glTranslatef(0, -0.2, 0.05);
+    c.translate(0, -0.2, 0.05);
 
     // chair
-    glPushMatrix();
-    glColor3f(1.0, 1.0, 0.0);
-    glScaled(0.18, 0.01, 0.1);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(1.0, 1.0, 0.0);
-    glTranslated(0.0, 0.05, -0.05);
-    glScaled(0.18, 0.1, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.color(1.0, 1.0, 0.0);
+    c.scale(0.18, 0.01, 0.1);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(1.0, 1.0, 0.0);
+    c.translate(0.0, 0.05, -0.05);
+    c.scale(0.18, 0.1, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // chair details
-    glColor3f(0.0, 0.3, 0.5);
+    c.color(0.0, 0.3, 0.5);
     for (int i = -2; i < 3; i++) {
-        glPushMatrix();
-        glTranslated(i * 0.04, 0.05, -0.045);
-        glScaled(0.005, 0.1, 0.005);
-        glutSolidCube(1.0);
-        glPopMatrix();
+        c.push();
+        c.translate(i * 0.04, 0.05, -0.045);
+        c.scale(0.005, 0.1, 0.005);
+        c.draw(MESH_CUBE);
+        c.pop();
     }
 
     // rods
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.2);
-    glTranslated(-0.08, 0.15, -0.05);
-    glScaled(0.01, 0.1, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(0.08, 0.15, -0.05);
-    glScaled(0.01, 0.1, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPopMatrix();
+    c.push();
+    c.color(0.0, 0.0, 0.2);
+    c.translate(-0.08, 0.15, -0.05);
+    c.scale(0.01, 0.1, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.translate(0.08, 0.15, -0.05);
+    c.scale(0.01, 0.1, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.animation(-1);
+    c.pop();
 }
 
-void drawSwingStructure() {
-    drawSwing();
+void drawSwingStructure(CommandList& c) {
+    drawSwing(c);
 
     // top rod
-    glPushMatrix();
-    glTranslated(0, 0.2, -0.05);
-    glScaled(0.3, 0.01, 0.02);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.translate(0, 0.2, -0.05);
+    c.scale(0.3, 0.01, 0.02);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // side rods
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.2);
-    glTranslated(-0.13, 0.05, -0.05);
-    glScaled(0.01, 0.3, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.2);
-    glTranslated(0.13, 0.05, -0.05);
-    glScaled(0.01, 0.3, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.color(0.0, 0.0, 0.2);
+    c.translate(-0.13, 0.05, -0.05);
+    c.scale(0.01, 0.3, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(0.0, 0.0, 0.2);
+    c.translate(0.13, 0.05, -0.05);
+    c.scale(0.01, 0.3, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // base rods
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.2);
-    glTranslated(0.13, -0.1, -0.05);
-    glRotated(90, 1, 0, 0);
-    glScaled(0.02, 0.15, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glColor3f(0.0, 0.0, 0.2);
-    glTranslated(-0.13, -0.1, -0.05);
-    glRotated(90, 1, 0, 0);
-    glScaled(0.02, 0.15, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.color(0.0, 0.0, 0.2);
+    c.translate(0.13, -0.1, -0.05);
+    c.rotate(90, 1, 0, 0);
+    c.scale(0.02, 0.15, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.color(0.0, 0.0, 0.2);
+    c.translate(-0.13, -0.1, -0.05);
+    c.rotate(90, 1, 0, 0);
+    c.scale(0.02, 0.15, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
 
 }
 
-void drawTree() {
-    glPushMatrix();
-
-    glScalef(tree.scale, tree.scale, tree.scale);
+// one tree at its full size, as the forest plants them
+void drawTreeShape(CommandList& c) {
+    c.push();
 
     // tree body
-    glPushMatrix();
-    glColor3f(0.4, 0.6, 0.2);
-    glRotated(-90, 1, 0, 0);
-    glScaled(0.1, 0.1, 0.1);
-    glutSolidCone(0.5, 1.5, 50, 50);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(0, 0.06, 0);
-    glRotated(-90, 1, 0, 0);
-    glScaled(0.1 * 0.9, 0.1 * 0.9, 0.1 * 0.9);
-    glutSolidCone(0.5, 1.5, 50, 50);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(0, 0.12, 0);
-    glRotated(-90, 1, 0, 0);
-    glScaled(0.1 * 0.8, 0.1 * 0.8, 0.1 * 0.8);
-    glutSolidCone(0.5, 1.5, 50, 50);
-    glPopMatrix();
+    c.push();
+    c.color(0.4, 0.6, 0.2);
+    c.rotate(-90, 1, 0, 0);
+    c.scale(0.1, 0.1, 0.1);
+    c.draw(MESH_CONE);
+    c.pop();
+
+    c.push();
+    c.translate(0, 0.06, 0);
+    c.rotate(-90, 1, 0, 0);
+    c.scale(0.1 * 0.9, 0.1 * 0.9, 0.1 * 0.9);
+    c.draw(MESH_CONE);
+    c.pop();
+
+    c.push();
+    c.translate(0, 0.12, 0);
+    c.rotate(-90, 1, 0, 0);
+    c.scale(0.1 * 0.8, 0.1 * 0.8, 0.1 * 0.8);
+    c.draw(MESH_CONE);
+    c.pop();
 
     // trunk
-    glPushMatrix();
-    glColor3f(0.5, 0.3, 0.0);
-    glTranslated(0, -0.02, 0);
-    glScaled(0.02, 0.07, 0.02);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.color(0.5, 0.3, 0.0);
+    c.translate(0, -0.02, 0);
+    c.scale(0.02, 0.07, 0.02);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.pop();
+}
 
-    glPopMatrix();
+void drawTree(CommandList& c) {
+    c.push();
+    double scale = posed(tree.scale, 1);
+    c.scale(scale, scale, scale);
+    drawTreeShape(c);
+    c.pop();
 }
 
-void drawTicketStand() {
-    glPushMatrix();
+void drawTicketStand(CommandList& c) {
+    c.push();
 
-    glScaled(ticketStand.scale, ticketStand.scale, ticketStand.scale);
+    double scale = posed(ticketStand.scale, 1);
+    c.scale(scale, scale, scale);
 
     // body
     for (int i = -3; i < 4; i++) {
-        glPushMatrix();
+        c.push();
         if (i % 2 == 0)
-            glColor3f(1.0, 0.0, 0.0);
+            c.color(1.0, 0.0, 0.0);
         else
-            glColor3f(1.0, 1.0, 1.0);
-        glTranslated(i * 0.04, 0, 0);
-        glScaled(0.04, 0.3, 0.1);
-        glutSolidCube(1.0);
-        glPopMatrix();
+            c.color(1.0, 1.0, 1.0);
+        c.translate(i * 0.04, 0, 0);
+        c.scale(0.04, 0.3, 0.1);
+        c.draw(MESH_CUBE);
+        c.pop();
     }
 
     // window
-    glPushMatrix();
-    glColor3f(0.5, 0.5, 0.5);
-    glTranslated(0, 0.05, 0.055);
-    glScaled(0.7, 0.8, 0);
-    GLUquadric* quadObj = gluNewQuadric();
-    gluDisk(quadObj, 0, 0.1, 50, 50);
-    glPopMatrix();
+    c.push();
+    c.color(0.5, 0.5, 0.5);
+    c.translate(0, 0.05, 0.055);
+    c.scale(0.7, 0.8, 0);
+    c.draw(MESH_WINDOW_DISK);
+    c.pop();
 
     // sign
-    glPushMatrix();
-    glColor3f(1.0 * 0.8, 1.0 * 0.8, 0.0);
-    glTranslated(0, 0.23, 0);
-    glScaled(0.25, 0.07, 0.025);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.color(1.0 * 0.8, 1.0 * 0.8, 0.0);
+    c.translate(0, 0.23, 0);
+    c.scale(0.25, 0.07, 0.025);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // rods
-    glPushMatrix();
-    glTranslated(0.05, 0.15, 0);
-    glScaled(0.02, 0.1, 0.008);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-0.05, 0.15, 0);
-    glScaled(0.02, 0.1, 0.008);
-    glutSolidCube(1.0);
-    glPopMatrix();
-
-    glPopMatrix();
+    c.push();
+    c.translate(0.05, 0.15, 0);
+    c.scale(0.02, 0.1, 0.008);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.push();
+    c.translate(-0.05, 0.15, 0);
+    c.scale(0.02, 0.1, 0.008);
+    c.draw(MESH_CUBE);
+    c.pop();
+
+    c.pop();
 }
 
-void drawTicket() {
-    glPushMatrix();
-    glTranslatef(ticket.translationX, 0, 0);
+void drawTicket(CommandList& c) {
+    c.push();
+    c.translate(posed(ticket.translationX, 0), 0, 0);
 
     // body
-    glPushMatrix();
-    glScalef(0.2, 0.1, 0.01);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    c.push();
+    c.scale(0.2, 0.1, 0.01);
+    c.draw(MESH_CUBE);
+    c.pop();
 
     // decoration
-    glColor3f(1.0, 1.0, 1.0);
+    c.color(1.0, 1.0, 1.0);
 
     float positions[4] = { 0.025, -0.025, 0.075, -0.075 };
 
     // left spheres
     for (int i = 0; i < 4; i++) {
-        glPushMatrix();
-        glTranslatef(-0.1, positions[i] * 0.5, 0);
-        glScaled(0.5, 0.5, 0.5);
-        glutSolidSphere(0.02, 20, 20);
-        glPopMatrix();
+        c.push();
+        c.translate(-0.1, positions[i] * 0.5, 0);
+        c.scale(0.5, 0.5, 0.5);
+        c.draw(MESH_SMALL_SPHERE);
+        c.pop();
     }
 
     // right spheres
     for (int i = 0; i < 4; i++) {
-        glPushMatrix();
-        glTranslatef(0.1, positions[i] * 0.5, 0);
-        glScaled(0.5, 0.5, 0.5);
-        glutSolidSphere(0.02, 20, 20);
-        glPopMatrix();
+        c.push();
+        c.translate(0.1, positions[i] * 0.5, 0);
+        c.scale(0.5, 0.5, 0.5);
+        c.draw(MESH_SMALL_SPHERE);
+        c.pop();
     }
 
-    glPopMatrix();
+    c.pop();
+}
+
+// soft round dot for point sprites
+void createParticleTexture() {
+    const int size = 32;
+    unsigned char alpha[size * size];
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float dx = (x + 0.5f) / size * 2 - 1, dy = (y + 0.5f) / size * 2 - 1;
+            float d = 1 - sqrt(dx * dx + dy * dy);
+            alpha[y * size + x] = (unsigned char)(d <= 0 ? 0 : d * d * 255);
+        }
+    }
+    glGenTextures(1, &particleTexture);
+    glBindTexture(GL_TEXTURE_2D, particleTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, size, size, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+}
+
+bool aaAvailable(AAMode mode) {
+    if (mode == AA_OFF)
+        return true;
+    if (!sceneTarget.supported())
+        return false;
+    if (mode == AA_POST)
+        return edgeFilter.ready();
+    return sceneTarget.maxSamples() >= aaSamples(mode);
 }
 
-bool checkCollision(const Ticket& ticket) {
-    float collisionDistanceX = 0.09f;
-    float collisionDistanceZ = 0.09f;
+void setAAMode(AAMode mode) {
+    aaMode = mode;
+    sceneTarget.resize(screenWidth, screenHeight, aaSamples(mode));
+    sceneRevision++;
+    diagnosticsRevision++;
+}
+
+float sceneScale() {
+    return dynamicResolution && sceneTarget.ready() ? resolution.scale : 1.0f;
+}
+
+// once per frame, shared by all views
+void prepareParticles() {
+    particleVertexCount = 0;
+    if (particles.size() == 0)
+        return;
+    particleVertices = frameArena.allocateArray<ParticleVertex>(particles.size());
+    if (particleVertices)
+        particleVertexCount = particles.fillVertices(particleVertices);
+}
 
-    return (abs(player.posX - ticket.posX) < collisionDistanceX &&
-        abs(player.posZ - ticket.posZ) < collisionDistanceZ);
+// the terrain's vertices for this frame, at the levels of detail the main
+// camera sees them at; every view draws from the same vertices
+void prepareTerrain() {
+    terrainBatchCount = terrain->prepare(camera.position(), frameArena, terrainBatches);
+}
+
+// a box standing on y, facing along (fx, fz), into out[0, 24)
+void writeVisitorBox(VisitorVertex* out, float x, float y, float z, float fx, float fz,
+    float halfWidth, float halfDepth, float height, const unsigned char* color) {
+    // corners: bit 0 across, bit 1 along the facing, bit 2 up
+    float corners[8][3];
+    for (int i = 0; i < 8; i++) {
+        float across = i & 1 ? halfWidth : -halfWidth, along = i & 2 ? halfDepth : -halfDepth;
+        corners[i][0] = x + along * fx + across * fz;
+        corners[i][1] = y + (i & 4 ? height : 0);
+        corners[i][2] = z + along * fz - across * fx;
+    }
+    static const int faces[6][4] = {
+        { 2, 3, 7, 6 }, { 1, 0, 4, 5 }, { 3, 1, 5, 7 }, { 0, 2, 6, 4 }, { 4, 6, 7, 5 }, { 0, 1, 3, 2 }
+    };
+    float normals[6][3] = {
+        { fx, 0, fz }, { -fx, 0, -fz }, { fz, 0, -fx }, { -fz, 0, fx }, { 0, 1, 0 }, { 0, -1, 0 }
+    };
+    for (int f = 0; f < 6; f++) {
+        for (int k = 0; k < 4; k++) {
+            VisitorVertex& v = out[f * 4 + k];
+            const float* c = corners[faces[f][k]];
+            v.x = c[0];
+            v.y = c[1];
+            v.z = c[2];
+            v.nx = normals[f][0];
+            v.ny = normals[f][1];
+            v.nz = normals[f][2];
+            v.r = color[0];
+            v.g = color[1];
+            v.b = color[2];
+            v.a = 255;
+        }
+    }
+}
+
+// the atlas is captured by day; moonlight on it at night
+void dimImpostorVertex(ImpostorVertex& v) {
+    v.r = (unsigned char)(v.r * 0.15f);
+    v.g = (unsigned char)(v.g * 0.18f);
+    v.b = (unsigned char)(v.b * 0.3f);
+}
+
+// once per frame, shared by all views: where the night's lights are, with
+// the wheel's turning and the balloons rising, their bulbs, and the
+// impostors dimmed to match
+void prepareNightLights() {
+    parkLightCount = 0;
+    bulbVertices = NULL;
+    if (!nightMode)
+        return;
+    // the lights follow the rides' curves at this tick, even where the
+    // animation levels left a ride's own pose a few ticks behind
+    FerrisWheel wheel = ferrisWheel;
+    HotAirBalloon balloon = hotAirBalloon;
+    if (!netClient) {
+        wheel.evaluate(rideTicks);
+        balloon.evaluate(rideTicks);
+    }
+    parkLightCount = parkNightLights(parkLights, MAX_CLUSTERED_LIGHTS, wheel.rotationAngle, balloon.translationY);
+    bulbVertices = frameArena.allocateArray<ParticleVertex>(parkLightCount);
+    if (bulbVertices) {
+        for (int i = 0; i < parkLightCount; i++) {
+            const PointLight& l = parkLights[i];
+            ParticleVertex& v = bulbVertices[i];
+            v.x = l.x;
+            v.y = l.y;
+            v.z = l.z;
+            v.r = (unsigned char)(l.r < 1 ? l.r * 255 : 255);
+            v.g = (unsigned char)(l.g < 1 ? l.g * 255 : 255);
+            v.b = (unsigned char)(l.b < 1 ? l.b * 255 : 255);
+            v.a = 255;
+        }
+    }
+
+    const ImpostorBatch* last = impostorBatchCount > 0 ? &impostorBatches[impostorBatchCount - 1] : NULL;
+    for (int i = 0; last && i < last->first + last->count; i++)
+        dimImpostorVertex(impostorVertices[i]);
+    for (int i = 0; i < rideImpostorQuads * 4; i++)
+        dimImpostorVertex(rideImpostorVertices[i]);
+}
+
+// once per frame, shared by all views
+void prepareVisitors() {
+    static const unsigned char shirts[8][3] = {
+        { 230, 77, 77 }, { 77, 204, 77 }, { 230, 153, 51 }, { 179, 77, 230 },
+        { 51, 204, 204 }, { 230, 230, 77 }, { 230, 102, 179 }, { 128, 128, 128 }
+    };
+    static const unsigned char legs[3] = { 40, 50, 110 }, skin[3] = { 249, 224, 192 };
+    visitorVertexCount = 0;
+    if (visitors.agents.empty())
+        return;
+    visitorVertices = frameArena.allocateArray<VisitorVertex>(visitors.agents.size() * VISITOR_VERTICES);
+    if (!visitorVertices)
+        return;
+    VisitorVertex* out = visitorVertices;
+    for (size_t i = 0; i < visitors.agents.size(); i++) {
+        const NavAgent& a = visitors.agents[i];
+        float fx = navDirectionX[a.heading], fz = navDirectionZ[a.heading];
+        writeVisitorBox(out, a.x, GROUND_LEVEL, a.z, fx, fz, 0.017f, 0.009f, 0.05f, legs);
+        writeVisitorBox(out + 24, a.x, GROUND_LEVEL + 0.05f, a.z, fx, fz, 0.02f, 0.011f, 0.05f, shirts[i % 8]);
+        writeVisitorBox(out + 48, a.x, GROUND_LEVEL + 0.1f, a.z, fx, fz, 0.013f, 0.013f, 0.027f, skin);
+        out += VISITOR_VERTICES;
+    }
+    visitorVertexCount = (int)(out - visitorVertices);
+}
+
+void drawVisitors(Camera& view) {
+    if (visitorVertexCount == 0 || !view.sphereVisible(Vector3f(0, 0, 0), 1.5f * PARK_NAV_EXTENT))
+        return;
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(VisitorVertex), &visitorVertices[0].x);
+    glNormalPointer(GL_FLOAT, sizeof(VisitorVertex), &visitorVertices[0].nx);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(VisitorVertex), &visitorVertices[0].r);
+    glDrawArrays(GL_QUADS, 0, visitorVertexCount);
+    glPopClientAttrib();
 }
 
-void setupLights() {
+void drawTerrain(Camera& view) {
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glColor3f(0.4f, 0.6f, 0.2f);
+    for (int i = 0; i < terrainBatchCount; i++) {
+        const TerrainBatch& b = terrainBatches[i];
+        if (!view.sphereVisible(b.center, b.radius))
+            continue;
+        glVertexPointer(3, GL_FLOAT, sizeof(TerrainVertex), &b.vertices[0].x);
+        glNormalPointer(GL_FLOAT, sizeof(TerrainVertex), &b.vertices[0].nx);
+        glDrawElements(GL_TRIANGLES, terrain->indexCount(b.level), GL_UNSIGNED_SHORT, terrain->levelIndices(b.level));
+    }
+    glPopClientAttrib();
+}
+
+// glowing points in one additive draw, pixels across at one unit from the
+// eye; point sprites when the driver has them, smooth points otherwise
+void drawGlowPoints(const ParticleVertex* vertices, int count, float pixels) {
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_POINT_BIT | GL_TEXTURE_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glDepthMask(GL_FALSE);
+
+    if (ext.pointParameters) {
+        // shrinking with distance
+        GLfloat attenuation[] = { 0.0f, 0.0f, 1.0f };
+        ext.pointParameterfv(GL_POINT_DISTANCE_ATTENUATION, attenuation);
+        ext.pointParameterf(GL_POINT_SIZE_MIN, 1.0f);
+        ext.pointParameterf(GL_POINT_SIZE_MAX, 16.0f);
+        glPointSize(pixels * sceneScale());
+    }
+    else {
+        glPointSize(pixels / 2);
+    }
+
+    if (ext.pointSprites) {
+        if (particleTexture == 0)
+            createParticleTexture();
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, particleTexture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glEnable(GL_POINT_SPRITE);
+        glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
+    }
+    else {
+        glEnable(GL_POINT_SMOOTH);
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(ParticleVertex), &vertices[0].x);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ParticleVertex), &vertices[0].r);
+    glDrawArrays(GL_POINTS, 0, count);
+    glPopClientAttrib();
+
+    glPopAttrib();
+}
+
+// every live particle
+void drawParticles() {
+    if (particleVertexCount > 0)
+        drawGlowPoints(particleVertices, particleVertexCount, 6);
+}
+
+// a glow where each of the night's lights hangs
+void drawLightBulbs() {
+    if (nightMode && bulbVertices && parkLightCount > 0)
+        drawGlowPoints(bulbVertices, parkLightCount, 5);
+}
+
+// the seven lights nearest to a point, for plain OpenGL lighting
+int nearestLights(const Vector3f& p, int* nearest) {
+    int count = 0;
+    float distances[7];
+    for (int i = 0; i < parkLightCount; i++) {
+        const PointLight& l = parkLights[i];
+        float d = (l.x - p.x) * (l.x - p.x) + (l.y - p.y) * (l.y - p.y) + (l.z - p.z) * (l.z - p.z);
+        if (count == 7 && d >= distances[6])
+            continue;
+        int at = count < 7 ? count++ : 6;
+        for (; at > 0 && distances[at - 1] > d; at--) {
+            distances[at] = distances[at - 1];
+            nearest[at] = nearest[at - 1];
+        }
+        distances[at] = d;
+        nearest[at] = i;
+    }
+    return count;
+}
+
+// the moon on LIGHT0 and, without clustered shading, the lamps nearest to
+// what the camera looks at on the other seven; the modelview matrix must
+// hold the view
+void setupNightLights(Camera& viewCamera) {
+    GLfloat moon[] = { MOON_DIRECTION[0], MOON_DIRECTION[1], MOON_DIRECTION[2], 0.0f };
+    GLfloat moonColor[] = { 0.12f, 0.14f, 0.22f, 1.0f };
+    GLfloat ambient[] = { 0.05f, 0.06f, 0.1f, 1.0f };
+    glLightfv(GL_LIGHT0, GL_POSITION, moon);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, moonColor);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, moonColor);
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambient);
+
+    int nearest[7];
+    int count = clusteredShading.ready() ? 0 : nearestLights(viewCamera.center(), nearest);
+    for (int i = 0; i < 7; i++) {
+        GLenum light = GL_LIGHT1 + i;
+        if (i >= count) {
+            glDisable(light);
+            continue;
+        }
+        const PointLight& l = parkLights[nearest[i]];
+        GLfloat position[] = { l.x, l.y, l.z, 1.0f };
+        GLfloat color[] = { l.r, l.g, l.b, 1.0f };
+        glLightfv(light, GL_POSITION, position);
+        glLightfv(light, GL_DIFFUSE, color);
+        // close to the clustered falloff, which reaches zero at the radius
+        glLightf(light, GL_CONSTANT_ATTENUATION, 1.0f);
+        glLightf(light, GL_QUADRATIC_ATTENUATION, 25.0f / (l.radius * l.radius));
+        glEnable(light);
+    }
+}
+
+void setupDayLights() {
     GLfloat ambient[] = { 0.7f, 0.7f, 0.7, 1.0f };
     GLfloat diffuse[] = { 0.6f, 0.6f, 0.6, 1.0f };
     GLfloat specular[] = { 1.0f, 1.0f, 1.0, 1.0f };
@@ -840,29 +1524,81 @@ void setupLights() {
     //    GLfloat lightPosition[] = { -7.0f, 6.0f, 3.0f, 0.0f };
     glLightfv(GL_LIGHT0, GL_POSITION, lightIntensity);
     glLightfv(GL_LIGHT0, GL_DIFFUSE, lightIntensity);
+    // the defaults, which night mode changes
+    GLfloat white[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    GLfloat sceneAmbient[] = { 0.2f, 0.2f, 0.2f, 1.0f };
+    glLightfv(GL_LIGHT0, GL_SPECULAR, white);
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, sceneAmbient);
+    for (int i = 1; i < 8; i++)
+        glDisable(GL_LIGHT0 + i);
 }
-void setupCamera() {
+
+void setupLights(Camera& viewCamera) {
+    setupDayLights();
+    if (nightMode)
+        setupNightLights(viewCamera);
+}
+void setupCamera(Camera& viewCamera) {
     glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(60, screenWidth / screenHeight, 0.001, 1000);
+    glLoadMatrixf(viewCamera.projection());
 
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    camera.look();
+    glLoadMatrixf(viewCamera.view());
 }
 
-void Keyboard(unsigned char key, int x, int y) {
-    if (timer == 0)
+void setupViews() {
+    views[VIEW_FREE].name = "Free";
+    views[VIEW_FREE].camera = &camera;
+    views[VIEW_TOP].name = "Top";
+    views[VIEW_FRONT].name = "Front";
+    views[VIEW_SIDE].name = "Side";
+    for (int i = 0; i < 3; i++) {
+        presetCameras[i].lookAt(presetEyes[i], presetCenters[i]);
+        views[VIEW_TOP + i].camera = &presetCameras[i];
+    }
+}
+
+// quadrant of a view in split screen, the whole area otherwise
+void viewRect(int v, int width, int height, int& x, int& y, int& w, int& h) {
+    if (!splitScreen) {
+        x = 0;
+        y = 0;
+        w = width;
+        h = height;
         return;
+    }
+    w = width / 2;
+    h = height / 2;
+    x = v % 2 == 0 ? 0 : w;
+    y = v < 2 ? h : 0;
+}
+
+// in a shared park the move is predicted here and sent to the server
+void movePlayerLocally(PlayerMove move) {
+    partChanged(OCCLUDER_PARTS + 0);
+    if (netClient) {
+        netClient->move(move);
+        player.posX = netClient->predicted.posX;
+        player.posZ = netClient->predicted.posZ;
+        player.rotY = netClient->predicted.rotY;
+    }
+    else {
+        movePlayer(player, move, TERRAIN_BOUNDS);
+    }
+}
+
+void handleKey(unsigned char key) {
+    if (!game.acceptsInput())
+        return;
+
+    sceneRevision++;
 
     if (key == ' ') {
-        animationsActive = !animationsActive;
-        PlaySound(TEXT("anim"), NULL, SND_ASYNC);
-        animationSoundDelay = 1;
+        game.post(GAME_EVENT_TOGGLE_PAUSE);
     }
 
     float d = 0.03;
-    float moveDistance = 0.03f;
+    float presetTransitionTime = 0.6f;
 
     switch (key) {
     case 'w':
@@ -884,62 +1620,119 @@ void Keyboard(unsigned char key, int x, int y) {
         camera.moveZ(-d);
         break;
     case 't': // top view
-        camera.eye.x = 0.0160754;
-        camera.eye.y = 1.27918;
-        camera.eye.z = -0.048015;
-        camera.center.x = 0.016228;
-        camera.center.y = 0.016228;
-        camera.center.z = 0.016228;
+        camera.transitionTo(presetEyes[0], presetCenters[0], presetTransitionTime);
         break;
     case 'f': // front view
-        camera.eye.x = 0.0212869;
-        camera.eye.y = 0.205086;
-        camera.eye.z = 1.08428;
-        camera.center.x = 0.0167281;
-        camera.center.y = 0.0167281;
-        camera.center.z = 0.0167281;
+        camera.transitionTo(presetEyes[1], presetCenters[1], presetTransitionTime);
         break;
     case 'c': // side view
-        camera.eye.x = -0.992256;
-        camera.eye.y = 0.227585;
-        camera.eye.z = 0.0032941;
-        camera.center.x = 0.00435436;
-        camera.center.y = 0.00435436;
-        camera.center.z = 0.00435436;
+        camera.transitionTo(presetEyes[2], presetCenters[2], presetTransitionTime);
         break;
     case 'j': // move left (-x)
-        if (player.posX - moveDistance >= -0.45) {
-            player.moveX(-moveDistance);
-            player.rotateY(270);
-        }
+        movePlayerLocally(MOVE_LEFT);
         break;
     case 'l': // move right (x)
-        if (player.posX + moveDistance <= 0.45) {
-            player.moveX(moveDistance);
-            player.rotateY(90);
-        }
+        movePlayerLocally(MOVE_RIGHT);
         break;
     case 'k': // move forward (+z)
-        if (player.posZ + moveDistance <= 0.45) {
-            player.moveZ(moveDistance);
-            player.rotateY(0);
-        }
+        movePlayerLocally(MOVE_FORWARD);
         break;
     case 'i': // move backward (-z)
-        if (player.posZ - moveDistance >= -0.5) {
-            player.moveZ(-moveDistance);
-            player.rotateY(180);
-        }
+        movePlayerLocally(MOVE_BACK);
         break;
     case GLUT_KEY_ESCAPE:
         exit(EXIT_SUCCESS);
     }
 
-    glutPostRedisplay();
+    requestRedraw();
 
 }
 
-void Special(int key, int x, int y) {
+void toggleCapture() {
+    if (capture.isActive())
+        capture.stop();
+    else if (!capture.start(capturePath, screenWidth, screenHeight))
+        printf("could not start capture %s\n", capturePath);
+}
+
+void stopCapture() {
+    capture.stop();
+}
+
+void Keyboard(unsigned char key, int x, int y) {
+    // not game input, so not recorded
+    if (key == 'v') {
+        toggleCapture();
+        return;
+    }
+    if (key == 'o') {
+        occlusionEnabled = !occlusionEnabled;
+        for (int v = 0; v < VIEW_COUNT; v++) {
+            views[v].occlusion.enabled = occlusionEnabled;
+            views[v].occlusion.reset();
+        }
+        sceneRevision++;
+        requestRedraw();
+        return;
+    }
+    if (key == 'r') {
+        dynamicResolution = !dynamicResolution;
+        resolution.scale = resolution.maxScale;
+        sceneRevision++;
+        requestRedraw();
+        return;
+    }
+    if (key == 'x') {
+        AAMode next = aaMode;
+        do
+            next = (AAMode)((next + 1) % AA_MODE_COUNT);
+        while (!aaAvailable(next));
+        setAAMode(next);
+        printf("anti-aliasing %s\n", aaModeNames[aaMode]);
+        requestRedraw();
+        return;
+    }
+    if (key == 'm') {
+        splitScreen = !splitScreen;
+        sceneRevision++;
+        requestRedraw();
+        return;
+    }
+    if (key == 'n') {
+        nightMode = !nightMode;
+        sceneRevision++;
+        diagnosticsRevision++;
+        requestRedraw();
+        return;
+    }
+    if (key == 'g') {
+        gpuAnimation = !gpuAnimation;
+        if (gpuAnimation && !rideShading.ready())
+            printf("no GLSL, the rides stay posed on the CPU\n");
+        sceneRevision++;
+        diagnosticsRevision++;
+        requestRedraw();
+        return;
+    }
+    if (key == 'b') {
+        animationLevels = !animationLevels;
+        sceneRevision++;
+        diagnosticsRevision++;
+        requestRedraw();
+        return;
+    }
+    if (key == 'h') {
+        showDiagnostics = !showDiagnostics;
+        diagnosticsRevision++;
+        requestRedraw();
+        return;
+    }
+
+    recordEvent(EVENT_KEY, key);
+    handleKey(key);
+}
+
+void handleSpecial(int key) {
 
     float a = 1.0;
 
@@ -958,217 +1751,1201 @@ void Special(int key, int x, int y) {
         break;
     }
 
-    glutPostRedisplay();
+    requestRedraw();
+}
+
+void Special(int key, int x, int y) {
+    recordEvent(EVENT_SPECIAL, key);
+    handleSpecial(key);
 }
 
 void gameOver() {
-    animationsActive = false;
-    glDisable(GL_LIGHTING);
-    glColor3f(1.0 * 0.8, 0.0, 0.0);
-    glRasterPos2i(10, screenHeight - 30);
-    char overText[] = "Game Over!";
-    for (char* c = overText; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
-    }
-    glEnable(GL_LIGHTING);
+    text.setText(TEXT_MESSAGE, 10, screenHeight - 30, 1.0 * 0.8, 0.0, 0.0, "Game Over!");
 }
 
 void youWin() {
-    animationsActive = false;
-    glDisable(GL_LIGHTING);
-    glColor3f(0.0, 1.0, 0.0);
-    glRasterPos2i(10, screenHeight - 30);
-    char overText[] = "You Win!";
-    for (char* c = overText; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
-    }
-    glEnable(GL_LIGHTING);
-    if (!soundPlayed) {
-        PlaySound(TEXT("ticket"), NULL, SND_ASYNC);
-        soundPlayed = true;
-    }
+    text.setText(TEXT_MESSAGE, 10, screenHeight - 30, 0.0, 1.0, 0.0, "You Win!");
+}
+
+void beginHud() {
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, screenWidth, 0, screenHeight);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+}
+
+void endHud() {
+    glEnable(GL_DEPTH_TEST);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
 }
 
-void update(int value) {
-    if (animationSoundDelay == 0)
-    {
-        PlaySound(TEXT("backGround"), NULL, SND_ASYNC);
-        animationSoundDelay = -1;
+// unchanged strings keep their laid out quads, so this is cheap every frame
+void drawHud() {
+    char line[TEXT_SLOT_LENGTH];
+
+    if (game.status == STATE_LOST) {
+        gameOver();
     }
+    else if (game.status == STATE_WON) {
+        youWin();
+    }
+    else {
+        text.clear(TEXT_MESSAGE);
+    }
+
+    if (netClient)
+        snprintf(line, sizeof(line), "Tickets: %d", netTickets);
     else
-        animationSoundDelay--;
+        snprintf(line, sizeof(line), "Tickets: %d/1", game.ticketCollected ? 1 : 0);
+    text.setText(TEXT_SCORE, screenWidth / 2 - 50, screenHeight - 30, 1.0, 1.0, 1.0, line);
+
+    snprintf(line, sizeof(line), "Time: %d:%02d", game.timer / 60, game.timer % 60);
+    float timerColor = game.timer <= 10 ? 0.0 : 1.0;
+    text.setText(TEXT_TIMER, screenWidth - 10 - text.width(line), screenHeight - 30, 1.0, timerColor, timerColor, line);
+
+    if (showDiagnostics) {
+        const View& main = views[VIEW_FREE];
+        snprintf(line, sizeof(line), "frame %.2f ms  drawn %u  hud %u  skipped %u  occluded %d/%d (%.0f%%)  outside %d  allocs %lu  cmds %d  rec %d  res %.2f",
+            lastFrameMs, governor.framesDrawn, governor.hudFramesDrawn, governor.framesSkipped,
+            main.occlusion.skipped, main.occlusion.tested, main.occlusion.skippedPercent(), main.frustumCulled,
+            lastFrameAllocations, commandsSubmitted, partsRecorded, sceneScale());
+        text.setText(TEXT_DIAGNOSTICS, 10, screenHeight - 54, 1.0, 1.0, 0.0, line);
+    }
+    else {
+        text.clear(TEXT_DIAGNOSTICS);
+    }
 
-    if (ticketSoundDelay == 0 && ticket.isHit)
-    {
-        PlaySound(TEXT("backGround"), NULL, SND_ASYNC);
-        ticketSoundDelay = -1;
+    if (showDiagnostics && nightMode) {
+        if (clusteredShading.ready())
+            snprintf(line, sizeof(line), "lights %d  binning %.3f ms  %d light-cluster pairs  %.1f lights per fragment",
+                parkLightCount, lightBinningMs, lightClusters.indexCount, lightsPerFragment);
+        else
+            snprintf(line, sizeof(line), "lights %d, nearest 7 in fixed-function lighting (no GLSL)", parkLightCount);
+        text.setText(TEXT_LIGHTING, 10, screenHeight - 78, 1.0, 1.0, 0.0, line);
     }
-    else
-    {
-        if (ticket.isHit)
-            ticketSoundDelay--;
+    else {
+        text.clear(TEXT_LIGHTING);
     }
 
+    if (showDiagnostics) {
+        snprintf(line, sizeof(line), "rides posed on the %s  %d instances  tick %u  %.3f ms recording and posing  evaluated %d  skipped %d%s",
+            ridesOnGpu ? "GPU" : "CPU", ANIMATED_RIDES + flotillaSize, rideTicks, posingMs,
+            animationLod.evaluated, animationLod.skipped, animationLevels ? "" : " (all at full rate)");
+        text.setText(TEXT_ANIMATION, 10, screenHeight - 102, 1.0, 1.0, 0.0, line);
+    }
+    else {
+        text.clear(TEXT_ANIMATION);
+    }
 
-    if (timer == 0) {
-        if (ticket.isHit)
-        {
-            win = true;
-            PlaySound(TEXT("win"), NULL, SND_ASYNC);
+    // per-view statistics in the bottom corner of each quadrant
+    for (int v = 0; v < VIEW_COUNT; v++) {
+        if (!splitScreen) {
+            text.clear(TEXT_VIEW_LABEL + v);
+            continue;
         }
+        int x, y, w, h;
+        viewRect(v, screenWidth, screenHeight, x, y, w, h);
+        const View& view = views[v];
+        snprintf(line, sizeof(line), "%s  cmds %d  occluded %d/%d  outside %d",
+            view.name, view.commands, view.occlusion.skipped, view.occlusion.tested, view.frustumCulled);
+        text.setText(TEXT_VIEW_LABEL + v, x + 10, y + 10, 1.0, 1.0, 1.0, line);
+    }
+
+    text.draw();
+}
+
+// HUD-only frames put back the scene pixels saved under the HUD and redraw
+// the text. With pixel buffers the strip never leaves the GPU: the read
+// only queues a copy into the buffer and the draw takes it from there, so
+// full frames do not wait on it. Without them it comes back to the CPU.
+void saveHudBackdrop() {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (!ext.pixelBuffers) {
+        glReadPixels(hudX, hudY, hudWidth, hudHeight, GL_RGBA, GL_UNSIGNED_BYTE, &hudBackdrop[0]);
+        return;
+    }
+    size_t size = (size_t)hudWidth * hudHeight * 4;
+    if (hudBackdropBuffer == 0)
+        ext.genBuffers(1, &hudBackdropBuffer);
+    ext.bindBuffer(GL_PIXEL_PACK_BUFFER, hudBackdropBuffer);
+    if (hudBackdropBufferSize != size) {
+        ext.bufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptrExt)size, NULL, GL_STREAM_COPY);
+        hudBackdropBufferSize = size;
+    }
+    glReadPixels(hudX, hudY, hudWidth, hudHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    ext.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void restoreHudBackdrop() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glRasterPos2i(hudX, hudY);
+    if (hudBackdropBuffer == 0) {
+        glDrawPixels(hudWidth, hudHeight, GL_RGBA, GL_UNSIGNED_BYTE, &hudBackdrop[0]);
+        return;
+    }
+    ext.bindBuffer(GL_PIXEL_UNPACK_BUFFER, hudBackdropBuffer);
+    glDrawPixels(hudWidth, hudHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    ext.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// world-space box around the scaled placement of a local box
+void placedBounds(const Vector3f& position, float scale, const Vector3f& localLow, const Vector3f& localHigh,
+    Vector3f& low, Vector3f& high) {
+    low = position + localLow * scale;
+    high = position + localHigh * scale;
+}
+
+void occludeeBounds(int i, Vector3f& low, Vector3f& high) {
+    float ty = hotAirBalloon.translationY;
+    switch (i) {
+    case 0:
+        // drawn scaled first, then moved up 0.25
+        placedBounds(Vector3f(0, 0.2, 0), 0.8,
+            Vector3f(player.posX - 0.08, player.posY - 0.24, player.posZ - 0.08),
+            Vector3f(player.posX + 0.08, player.posY + 0.06, player.posZ + 0.08), low, high);
+        break;
+    case 1: placedBounds(Vector3f(0.5, 0.4, 0.2), 0.3, Vector3f(-0.1, ty - 0.28, -0.1), Vector3f(0.1, ty + 0.15, 0.1), low, high); break;
+    case 2: placedBounds(Vector3f(0.6, 0.43, 0.3), 0.35, Vector3f(-0.1, ty - 0.28, -0.1), Vector3f(0.1, ty + 0.15, 0.1), low, high); break;
+    case 3: placedBounds(Vector3f(-0.4, 0.43, -0.6), 0.35, Vector3f(-0.1, ty - 0.28, -0.1), Vector3f(0.1, ty + 0.15, 0.1), low, high); break;
+    case 4: placedBounds(Vector3f(-0.35, 0.12, 0), 0.8, Vector3f(-0.2, -0.12, -0.2), Vector3f(0.2, 0.26, 0.2), low, high); break;
+    case 5: placedBounds(Vector3f(0.3, 0.06, -0.2), 0.85 * tree.scale, Vector3f(-0.06, -0.06, -0.06), Vector3f(0.06, 0.28, 0.06), low, high); break;
+    case 6: placedBounds(Vector3f(0.42, 0.06, 0.1), 0.7 * tree.scale, Vector3f(-0.06, -0.06, -0.06), Vector3f(0.06, 0.28, 0.06), low, high); break;
+    case OCCLUDEE_TICKET:
+        placedBounds(Vector3f(ticket.posX, 0.03, ticket.posZ), 0.3,
+            Vector3f(ticket.translationX - 0.12, -0.05, -0.02), Vector3f(ticket.translationX + 0.12, 0.05, 0.02), low, high);
+        break;
+    }
+}
+
+void recordPart(int part, CommandList& c) {
+    switch (part) {
+    case PART_SKY:
+        drawSky(c);
+        break;
+    case PART_FENCES:
+        c.push();
+        c.translate(0, 0.0, -0.5);
+        drawFence(c, 0.02, 0.3);
+        c.pop();
+
+        c.push();
+        c.translate(-0.5, 0, 0);
+        c.rotate(90, 0, 1, 0);
+        drawFence(c, 0.02, 0.3);
+        c.pop();
+
+        c.push();
+        c.translate(0.5, 0, 0);
+        c.rotate(90, 0, 1, 0);
+        drawFence(c, 0.02, 0.3);
+        c.pop();
+
+        if (nightMode)
+            drawLampPosts(c);
+        break;
+    case PART_FERRIS_WHEEL:
+        c.translate(0.0, 0.37, -0.42);
+        c.scale(0.9, 0.9, 0.9);
+        drawFerrisWheelStructure(c);
+        break;
+    case PART_TICKET_STAND:
+        c.translate(-0.42, 0.08, 0.35);
+        c.rotate(90, 0, 1, 0);
+        c.scale(0.5, 0.5, 0.4);
+        c.animation(ANIMATED_TICKET_STAND);
+        drawTicketStand(c);
+        break;
+    case PART_REMOTE_PLAYERS:
+        drawRemotePlayers(c);
+        break;
+    case OCCLUDER_PARTS + 0:
+        c.scale(0.8, 0.8, 0.8);
+        c.translate(0, 0.25, 0);
+        drawPlayer(c);
+        break;
+    case OCCLUDER_PARTS + 1:
+        c.translate(0.5, 0.4, 0.2);
+        c.scale(0.3, 0.3, 0.3);
+        c.color(1.0, 0.0, 0.0);
+        c.animation(ANIMATED_RED_BALLOON);
+        drawHotAirBalloon(c, posed(hotAirBalloon.translationY, 0));
+        break;
+    case OCCLUDER_PARTS + 2:
+        c.translate(0.6, 0.43, 0.3);
+        c.scale(0.35, 0.35, 0.35);
+        c.color(0.0, 0.0, 1.0);
+        c.animation(ANIMATED_BLUE_BALLOON);
+        drawHotAirBalloon(c, posed(hotAirBalloon.translationY, 0));
+        break;
+    case OCCLUDER_PARTS + 3:
+        c.translate(-0.4, 0.43, -0.6);
+        c.scale(0.35, 0.35, 0.35);
+        c.color(0.0, 1.0, 0.0);
+        c.animation(ANIMATED_GREEN_BALLOON);
+        drawHotAirBalloon(c, posed(hotAirBalloon.translationY, 0));
+        break;
+    case OCCLUDER_PARTS + 4:
+        c.translate(-0.35, 0.12, 0);
+        c.rotate(90, 0, 1, 0);
+        c.scale(0.8, 0.8, 0.8);
+        drawSwingStructure(c);
+        break;
+    case OCCLUDER_PARTS + 5:
+        c.translate(0.3, 0.06, -0.2);
+        c.scale(0.85, 0.85, 0.85);
+        c.animation(ANIMATED_NEAR_TREE);
+        drawTree(c);
+        break;
+    case OCCLUDER_PARTS + 6:
+        c.translate(0.42, 0.06, 0.1);
+        c.scale(0.7, 0.7, 0.7);
+        c.animation(ANIMATED_FAR_TREE);
+        drawTree(c);
+        break;
+    case OCCLUDER_PARTS + OCCLUDEE_TICKET:
+        c.translate(ticket.posX, 0.03, ticket.posZ);
+        c.scale(0.3, 0.3, 0.3);
+        c.animation(ANIMATED_TICKET);
+        drawTicket(c);
+        break;
+    }
+}
+
+// the ride each part is posed from, -1 for none
+int partRide(int part) {
+    switch (part) {
+    case PART_FENCES: return ANIM_FENCE;
+    case PART_FERRIS_WHEEL: return ANIM_WHEEL;
+    case PART_TICKET_STAND: return ANIM_TICKET_STAND;
+    case OCCLUDER_PARTS + 1:
+    case OCCLUDER_PARTS + 2:
+    case OCCLUDER_PARTS + 3: return ANIM_BALLOONS;
+    case OCCLUDER_PARTS + 4: return ANIM_SWING;
+    case OCCLUDER_PARTS + 5:
+    case OCCLUDER_PARTS + 6: return ANIM_TREES;
+    case OCCLUDER_PARTS + OCCLUDEE_TICKET: return ANIM_TICKET;
+    default: return -1;
+    }
+}
+
+// a part is recorded again only when what it is drawn from changes: the
+// tick its ride was last posed at (unless the ride shader moves it; the
+// fence colors still change on the CPU), so a ride the animation levels
+// freeze or slow keeps its list; whatever partChanged() marked; night mode
+// and where the rides are posed. Each count only grows, so their sum
+// changes whenever one of them does.
+unsigned partVersion(int part) {
+    unsigned source = partChanges[part];
+    int ride = partRide(part);
+    if (ride >= 0 && (!ridesOnGpu || ride == ANIM_FENCE))
+        source += (unsigned)(animationLod.posedTick[ride] + 1);
+    return source * 4 + (nightMode ? 1 : 0) + (ridesOnGpu ? 2 : 0);
+}
+
+void recordParts(void* data, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        if (partLists[i].version == partVersions[i])
+            continue;
+        // the ticket body has no color of its own and always showed the
+        // ticket stand sign color it followed in the original draw order
+        if (i == OCCLUDER_PARTS + OCCLUDEE_TICKET)
+            partLists[i].begin(partVersions[i], 1.0 * 0.8, 1.0 * 0.8, 0.0);
         else
-        {
-            lose = true;
-            PlaySound(TEXT("lose"), NULL, SND_ASYNC);
-        }
+            partLists[i].begin(partVersions[i]);
+        recordPart(i, partLists[i]);
+    }
+}
+
+// records the parts whose source changed since their last recording
+void recordScene() {
+    partsRecorded = 0;
+    for (int i = 0; i < PART_COUNT; i++) {
+        partVersions[i] = partVersion(i);
+        if (partLists[i].version != partVersions[i])
+            partsRecorded++;
+    }
+    if (partsRecorded > 0)
+        jobs.parallelFor(PART_COUNT, 1, recordParts, NULL);
+}
+
+// the clustered and ride shaders stand in for GL_LIGHTING while bound
+void setLighting(bool lit) {
+    if (lit)
+        glEnable(GL_LIGHTING);
+    else
+        glDisable(GL_LIGHTING);
+    if (clusteredShading.active())
+        clusteredShading.setLit(lit);
+    if (rideShading.active())
+        rideShading.setLit(lit);
+}
+
+void submitCommand(const DrawCommand& d, bool& lit) {
+    if (d.lit != lit) {
+        setLighting(d.lit);
+        lit = d.lit;
+    }
+    glPushMatrix();
+    if (rideShading.active()) {
+        rideShading.setInstance(d.animation >= 0 ? &rideInstances[d.animation] : NULL);
+        glLoadMatrixf(d.matrix);
     }
     else {
-        timer--;
-        glutTimerFunc(1000, update, 0);
+        glMultMatrixf(d.matrix);
     }
-    glutPostRedisplay();
+    glColor3fv(d.color);
+    drawMesh(d.mesh);
+    glPopMatrix();
+    commandsSubmitted++;
 }
 
-void Display() {
-    setupCamera();
-    setupLights();
+// the occluder parts, merged and sorted so lighting changes once; the
+// sorted order is built once per frame and submitted by every view
+void sortOccluders() {
+    CommandList* lists[OCCLUDER_PARTS];
+    int total = 0;
+    for (int i = 0; i < OCCLUDER_PARTS; i++) {
+        lists[i] = partIsImpostor[i] ? &noCommands : &partLists[i];
+        total += lists[i]->count;
+    }
+    sortedOccluderCount = 0;
+    sortedOccluders = frameArena.allocateArray<const DrawCommand*>(total);
+    if (sortedOccluders)
+        sortedOccluderCount = mergeCommandLists(lists, OCCLUDER_PARTS, sortedOccluders);
+}
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void submitOccluders() {
+    bool lit = true;
+    for (int i = 0; i < sortedOccluderCount; i++)
+        submitCommand(*sortedOccluders[i], lit);
+    if (!lit)
+        setLighting(true);
+}
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    gluOrtho2D(0, screenWidth, 0, screenHeight);
+void submitList(const CommandList& list) {
+    bool lit = true;
+    for (int i = 0; i < list.count; i++)
+        submitCommand(list.commands[i], lit);
+    if (!lit)
+        setLighting(true);
+}
 
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
+void submitPart(int part) {
+    submitList(partLists[part]);
+}
 
-    if (timer == 0 && !ticket.isHit) {
-        gameOver();
+// each kind at the size and pose its atlas cells show
+void recordImpostorKind(int kind, CommandList& c) {
+    c.begin(0);
+    switch (kind) {
+    case IMPOSTOR_TREE: drawTreeShape(c); break;
+    case IMPOSTOR_RED_BALLOON: c.color(1.0, 0.0, 0.0); drawHotAirBalloon(c, 0); break;
+    case IMPOSTOR_BLUE_BALLOON: c.color(0.0, 0.0, 1.0); drawHotAirBalloon(c, 0); break;
+    case IMPOSTOR_GREEN_BALLOON: c.color(0.0, 1.0, 0.0); drawHotAirBalloon(c, 0); break;
+    case IMPOSTOR_FERRIS_WHEEL: drawFerrisWheelStructure(c); break;
     }
-    else if (checkCollision(ticket)) {
-        ticket.isHit = true;
-        youWin();
+}
+
+// every kind from every angle, drawn into the window and read back like the
+// text atlas; once over black and once over white, so the difference gives
+// each pixel's coverage. Needs a visible window at least as big as the used
+// part of the atlas, before the frame clears the screen.
+void buildImpostorAtlas() {
+    impostorAtlasTried = true;
+    int usedWidth = IMPOSTOR_ANGLES * IMPOSTOR_CELL, usedHeight = IMPOSTOR_KINDS * IMPOSTOR_CELL;
+    if (screenWidth < usedWidth || screenHeight < usedHeight) {
+        printf("window too small for the impostor atlas, distant trees are not drawn\n");
+        return;
     }
 
+    std::vector<unsigned char> over[2];
+    static CommandList kindList;
+    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glEnable(GL_SCISSOR_TEST);
+    for (int background = 0; background < 2; background++) {
+        glScissor(0, 0, usedWidth, usedHeight);
+        glClearColor((float)background, (float)background, (float)background, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (int kind = 0; kind < IMPOSTOR_KINDS; kind++) {
+            const ImpostorFrame& frame = impostorFrames[kind];
+            recordImpostorKind(kind, kindList);
+            for (int angle = 0; angle < IMPOSTOR_ANGLES; angle++) {
+                glViewport(angle * IMPOSTOR_CELL, kind * IMPOSTOR_CELL, IMPOSTOR_CELL, IMPOSTOR_CELL);
+                glScissor(angle * IMPOSTOR_CELL, kind * IMPOSTOR_CELL, IMPOSTOR_CELL, IMPOSTOR_CELL);
+                glMatrixMode(GL_PROJECTION);
+                glLoadIdentity();
+                glOrtho(-frame.size / 2, frame.size / 2, frame.bottom, frame.bottom + frame.size, -2, 2);
+                glMatrixMode(GL_MODELVIEW);
+                glLoadIdentity();
+                setupDayLights();
+                // seen from angle * 45 degrees about y
+                glRotatef(-angle * 360.0f / IMPOSTOR_ANGLES, 0, 1, 0);
+                submitList(kindList);
+            }
+        }
+        over[background].resize(IMPOSTOR_ATLAS_WIDTH * IMPOSTOR_ATLAS_HEIGHT * 3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_PACK_ROW_LENGTH, IMPOSTOR_ATLAS_WIDTH);
+        glReadPixels(0, 0, usedWidth, usedHeight, GL_RGB, GL_UNSIGNED_BYTE, &over[background][0]);
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    }
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+
+    std::vector<unsigned char> atlas(IMPOSTOR_ATLAS_WIDTH * IMPOSTOR_ATLAS_HEIGHT * 4, 0);
+    for (int i = 0; i < IMPOSTOR_ATLAS_WIDTH * IMPOSTOR_ATLAS_HEIGHT; i++) {
+        const unsigned char* black = &over[0][i * 3];
+        const unsigned char* white = &over[1][i * 3];
+        int coverage = 255 - ((white[0] - black[0]) + (white[1] - black[1]) + (white[2] - black[2])) / 3;
+        if (coverage <= 0)
+            continue;
+        for (int k = 0; k < 3; k++) {
+            int color = black[k] * 255 / coverage;
+            atlas[i * 4 + k] = (unsigned char)(color > 255 ? 255 : color);
+        }
+        atlas[i * 4 + 3] = (unsigned char)(coverage > 255 ? 255 : coverage);
+    }
+    glGenTextures(1, &impostorTexture);
+    glBindTexture(GL_TEXTURE_2D, impostorTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, IMPOSTOR_ATLAS_WIDTH, IMPOSTOR_ATLAS_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &atlas[0]);
+}
 
-    glPushMatrix();
-    drawSky();
-    glPopMatrix();
+// the rides that have an impostor, where recordPart puts them
+void rideImpostor(int i, Impostor& o, int& part) {
+    float ty = hotAirBalloon.translationY;
+    Impostor rides[RIDE_IMPOSTORS] = {
+        { 0.0f, 0.37f, -0.42f, 0.9f, 0, IMPOSTOR_FERRIS_WHEEL },
+        { 0.5f, 0.4f + 0.3f * ty, 0.2f, 0.3f, 0, IMPOSTOR_RED_BALLOON },
+        { 0.6f, 0.43f + 0.35f * ty, 0.3f, 0.35f, 0, IMPOSTOR_BLUE_BALLOON },
+        { -0.4f, 0.43f + 0.35f * ty, -0.6f, 0.35f, 0, IMPOSTOR_GREEN_BALLOON },
+        { 0.3f, 0.06f, -0.2f, 0.85f * tree.scale, 0, IMPOSTOR_TREE },
+        { 0.42f, 0.06f, 0.1f, 0.7f * tree.scale, 0, IMPOSTOR_TREE }
+    };
+    int parts[RIDE_IMPOSTORS] = { PART_FERRIS_WHEEL, OCCLUDER_PARTS + 1, OCCLUDER_PARTS + 2, OCCLUDER_PARTS + 3, OCCLUDER_PARTS + 5, OCCLUDER_PARTS + 6 };
+    o = rides[i];
+    part = parts[i];
+}
 
-    glPushMatrix();
-    glTranslated(0, 0.0, -0.5);
-    drawFence(0.02, 0.3);
-    glPopMatrix();
+// once per frame, from the main camera: the forest's quads, the trees near
+// enough to be drawn for real, and which rides are quads this frame
+void prepareImpostors() {
+    Vector3f eye = camera.position();
+    const Impostor** nearTrees = frameArena.allocateArray<const Impostor*>(NEAR_TREE_CAPACITY);
+    int nearCount = 0;
+    impostorBatchCount = 0;
+    if (nearTrees) {
+        impostorBatchCount = forest.prepare(eye, terrain->windowRadius() * CHUNK_SIZE, frameArena,
+            impostorVertices, impostorBatches, nearTrees, NEAR_TREE_CAPACITY, nearCount);
+    }
+    for (int l = 0; l < FOREST_LISTS; l++)
+        forestLists[l].begin(0);
+    for (int i = 0; i < nearCount; i++) {
+        const Impostor& t = *nearTrees[i];
+        CommandList& c = forestLists[i / (COMMAND_LIST_CAPACITY / 4)];
+        c.push();
+        c.translate(t.x, t.y, t.z);
+        c.rotate(t.yaw, 0, 1, 0);
+        c.scale(t.scale, t.scale, t.scale);
+        drawTreeShape(c);
+        c.pop();
+    }
 
-    glPushMatrix();
-    glTranslated(-0.5, 0, 0);
-    glRotated(90, 0, 1, 0);
-    drawFence(0.02, 0.3);
-    glPopMatrix();
+    // without an atlas every ride keeps its geometry
+    memset(partIsImpostor, 0, sizeof(partIsImpostor));
+    rideImpostorQuads = 0;
+    rideImpostorVertices = frameArena.allocateArray<ImpostorVertex>(RIDE_IMPOSTORS * 4);
+    if (!impostorTexture || !rideImpostorVertices)
+        return;
+    for (int i = 0; i < RIDE_IMPOSTORS; i++) {
+        Impostor o;
+        int part;
+        rideImpostor(i, o, part);
+        Vector3f d = Vector3f(o.x, o.y, o.z) - eye;
+        bool geometry;
+        float alpha = impostorAlpha(o, sqrt(d.dot(d)), geometry);
+        partIsImpostor[part] = !geometry;
+        if (alpha > 0)
+            writeImpostorQuad(o, eye, alpha, &rideImpostorVertices[4 * rideImpostorQuads++]);
+    }
+}
 
-    glPushMatrix();
-    glTranslated(0.5, 0, 0);
-    glRotated(90, 0, 1, 0);
-    drawFence(0.02, 0.3);
-    glPopMatrix();
+// blended over whatever geometry they are fading in on
+void drawImpostors(Camera& view) {
+    if (!impostorTexture || (impostorBatchCount == 0 && rideImpostorQuads == 0))
+        return;
 
-    glPushMatrix();
-    drawGround(0.02);
-    glPopMatrix();
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, impostorTexture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.05f);
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (impostorBatchCount > 0) {
+        glVertexPointer(3, GL_FLOAT, sizeof(ImpostorVertex), &impostorVertices[0].x);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(ImpostorVertex), &impostorVertices[0].u);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImpostorVertex), &impostorVertices[0].r);
+        for (int i = 0; i < impostorBatchCount; i++) {
+            const ImpostorBatch& b = impostorBatches[i];
+            if (view.sphereVisible(b.center, b.radius))
+                glDrawArrays(GL_QUADS, b.first, b.count);
+        }
+    }
+    if (rideImpostorQuads > 0) {
+        glVertexPointer(3, GL_FLOAT, sizeof(ImpostorVertex), &rideImpostorVertices[0].x);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(ImpostorVertex), &rideImpostorVertices[0].u);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImpostorVertex), &rideImpostorVertices[0].r);
+        glDrawArrays(GL_QUADS, 0, rideImpostorQuads * 4);
+    }
+    glPopClientAttrib();
 
-    glPushMatrix();
-    glScaled(0.8, 0.8, 0.8);
-    glTranslated(0, 0.25, 0);
-    drawPlayer();
-    glPopMatrix();
+    glPopAttrib();
+}
 
-    glPushMatrix();
-    glTranslated(0.0, 0.37, -0.42);
-    glScaled(0.9, 0.9, 0.9);
-    drawFerrisWheelStructure();
-    glPopMatrix();
+// bins the lights for this view's camera and binds the clustered shader
+void beginClusteredShading(Camera& viewCamera, int x, int y, int w, int h) {
+    const float* viewMatrix = viewCamera.view();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    lightClusters.bin(parkLights, parkLightCount, viewMatrix, viewCamera.projection());
+    lightBinningMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    lightBinningTotalMs += lightBinningMs;
+    lightBinnings++;
+
+    float moon[3];
+    for (int i = 0; i < 3; i++)
+        moon[i] = viewMatrix[i] * MOON_DIRECTION[0] + viewMatrix[4 + i] * MOON_DIRECTION[1] + viewMatrix[8 + i] * MOON_DIRECTION[2];
+    clusteredShading.begin(lightClusters, x, y, w, h, moon);
+}
 
-    glPushMatrix();
-    glTranslated(0.5, 0.4, 0.2);
-    glScaled(0.3, 0.3, 0.3);
-    glColor3f(1.0, 0.0, 0.0);
-    drawHotAirBalloon();
-    glPopMatrix();
+// binds the ride shader for a view if it moves the rides this frame
+bool beginRideShading(Camera& viewCamera) {
+    if (!ridesOnGpu)
+        return false;
+    rideShading.begin(viewCamera.view(), rideTicks);
+    return true;
+}
 
-    glPushMatrix();
-    glTranslated(0.6, 0.43, 0.3);
-    glScaled(0.35, 0.35, 0.35);
-    glColor3f(0.0, 0.0, 1.0);
-    drawHotAirBalloon();
-    glPopMatrix();
+void endRideShading() {
+    if (rideShading.active())
+        rideShading.end();
+}
 
-    glPushMatrix();
-    glTranslated(-0.4, 0.43, -0.6);
-    glScaled(0.35, 0.35, 0.35);
-    glColor3f(0.0, 1.0, 0.0);
-    drawHotAirBalloon();
-    glPopMatrix();
+// the park's animated rides as the ride shader sees them: where each part
+// of recordPart() turns, slides or grows in the world, on the curve of its
+// Park.h class
+void setupRideInstances() {
+    rideInstances[ANIMATED_WHEEL] = spinningInstance(MOTION_TURN, Vector3f(0, 0.37, -0.42), Vector3f(0, 0, 1), ferrisWheel);
 
-    glPushMatrix();
-    glTranslated(-0.35, 0.12, 0);
-    glRotated(90, 0, 1, 0);
-    glScaled(0.8, 0.8, 0.8);
-    drawSwingStructure();
-    glPopMatrix();
+    const Oscillator& bob = hotAirBalloon.bob;
+    rideInstances[ANIMATED_RED_BALLOON] = oscillatingInstance(MOTION_SHIFT, Vector3f(0.5, 0.4, 0.2), Vector3f(0, 0.3, 0), bob);
+    rideInstances[ANIMATED_BLUE_BALLOON] = oscillatingInstance(MOTION_SHIFT, Vector3f(0.6, 0.43, 0.3), Vector3f(0, 0.35, 0), bob);
+    rideInstances[ANIMATED_GREEN_BALLOON] = oscillatingInstance(MOTION_SHIFT, Vector3f(-0.4, 0.43, -0.6), Vector3f(0, 0.35, 0), bob);
 
-    glPushMatrix();
-    glTranslated(0.3, 0.06, -0.2);
-    glScaled(0.85, 0.85, 0.85);
-    drawTree();
-    glPopMatrix();
+    // the seat turns by -angle about the part's x, which is the world's -z
+    rideInstances[ANIMATED_SWING] = oscillatingInstance(MOTION_TURN, Vector3f(-0.39, 0.28, 0), Vector3f(0, 0, 1), swing.swinging);
 
-    glPushMatrix();
-    glTranslated(0.42, 0.06, 0.1);
-    glScaled(0.7, 0.7, 0.7);
-    drawTree();
-    glPopMatrix();
+    rideInstances[ANIMATED_NEAR_TREE] = oscillatingInstance(MOTION_SCALE, Vector3f(0.3, 0.06, -0.2), Vector3f(), tree.breathing);
+    rideInstances[ANIMATED_FAR_TREE] = oscillatingInstance(MOTION_SCALE, Vector3f(0.42, 0.06, 0.1), Vector3f(), tree.breathing);
 
-    glPushMatrix();
-    glTranslated(-0.42, 0.08, 0.35);
-    glRotated(90, 0, 1, 0);
-    glScaled(0.5, 0.5, 0.4);
-    drawTicketStand();
+    rideInstances[ANIMATED_TICKET_STAND] = oscillatingInstance(MOTION_SCALE, Vector3f(-0.42, 0.08, 0.35), Vector3f(), ticketStand.pulse);
+
+    // the ticket's collision box stays at posX, posZ; only the drawing slides
+    rideInstances[ANIMATED_TICKET] = oscillatingInstance(MOTION_SHIFT, Vector3f(), Vector3f(0.3, 0, 0), ticket.slide);
+
+    if (flotillaSize > 0) {
+        flotilla = new RideInstance[flotillaSize];
+        balloonFlotilla(flotilla, flotillaSize, bob, FLOTILLA_SCALE);
+    }
+    addParkAnimationSites(animationLod);
+}
+
+// the rides at the current tick, before the scene is recorded from them:
+// those some view sees close up, those seen from afar every few ticks and
+// the rest not at all until they come into view. A shared park's rides
+// come from the server as they are.
+void poseRides() {
+    if (netClient)
+        return;
+    if (animationLevels) {
+        animationLod.moveSite(ANIM_TICKET, 0, ticket.posX, 0.03f, ticket.posZ);
+        animationLod.beginViews();
+        for (int v = 0; v < (splitScreen ? VIEW_COUNT : 1); v++)
+            animationLod.see(*views[v].camera);
+    }
+    else {
+        animationLod.animateAll();
+    }
+    int count = animationLod.due(rideTicks, dueRides);
+    if (count > 0)
+        jobs.parallelFor(count, 1, evaluateRides, dueRides);
+}
+
+// one display list per balloon color, the balloon at rest at the origin
+void createFlotilla() {
+    static const float colors[FLOTILLA_COLORS][3] = { { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } };
+    CommandList balloon;
+    flotillaLists = glGenLists(FLOTILLA_COLORS);
+    for (int k = 0; k < FLOTILLA_COLORS; k++) {
+        balloon.begin(0, colors[k][0], colors[k][1], colors[k][2]);
+        drawHotAirBalloon(balloon, 0);
+        glNewList(flotillaLists + k, GL_COMPILE);
+        for (int i = 0; i < balloon.count; i++) {
+            const DrawCommand& d = balloon.commands[i];
+            glPushMatrix();
+            glMultMatrixf(d.matrix);
+            glColor3fv(d.color);
+            drawMesh(d.mesh);
+            glPopMatrix();
+        }
+        glEndList();
+    }
+}
+
+// the ride shader poses each balloon from its attributes alone; without it
+// every balloon's curve is evaluated here, every frame
+void drawFlotilla(Camera& viewCamera) {
+    if (flotillaSize == 0)
+        return;
+    if (!flotillaLists)
+        createFlotilla();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    glPushMatrix();
+    if (beginRideShading(viewCamera)) {
+        glLoadIdentity();
+        for (int i = 0; i < flotillaSize; i++) {
+            rideShading.setInstance(&flotilla[i]);
+            glCallList(flotillaLists + i % FLOTILLA_COLORS);
+        }
+        endRideShading();
+    }
+    else {
+        for (int i = 0; i < flotillaSize; i++) {
+            const RideInstance& r = flotilla[i];
+            float rise = rideValue(r, rideTicks);
+            glPushMatrix();
+            glTranslatef(r.place[0] + r.axis[0] * rise, r.place[1] + r.axis[1] * rise, r.place[2] + r.axis[2] * rise);
+            glScalef(r.place[3], r.place[3], r.place[3]);
+            glCallList(flotillaLists + i % FLOTILLA_COLORS);
+            glPopMatrix();
+        }
+    }
     glPopMatrix();
+    posingMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// now and then, how many lights the main view's fragments loop over, from
+// its depth buffer; a multisampled target cannot be read back directly
+void sampleLightsPerFragment(int x, int y, int w, int h) {
+    if (governor.framesDrawn % LIGHT_SAMPLE_INTERVAL != 0 || aaSamples(aaMode) > 0)
+        return;
+    if (lightDepthSamples.size() < (size_t)(w * h))
+        lightDepthSamples.resize(w * h);
+    glReadPixels(x, y, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, &lightDepthSamples[0]);
+    lightsPerFragment = lightClusters.lightsPerFragment(&lightDepthSamples[0], w, h, LIGHT_SAMPLE_STEP);
+    lightsPerFragmentTotal += lightsPerFragment;
+    lightSamples++;
+    diagnosticsRevision++;
+}
+
+void drawView(int v, int width, int height) {
+    View& view = views[v];
+    int x, y, w, h;
+    viewRect(v, width, height, x, y, w, h);
+    glViewport(x, y, w, h);
+    setupCamera(*view.camera);
+    setupLights(*view.camera);
+    bool clustered = nightMode && clusteredShading.ready();
+    if (clustered)
+        beginClusteredShading(*view.camera, x, y, w, h);
+
+    // big rides first so their depth can hide the attractions behind them
+    int submittedBefore = commandsSubmitted;
+    beginRideShading(*view.camera);
+    submitOccluders();
+    endRideShading();
+    drawTerrain(*view.camera);
+    drawVisitors(*view.camera);
+    for (int l = 0; l < FOREST_LISTS; l++)
+        submitList(forestLists[l]);
+
+    view.occlusion.beginFrame(view.camera->position());
+    view.frustumCulled = 0;
+    for (int i = 0; i < OCCLUDEE_COUNT; i++) {
+        // in a shared park the ticket comes back for the others
+        if (i == OCCLUDEE_TICKET && game.ticketCollected && !netClient)
+            continue;
+        if (partIsImpostor[OCCLUDER_PARTS + i])
+            continue;
+        Vector3f low, high;
+        occludeeBounds(i, low, high);
+        Vector3f half = (high - low) * 0.5f;
+        if (!view.camera->sphereVisible(low + half, sqrt(half.dot(half)))) {
+            view.frustumCulled++;
+            continue;
+        }
+        if (view.occlusion.beginDraw(i, low, high)) {
+            beginRideShading(*view.camera);
+            submitPart(OCCLUDER_PARTS + i);
+            endRideShading();
+            view.occlusion.endDraw(i);
+        }
+    }
+    drawFlotilla(*view.camera);
+    if (clustered) {
+        clusteredShading.end();
+        if (v == VIEW_FREE)
+            sampleLightsPerFragment(x, y, w, h);
+    }
+
+    drawImpostors(*view.camera);
+    drawParticles();
+    drawLightBulbs();
+    view.commands = commandsSubmitted - submittedBefore;
+}
+
+void drawFrame(RedrawKind kind) {
+    governor.frameDrawn(kind);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // only the HUD strip is restored, so text elsewhere (the split-screen
+    // labels) must not be blended over itself again
+    if (kind == REDRAW_HUD) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(hudX, hudY, hudWidth, hudHeight);
+        beginHud();
+        restoreHudBackdrop();
+        drawHud();
+        endHud();
+        glDisable(GL_SCISSOR_TEST);
+        capture.captureFrame();
+        glFlush();
+        return;
+    }
+
+    // the atlas is read back from the window, so it is built on the first
+    // frame the window is visible, before that frame clears the screen
+    if (!text.ready())
+        text.init(GLUT_BITMAP_HELVETICA_18, screenWidth, screenHeight);
+    if (!impostorAtlasTried)
+        buildImpostorAtlas();
+
+    float scale = sceneScale();
+    bool offscreen = sceneTarget.ready() && (scale < 1.0f || aaMode != AA_OFF);
+    int width = screenWidth, height = screenHeight;
+    if (offscreen) {
+        sceneTarget.begin(scale);
+        width = sceneTarget.width;
+        height = sceneTarget.height;
+    }
+    if (nightMode)
+        glClearColor(0.02f, 0.03f, 0.08f, 0.0f);
+    else
+        glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    ridesOnGpu = gpuAnimation && !nightMode && !netClient && rideShading.ready();
+    std::chrono::steady_clock::time_point recordStart = std::chrono::steady_clock::now();
+    poseRides();
+    recordScene();
+    posingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+    prepareImpostors();
+    sortOccluders();
+    prepareParticles();
+    prepareTerrain();
+    prepareVisitors();
+    prepareNightLights();
+    commandsSubmitted = 0;
+    for (int v = 0; v < (splitScreen ? VIEW_COUNT : 1); v++)
+        drawView(v, width, height);
+    if (offscreen) {
+        int w = sceneTarget.targetWidth(), h = sceneTarget.targetHeight();
+        if (aaMode == AA_POST)
+            edgeFilter.begin(w, h, (float)width / w, (float)height / h);
+        sceneTarget.end();
+        if (aaMode == AA_POST)
+            edgeFilter.end();
+    }
+    glViewport(0, 0, screenWidth, screenHeight);
+
+    saveHudBackdrop();
+    beginHud();
+    drawHud();
+    endHud();
+
+    capture.captureFrame();
+    // only a measured frame waits for the GPU: the resolution controller,
+    // the scale log, a replay and the per-mode AA costs need the
+    // rasterization in the frame time, not just the calls
+    bool measured = (dynamicResolution && sceneTarget.ready()) || scaleLog || replayPath;
+    if (measured)
+        glFinish();
+    else
+        glFlush();
+    lastFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (measured) {
+        aaFrames[aaMode]++;
+        aaFrameMs[aaMode] += lastFrameMs;
+        aaScale[aaMode] += scale;
+    }
+    posingTotalMs[ridesOnGpu] += posingMs;
+    posingFrames[ridesOnGpu]++;
+
+    if (scaleLog)
+        fprintf(scaleLog, "%u %.3f %.3f\n", governor.framesDrawn, lastFrameMs, scale);
+    if (dynamicResolution && sceneTarget.ready() && resolution.update(lastFrameMs))
+        diagnosticsRevision++;
+
+    if (!firstFrameDrawn) {
+        firstFrameDrawn = true;
+        printf("first frame after %.1f ms (meshes %s)\n",
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count(),
+            assetPack.isOpen() ? "from the asset pack" : "generated");
+    }
+}
+
+// everything since the previous frame counts towards this one: input,
+// simulation ticks and drawing
+void countFrameAllocations() {
+    lastFrameAllocations = frameAllocations.count();
+    frameAllocations.restart();
+    if (governor.framesDrawn + governor.hudFramesDrawn <= ALLOCATION_WARMUP_FRAMES)
+        return;
+    steadyFrames++;
+    if (lastFrameAllocations > 0)
+        allocatingFrames++;
+}
+
+void renderFrame(RedrawKind kind) {
+    frameArena.reset();
+    drawFrame(kind);
+    countFrameAllocations();
+}
+
+void Display() {
+    // nothing pending means the window system asked for the redraw
+    RedrawKind kind = pendingRedraw == REDRAW_NONE ? REDRAW_FULL : pendingRedraw;
+    pendingRedraw = REDRAW_NONE;
+    recordEvent(EVENT_FRAME, kind);
+    renderFrame(kind);
+}
+
+void Reshape(int w, int h) {
+    if (h < 1)
+        h = 1;
+    screenWidth = w;
+    screenHeight = h;
+    hudY = h - hudHeight;
+    hudWidth = w;
+    hudBackdrop.resize((size_t)hudWidth * hudHeight * 4);
+
+    // split-screen quadrants keep the window's aspect ratio
+    float aspect = (float)w / (float)h;
+    camera.setAspect(aspect);
+    for (int i = 0; i < 3; i++)
+        presetCameras[i].setAspect(aspect);
+
+    sceneTarget.resize(w, h, aaSamples(aaMode));
+    glViewport(0, 0, w, h);
+    governor.invalidate();
+    requestRedraw();
+}
+
+// mean cost of a full frame in each anti-aliasing mode that was used, as
+// name value lines like FrameStats::print
+void printAACosts(FILE* f) {
+    for (int i = 0; i < AA_MODE_COUNT; i++) {
+        if (aaFrames[i] == 0)
+            continue;
+        fprintf(f, "aa_%s_frames %u\n", aaModeNames[i], aaFrames[i]);
+        fprintf(f, "aa_%s_mean_ms %.4f\n", aaModeNames[i], aaFrameMs[i] / aaFrames[i]);
+        fprintf(f, "aa_%s_scale %.4f\n", aaModeNames[i], aaScale[i] / aaFrames[i]);
+    }
+}
+
+// headless: the shared park, its clients and a status line every few seconds
+int runServer(int port) {
+    if (!netSocket.open((unsigned short)port)) {
+        printf("could not open UDP port %d\n", port);
+        return EXIT_FAILURE;
+    }
+    ParkServer* server = new ParkServer(NetSocket::send, &netSocket);
+    printf("park server on UDP port %d, %d ticks per second\n", port, NET_TICK_RATE);
+
+    std::chrono::steady_clock::duration tickLength = std::chrono::microseconds(1000000 / NET_TICK_RATE);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    unsigned reportBytes = 0;
+    for (;;) {
+        NetAddress from;
+        int size;
+        while ((size = netSocket.receiveFrom(from, netPacket, sizeof(netPacket))) > 0)
+            server->receive(from, netPacket, size);
+        server->tick();
+
+        if (server->ticks % (5 * NET_TICK_RATE) == 0) {
+            int clients = server->clientCount();
+            printf("%d players, tick %.3f ms (mean %.3f ms), %.0f bytes/s per client\n", clients, server->lastTickMs,
+                server->totalTickMs / server->ticks, clients ? (server->bytesSent - reportBytes) / 5.0 / clients : 0.0);
+            reportBytes = server->bytesSent;
+        }
+
+        next += tickLength;
+        std::this_thread::sleep_until(next);
+    }
+}
 
-    if (!ticket.isHit) {
-        glPushMatrix();
-        glTranslated(0.3, 0.03, 0.3);
-        glScaled(0.3, 0.3, 0.3);
-        drawTicket();
-        glPopMatrix();
+void printFrameCounters() {
+    printf("frames drawn %u, hud only %u, skipped %u\n", governor.framesDrawn, governor.hudFramesDrawn, governor.framesSkipped);
+    printf("%u of %u steady-state frames allocated, frame arena peak %u of %u bytes, %u overflows\n",
+        allocatingFrames, steadyFrames, (unsigned)frameArena.peak, (unsigned)frameArena.size(), frameArena.overflows);
+    for (int v = 0; v < VIEW_COUNT; v++) {
+        const OcclusionCuller& occlusion = views[v].occlusion;
+        if (occlusion.totalTested > 0)
+            printf("%s view: occlusion skipped %.1f%% of %u attraction draws\n", views[v].name, occlusion.totalSkippedPercent(), occlusion.totalTested);
     }
+    for (int i = 0; i < AA_MODE_COUNT; i++) {
+        if (aaFrames[i] > 0)
+            printf("anti-aliasing %s: %u frames, mean %.2f ms at scale %.2f\n", aaModeNames[i], aaFrames[i], aaFrameMs[i] / aaFrames[i], aaScale[i] / aaFrames[i]);
+    }
+    if (terrain) {
+        printf("terrain: %u chunks from tiles, %u generated, %u evicted, at most %d of %d resident\n",
+            terrain->chunksFromTiles, terrain->chunksGenerated, terrain->chunksEvicted, terrain->peakResident, terrain->budget());
+    }
+    if (lightBinnings > 0) {
+        printf("clustered lighting: %d lights, binning mean %.3f ms over %u views, %.1f lights per fragment, %lu light-cluster pairs dropped\n",
+            parkLightCount, lightBinningTotalMs / lightBinnings, lightBinnings,
+            lightSamples ? lightsPerFragmentTotal / lightSamples : 0.0, lightClusters.overflows);
+    }
+    for (int gpu = 0; gpu < 2; gpu++) {
+        if (posingFrames[gpu] > 0 && (gpuAnimation || flotillaSize > 0))
+            printf("rides posed on the %s: %u frames, recording and posing %d instances mean %.3f ms\n",
+                gpu ? "GPU" : "CPU", posingFrames[gpu], ANIMATED_RIDES + flotillaSize, posingTotalMs[gpu] / posingFrames[gpu]);
+    }
+    if (animationLod.totalEvaluated + animationLod.totalSkipped > 0) {
+        printf("ride animation: %lu evaluations, %lu stale rides left for views that could not see them (%.1f%%)\n",
+            animationLod.totalEvaluated, animationLod.totalSkipped, animationLod.skippedPercent());
+    }
+    if (netClient) {
+        printf("network: %u snapshots (%u dropped), %u bytes in, %u bytes out\n",
+            netClient->snapshotsReceived, netClient->snapshotsDropped, netClient->bytesReceived, netClient->bytesSent);
+    }
+}
+
+void finishReplay() {
+    frameStats.print(stdout);
+    printAACosts(stdout);
+    if (frameTimesPath) {
+        FILE* f = fopen(frameTimesPath, "w");
+        if (f) {
+            frameStats.print(f);
+            printAACosts(f);
+            fclose(f);
+        }
+    }
+    if (comparePath)
+        frameStats.compare(comparePath, stdout);
+    if (replayDiverged)
+        printf("replay diverged from the recording (ticket pickup did not match)\n");
+    exit(replayDiverged ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+// frames are drawn by replayIdle, in the same order relative to input as when recorded
+void replayExpose() {
+}
 
-    glFlush();
+void replayIdle() {
+    int now = glutGet(GLUT_ELAPSED_TIME) - replayStartTime;
+    while (replayCursor < inputLog.events.size()) {
+        const InputEvent& e = inputLog.events[replayCursor];
+        if (!replayFast && (int)e.time > now)
+            return;
+        replayCursor++;
+
+        switch (e.type) {
+        case EVENT_KEY:
+            if (e.key == GLUT_KEY_ESCAPE)
+                finishReplay();
+            handleKey((unsigned char)e.key);
+            break;
+        case EVENT_SPECIAL:
+            handleSpecial(e.key);
+            break;
+        case EVENT_ANIM_TICK:
+            animStep();
+            break;
+        case EVENT_TICKET_PICKUP:
+            if (!game.ticketCollected)
+                replayDiverged = true;
+            break;
+        case EVENT_FRAME: {
+            auto start = std::chrono::high_resolution_clock::now();
+            renderFrame(e.key == REDRAW_HUD ? REDRAW_HUD : REDRAW_FULL);
+            pendingRedraw = REDRAW_NONE;
+            glFinish();
+            frameStats.frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+            // one frame per idle call so the window keeps processing its own events
+            return;
+        }
+        }
+    }
+    finishReplay();
 }
 
 int main(int argc, char** argv) {
+    startTime = std::chrono::steady_clock::now();
+    bool captureAtStart = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--fast") == 0)
+            replayFast = true;
+        else if (strcmp(argv[i], "--frametimes") == 0 && i + 1 < argc)
+            frameTimesPath = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc)
+            comparePath = argv[++i];
+        else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+            aaMode = parseAAMode(argv[++i]);
+            if (aaMode == AA_MODE_COUNT) {
+                printf("unknown anti-aliasing mode %s (off, msaa2, msaa4, post)\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc)
+            serverPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+            connectAddress = argv[++i];
+        else if (strcmp(argv[i], "--scalelog") == 0 && i + 1 < argc)
+            scaleLogPath = argv[++i];
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+            packPath = argv[++i];
+        else if (strcmp(argv[i], "--terrain") == 0 && i + 1 < argc)
+            terrainPath = argv[++i];
+        else if (strcmp(argv[i], "--chunkbudget") == 0 && i + 1 < argc)
+            chunkBudget = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--forest") == 0 && i + 1 < argc)
+            forestSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--visitors") == 0 && i + 1 < argc)
+            visitorCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--night") == 0)
+            nightMode = true;
+        else if (strcmp(argv[i], "--gpuanim") == 0)
+            gpuAnimation = true;
+        else if (strcmp(argv[i], "--fullanim") == 0)
+            animationLevels = false;
+        else if (strcmp(argv[i], "--balloons") == 0 && i + 1 < argc)
+            flotillaSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+            captureAtStart = true;
+        }
+    }
+
+    if (serverPort > 0)
+        return runServer(serverPort);
+    if (connectAddress) {
+        NetAddress address;
+        if (!netSocket.open(0) || !parseNetAddress(connectAddress, address)) {
+            printf("could not connect to %s\n", connectAddress);
+            return EXIT_FAILURE;
+        }
+        netClient = new ParkClient(NetSocket::send, &netSocket, address);
+        // replays of a shared park would need the server's packets too
+        recordPath = NULL;
+        replayPath = NULL;
+    }
+
+    if (replayPath) {
+        if (!inputLog.load(replayPath)) {
+            printf("could not read recording %s\n", replayPath);
+            return EXIT_FAILURE;
+        }
+        recordPath = NULL;
+        soundEnabled = !replayFast;
+    }
+    if (recordPath) {
+        // an hour of ticks and frames, so recording does not grow the log mid-game
+        inputLog.events.reserve(3600 * 150);
+        atexit(saveRecording);
+    }
+    atexit(printFrameCounters);
+    if (scaleLogPath) {
+        scaleLog = fopen(scaleLogPath, "w");
+        if (scaleLog)
+            fprintf(scaleLog, "# frame ms scale\n");
+        else
+            printf("could not write scale log %s\n", scaleLogPath);
+    }
+
+    jobs.start(JobSystem::defaultThreadCount());
+    terrain = new TerrainStreamer(chunkBudget, terrainPath);
+    if (!terrainPath)
+        printf("no terrain tiles (--terrain), generating chunks as they come into view\n");
+    forest.plant(forestSize, PLATEAU_SIZE + PLATEAU_RISE, FOREST_RADIUS, 1, proceduralHeight);
+    layOutPark(parkNavigation);
+    setupRideInstances();
+    if (visitorCount > 0)
+        visitors.spawn(parkNavigation, visitorCount, DEST_TICKET_STAND, DEST_EXIT, VISITOR_RIDES, 1);
+
     glutInit(&argc, argv);
 
     glutInitWindowSize(screenWidth, screenHeight);
     glutInitWindowPosition(50, 50);
 
+    // before the window is created, or it gets GLUT's default format;
+    // multisampling is done offscreen so it can be switched at runtime
+    glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB | GLUT_DEPTH);
     glutCreateWindow("Dream Park");
-    //glEnable(GL_MULTISAMPLE);
+    loadGLExtensions();
+    createMeshes();
+    setupViews();
+    if (!aaAvailable(aaMode)) {
+        printf("anti-aliasing %s is not supported by this driver\n", aaModeNames[aaMode]);
+        aaMode = AA_OFF;
+    }
+
+    atexit(stopCapture);
+    if (captureAtStart)
+        toggleCapture();
 
-    if (!win && !lose)
-        PlaySound(TEXT("backGround"), NULL, SND_ASYNC);
+    playSound("backGround");
 
-    glutDisplayFunc(Display);
-    glutKeyboardFunc(Keyboard);
-    glutSpecialFunc(Special);
+    glutReshapeFunc(Reshape);
+    if (replayPath) {
+        glutDisplayFunc(replayExpose);
+        glutIdleFunc(replayIdle);
+    }
+    else {
+        glutDisplayFunc(Display);
+        glutKeyboardFunc(Keyboard);
+        glutSpecialFunc(Special);
+    }
 
-    glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB | GLUT_DEPTH | GLUT_MULTISAMPLE);
     glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
 
     glEnable(GL_DEPTH_TEST);
@@ -1179,8 +2956,10 @@ int main(int argc, char** argv) {
 
     glShadeModel(GL_SMOOTH);
 
-    glutTimerFunc(0, anim, 0);
-    glutTimerFunc(1000, update, 0);
+    if (replayPath)
+        replayStartTime = glutGet(GLUT_ELAPSED_TIME);
+    else
+        glutTimerFunc(0, anim, 0);
 
     glutMainLoop();
     return 0;
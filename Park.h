@@ -0,0 +1,238 @@
+#ifndef PARK_H
+#define PARK_H
+
+#include <math.h>
+#include "ParkMath.h"
+
+// Park state and rules, free of GLUT and windows.h so it can be built and
+// benchmarked on its own (see ParkBench.cpp).
+
+enum Easing {
+    EASE_LINEAR,    // constant speed, turning sharply at either end
+    EASE_SINE       // slowing into either end, like a pendulum
+};
+
+// 0 at x = 0, 1 at a quarter, -1 at three quarters, period 1
+inline double oscillatorWave(double x, Easing easing) {
+    if (easing == EASE_SINE)
+        return sin(6.283185307179586 * x);
+    double f = x + 0.25 - floor(x + 0.25);
+    return 1 - 4 * fabs(f - 0.5);
+}
+
+// a value going back and forth between center - amplitude and center +
+// amplitude as a function of the tick count alone, so it can be evaluated
+// at any tick without stepping through the ones before: at phase it passes
+// the center rising, a quarter period later it is at the top
+struct Oscillator {
+    float center, amplitude;
+    float period, phase;    // ticks
+    Easing easing;
+
+    float at(double ticks) const {
+        return (float)(center + amplitude * oscillatorWave(fmod(ticks - phase, (double)period) / period, easing));
+    }
+};
+
+// a value going from low to high and back at a mean speed a tick, rising
+// through start at tick 0
+inline Oscillator pingPong(float low, float high, float speed, float start, Easing easing = EASE_LINEAR) {
+    Oscillator o;
+    o.center = (low + high) / 2;
+    o.amplitude = (high - low) / 2;
+    o.easing = easing;
+    o.period = 2 * (high - low) / speed;
+    double s = (start - o.center) / o.amplitude;
+    double x = easing == EASE_SINE ? asin(s) / 6.283185307179586 : s / 4;
+    o.phase = (float)(-x * o.period);
+    return o;
+}
+
+// Every ride's pose is a function of the tick count: evaluate(ticks) sets
+// it for any tick, in any order, at the same cost.
+
+class Fence {
+public:
+    float r, g, b;
+    Oscillator red;     // green and blue follow it
+
+    Fence() : r(0.5f), g(0.3f), b(0.0f), red(pingPong(0.2f, 0.8f, 0.03f, 0.5f)) {}
+
+    void evaluate(double ticks) {
+        r = red.at(ticks);
+        g = 0.3f + (r - 0.5f) * 0.6f;
+        b = 0.0f - (r - 0.5f) * 0.2f;
+    }
+};
+
+class Player {
+public:
+    float posX, posY, posZ;
+    float rotY;
+
+    Player() : posX(0.0f), posY(0.0f), posZ(0.0f), rotY(0.0f) {}
+
+    void moveX(float dx) {
+        posX += dx;
+    }
+
+    void moveZ(float dz) {
+        posZ += dz;
+    }
+
+    void rotateY(float angle) {
+        rotY = angle;
+    }
+};
+
+class FerrisWheel {
+public:
+    float rotationAngle;
+    float degreesPerTick;
+
+    FerrisWheel() : rotationAngle(0.0f), degreesPerTick(3.0f) {}
+
+    float turnTicks() const {
+        return 360.0f / degreesPerTick;
+    }
+
+    void evaluate(double ticks) {
+        rotationAngle = (float)(degreesPerTick * fmod(ticks, (double)turnTicks()));
+    }
+};
+
+class HotAirBalloon {
+public:
+    float translationY;
+    Oscillator bob;
+
+    HotAirBalloon() : translationY(0.0f), bob(pingPong(-0.03f, 0.03f, 0.01f, 0.0f)) {}
+
+    void evaluate(double ticks) {
+        translationY = bob.at(ticks);
+    }
+};
+
+class Swing {
+public:
+    float rotationAngle;
+    Oscillator swinging;
+
+    Swing() : rotationAngle(0.0f), swinging(pingPong(-20.0f, 20.0f, 3.0f, 0.0f, EASE_SINE)) {}
+
+    void evaluate(double ticks) {
+        rotationAngle = swinging.at(ticks);
+    }
+};
+
+class Tree {
+public:
+    float scale;
+    Oscillator breathing;
+
+    Tree() : scale(1.0f), breathing(pingPong(0.8f, 1.2f, 0.02f, 1.0f)) {}
+
+    void evaluate(double ticks) {
+        scale = breathing.at(ticks);
+    }
+};
+
+class TicketStand {
+public:
+    float scale;
+    Oscillator pulse;
+
+    TicketStand() : scale(1.0f), pulse(pingPong(1.0f, 1.2f, 0.01f, 1.0f)) {}
+
+    void evaluate(double ticks) {
+        scale = pulse.at(ticks);
+    }
+};
+
+class Ticket {
+public:
+    float posX, posY, posZ;
+    bool isHit;
+    float translationX;
+    Oscillator slide;
+
+    Ticket() : posX(0.3f), posY(0.0f), posZ(0.3f), isHit(false), translationX(0.0f), slide(pingPong(-0.03f, 0.03f, 0.01f, 0.0f)) {}
+
+    void evaluate(double ticks) {
+        translationX = slide.at(ticks);
+    }
+};
+
+enum PlayerMove {
+    MOVE_LEFT,      // -x
+    MOVE_RIGHT,     // +x
+    MOVE_FORWARD,   // +z
+    MOVE_BACK       // -z
+};
+
+// where the player may walk, in the player's own units
+struct PlayerBounds {
+    double minX, maxX;
+    double minZ, maxZ;
+};
+
+const PlayerBounds FENCED_PARK = { -0.45, 0.45, -0.5, 0.45 };
+
+// one step inside the bounds, turning to face the way it went; false when
+// the fence (or the edge of the map) is in the way
+inline bool movePlayer(Player& player, PlayerMove move, const PlayerBounds& bounds = FENCED_PARK) {
+    float moveDistance = 0.03f;
+    switch (move) {
+    case MOVE_LEFT:
+        if (player.posX - moveDistance >= bounds.minX) {
+            player.moveX(-moveDistance);
+            player.rotateY(270);
+            return true;
+        }
+        break;
+    case MOVE_RIGHT:
+        if (player.posX + moveDistance <= bounds.maxX) {
+            player.moveX(moveDistance);
+            player.rotateY(90);
+            return true;
+        }
+        break;
+    case MOVE_FORWARD:
+        if (player.posZ + moveDistance <= bounds.maxZ) {
+            player.moveZ(moveDistance);
+            player.rotateY(0);
+            return true;
+        }
+        break;
+    case MOVE_BACK:
+        if (player.posZ - moveDistance >= bounds.minZ) {
+            player.moveZ(-moveDistance);
+            player.rotateY(180);
+            return true;
+        }
+        break;
+    }
+    return false;
+}
+
+inline bool checkCollision(const Player& player, const Ticket& ticket) {
+    float collisionDistanceX = 0.09f;
+    float collisionDistanceZ = 0.09f;
+
+    return (fabs(player.posX - ticket.posX) < collisionDistanceX &&
+        fabs(player.posZ - ticket.posZ) < collisionDistanceZ);
+}
+
+// cubic Bezier through four control points, used for the player's mouth
+inline Vector3f bezierPoint(const float ctrlPoints[4][3], float t) {
+    float a = (1 - t) * (1 - t) * (1 - t);
+    float b = 3 * (1 - t) * (1 - t) * t;
+    float c = 3 * (1 - t) * t * t;
+    float d = t * t * t;
+    return Vector3f(
+        a * ctrlPoints[0][0] + b * ctrlPoints[1][0] + c * ctrlPoints[2][0] + d * ctrlPoints[3][0],
+        a * ctrlPoints[0][1] + b * ctrlPoints[1][1] + c * ctrlPoints[2][1] + d * ctrlPoints[3][1],
+        a * ctrlPoints[0][2] + b * ctrlPoints[1][2] + c * ctrlPoints[2][2] + d * ctrlPoints[3][2]);
+}
+
+#endif
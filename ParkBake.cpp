@@ -0,0 +1,154 @@
+// Asset baker: writes the pack the game maps at startup (see AssetPack.h).
+//
+//     park_bake <out.pack> [sound.wav ...]
+//     park_bake --terrain <directory>
+//
+// Every mesh in ParkMeshes.h is tessellated here instead of in the game, and
+// each sound is stored as a plain PCM WAV image named sound/<file name>
+// without the extension, so PlaySound can play it from memory. With
+// --terrain it writes the terrain tiles the game streams instead (see
+// Terrain.h). CMake runs it on every build that changes one of its inputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ParkMeshes.h"
+#include "AssetPack.h"
+#include "Terrain.h"
+
+bool readFile(const char* path, std::vector<unsigned char>& bytes) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    bytes.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(&bytes[0], 1, size, f) == (size_t)size;
+    fclose(f);
+    return ok;
+}
+
+unsigned readU32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+void writeU32(std::vector<unsigned char>& out, unsigned value) {
+    for (int i = 0; i < 4; i++)
+        out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+void writeTag(std::vector<unsigned char>& out, const char* tag) {
+    for (int i = 0; i < 4; i++)
+        out.push_back((unsigned char)tag[i]);
+}
+
+// keeps only the fmt and data chunks, so the player has nothing to skip;
+// false unless the file is uncompressed PCM
+bool bakeSound(const std::vector<unsigned char>& wav, std::vector<unsigned char>& out) {
+    if (wav.size() < 12 || memcmp(&wav[0], "RIFF", 4) != 0 || memcmp(&wav[8], "WAVE", 4) != 0)
+        return false;
+    const unsigned char* format = NULL;
+    const unsigned char* data = NULL;
+    unsigned formatSize = 0, dataSize = 0;
+    for (size_t i = 12; i + 8 <= wav.size();) {
+        unsigned size = readU32(&wav[i + 4]);
+        if (size > wav.size() - i - 8)
+            return false;
+        if (memcmp(&wav[i], "fmt ", 4) == 0) {
+            format = &wav[i + 8];
+            formatSize = size;
+        }
+        else if (memcmp(&wav[i], "data", 4) == 0) {
+            data = &wav[i + 8];
+            dataSize = size;
+        }
+        i += 8 + size + (size & 1);
+    }
+    // WAVE_FORMAT_PCM
+    if (!format || !data || formatSize < 16 || (format[0] | (format[1] << 8)) != 1)
+        return false;
+
+    out.clear();
+    writeTag(out, "RIFF");
+    writeU32(out, 4 + 8 + 16 + 8 + dataSize);
+    writeTag(out, "WAVE");
+    writeTag(out, "fmt ");
+    writeU32(out, 16);
+    out.insert(out.end(), format, format + 16);
+    writeTag(out, "data");
+    writeU32(out, dataSize);
+    out.insert(out.end(), data, data + dataSize);
+    return true;
+}
+
+// "dir/anim.wav" -> "sound/anim"
+std::string soundName(const char* path) {
+    const char* name = path;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    }
+    std::string s = name;
+    size_t dot = s.rfind('.');
+    if (dot != std::string::npos)
+        s.erase(dot);
+    return "sound/" + s;
+}
+
+int bakeTerrain(const char* directory) {
+    int tiles = (TERRAIN_CHUNKS + TILE_CHUNKS - 1) / TILE_CHUNKS;
+    for (int tz = 0; tz < tiles; tz++) {
+        for (int tx = 0; tx < tiles; tx++) {
+            if (!bakeTerrainTile(directory, tx, tz)) {
+                printf("could not write terrain tile %d,%d into %s\n", tx, tz, directory);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("baked %d terrain tiles of %dx%d chunks into %s\n", tiles * tiles, TILE_CHUNKS, TILE_CHUNKS, directory);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: park_bake <out.pack> [sound.wav ...]\n       park_bake --terrain <directory>\n");
+        return EXIT_FAILURE;
+    }
+    if (strcmp(argv[1], "--terrain") == 0)
+        return argc == 3 ? bakeTerrain(argv[2]) : EXIT_FAILURE;
+
+    AssetPackWriter pack;
+    MeshData mesh;
+    std::vector<unsigned char> bytes;
+    size_t vertices = 0;
+    for (int id = 0; id < MESH_COUNT; id++) {
+        generateMesh(id, mesh);
+        writeMesh(mesh, bytes);
+        pack.add(meshNames[id], &bytes[0], bytes.size());
+        vertices += mesh.vertices.size();
+    }
+
+    for (int i = 2; i < argc; i++) {
+        std::vector<unsigned char> wav;
+        if (!readFile(argv[i], wav) || !bakeSound(wav, bytes)) {
+            printf("%s is not a PCM WAV file\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        std::string name = soundName(argv[i]);
+        if (name.size() >= ASSET_NAME_LENGTH) {
+            printf("sound name %s is too long\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+        pack.add(name.c_str(), &bytes[0], bytes.size());
+    }
+
+    if (!pack.save(argv[1])) {
+        printf("could not write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    printf("baked %d meshes (%u vertices) and %d sounds into %s\n", MESH_COUNT, (unsigned)vertices, argc - 2, argv[1]);
+    return 0;
+}
@@ -0,0 +1,958 @@
+// Microbenchmarks for the park logic. Builds on any platform (see CMakeLists.txt);
+// prints one JSON object per benchmark, in a fixed order, so runs from two
+// commits can be diffed directly. The checksum of each benchmark only changes
+// when the code under test computes something different.
+//
+//   park_bench [name-filter]
+//   park_bench --check-allocations
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "Park.h"
+#include "Camera.h"
+#include "JobSystem.h"
+#include "GameState.h"
+#include "ParticleSystem.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "DrawCommands.h"
+#include "ParkNet.h"
+#include "ParkMeshes.h"
+#include "AssetPack.h"
+#include "Scheduler.h"
+#include "Terrain.h"
+#include "Impostors.h"
+#include "ParkSim.h"
+#include "Navigation.h"
+#include "ClusteredLights.h"
+#include "RideAnimation.h"
+
+const int REPETITIONS = 5;
+
+const char* filter = NULL;
+bool firstResult = true;
+JobSystem jobs;
+ParticleSystem particles;
+ParticleVertex particleVertices[PARTICLE_CAPACITY];
+CommandList commandLists[8];
+const DrawCommand* mergedCommands[8 * COMMAND_LIST_CAPACITY];
+LightClusters lightClusters;
+PointLight parkLights[MAX_CLUSTERED_LIGHTS];
+
+// itemsPerOp > 0 also reports throughput, e.g. particles per millisecond
+template <class Body>
+void runBenchmark(const char* name, long iterations, Body body, long itemsPerOp = 0) {
+    if (filter && !strstr(name, filter))
+        return;
+
+    double best = 1e300;
+    double checksum = 0;
+    for (int r = 0; r < REPETITIONS; r++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        checksum = body(iterations);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        if (ns < best)
+            best = ns;
+    }
+
+    printf("%s\n    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.3f, ",
+        firstResult ? "" : ",", name, iterations, best / iterations);
+    if (itemsPerOp > 0)
+        printf("\"items_per_ms\": %.0f, ", itemsPerOp * iterations / (best / 1e6));
+    printf("\"checksum\": %.9g}", checksum);
+    firstResult = false;
+}
+
+// a measured quantity that is not a time per operation, e.g. bandwidth
+void reportMetric(const char* name, const char* unit, double value) {
+    if (filter && !strstr(name, filter))
+        return;
+    printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.3f}", firstResult ? "" : ",", name, unit, value);
+    firstResult = false;
+}
+
+// waits 1 to 64 ticks at a time, forever
+Sequence benchSequence(Scheduler& scheduler, int seed, double& fired) {
+    unsigned state = seed * 2654435761u + 1;
+    for (;;) {
+        state = state * 1664525u + 1013904223u;
+        co_await scheduler.wait(1 + (state >> 26));
+        fired += 1;
+    }
+}
+
+// the full pool, live for longer than any benchmark runs
+void fillParticlePool() {
+    particles.clear();
+    while (particles.size() < PARTICLE_CAPACITY)
+        particles.burst(Vector3f(0, 0.9f, -0.42f), 8000, 0.45f, 1000, 255, 200, 80);
+}
+
+double sum(const Vector3f& v) {
+    return v.x + v.y + v.z;
+}
+
+template <class Ride>
+double animateBenchmark(long iterations, double (*state)(const Ride&)) {
+    Ride ride;
+    double acc = 0;
+    for (long i = 0; i < iterations; i++) {
+        ride.evaluate((double)i);
+        acc += state(ride);
+    }
+    return acc;
+}
+
+// largest difference over ticks ticks between a ride's curve and the
+// per-tick rule it replaced: step by speed each tick and turn back at the
+// bounds, folding the step back inside rather than overshooting
+template <class Ride>
+double steppedError(float Ride::* value, float low, float high, float speed, float start, long ticks) {
+    Ride ride;
+    double stepped = start, step = speed, worst = 0;
+    for (long t = 0; t < ticks; t++) {
+        ride.evaluate((double)t);
+        worst = std::max(worst, fabs(ride.*value - stepped));
+        stepped += step;
+        if (stepped > high || stepped < low) {
+            stepped = 2 * (step > 0 ? high : low) - stepped;
+            step = -step;
+        }
+    }
+    return worst;
+}
+
+// one simulated frame of a 10k-attraction park as a small DAG:
+// animate -> collision, animate -> culling
+struct BenchPark {
+    std::vector<FerrisWheel> wheels;
+    std::vector<HotAirBalloon> balloons;
+    std::vector<Swing> swings;
+    std::vector<Tree> trees;
+    std::vector<Ticket> tickets;
+    std::vector<Vector3f> positions;
+    std::vector<char> hits;
+    double ticks;
+    std::vector<char> visible;
+    Player player;
+    Vector3f eye, view;
+    float cosHalfFov;
+};
+
+void benchAnimate(void* data, int begin, int end) {
+    BenchPark* park = (BenchPark*)data;
+    for (int i = begin; i < end; i++) {
+        int j = i / 5;
+        switch (i % 5) {
+        case 0: park->wheels[j].evaluate(park->ticks); break;
+        case 1: park->balloons[j].evaluate(park->ticks); break;
+        case 2: park->swings[j].evaluate(park->ticks); break;
+        case 3: park->trees[j].evaluate(park->ticks); break;
+        case 4: park->tickets[j].evaluate(park->ticks); break;
+        }
+    }
+}
+
+void benchCollide(void* data, int begin, int end) {
+    BenchPark* park = (BenchPark*)data;
+    for (int i = begin; i < end; i++)
+        park->hits[i] = checkCollision(park->player, park->tickets[i]);
+}
+
+void benchCull(void* data, int begin, int end) {
+    BenchPark* park = (BenchPark*)data;
+    for (int i = begin; i < end; i++) {
+        Vector3f d = park->positions[i] - park->eye;
+        float along = d.dot(park->view);
+        float dist = sqrt(d.dot(d));
+        park->visible[i] = along > 0 && along >= dist * park->cosHalfFov;
+    }
+}
+
+void setupBenchPark(BenchPark& park, int attractions) {
+    park.wheels.resize(attractions / 5);
+    park.balloons.resize(attractions / 5);
+    park.swings.resize(attractions / 5);
+    park.trees.resize(attractions / 5);
+    park.tickets.resize(attractions / 5);
+    park.hits.resize(park.tickets.size());
+    park.visible.resize(attractions);
+    park.ticks = 0;
+    for (int i = 0; i < attractions; i++)
+        park.positions.push_back(Vector3f((i % 100) * 0.1f - 5.0f, 0.0f, (i / 100) * 0.1f - 5.0f));
+    for (size_t i = 0; i < park.tickets.size(); i++) {
+        park.tickets[i].posX = park.positions[i * 5 + 4].x;
+        park.tickets[i].posZ = park.positions[i * 5 + 4].z;
+    }
+    Camera camera;
+    park.eye = camera.position();
+    park.view = camera.forward();
+    park.cosHalfFov = cos(DEG2RAD(45.0));
+}
+
+// a server and 64 clients exchanging packets in memory, one mailbox per
+// client; every client moves a few times a second
+const int BENCH_INBOX = 4;
+
+void benchSendToServer(void* context, const NetAddress& to, const unsigned char* data, int size);
+void benchSendToClient(void* context, const NetAddress& to, const unsigned char* data, int size);
+
+struct BenchNet {
+    struct Link {
+        BenchNet* net;
+        int id;
+    };
+    struct Mailbox {
+        unsigned char packets[BENCH_INBOX][MAX_PACKET_SIZE];
+        int sizes[BENCH_INBOX];
+        int count;
+    };
+
+    ParkServer server;
+    ParkClient* clients[MAX_NET_PLAYERS];
+    Link links[MAX_NET_PLAYERS];
+    Mailbox toClient[MAX_NET_PLAYERS];
+    Mailbox toServer;
+    int from;       // client whose packets are in toServer
+    unsigned long ticks;
+
+    BenchNet() : server(benchSendToClient, this), from(0), ticks(0) {
+        NetAddress address = { 0x7F000001, 40555 };
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            links[i].net = this;
+            links[i].id = i;
+            clients[i] = new ParkClient(benchSendToServer, &links[i], address);
+            toClient[i].count = 0;
+        }
+        toServer.count = 0;
+    }
+
+    ~BenchNet() {
+        for (int i = 0; i < MAX_NET_PLAYERS; i++)
+            delete clients[i];
+    }
+
+    static void post(Mailbox& box, const unsigned char* data, int size) {
+        if (box.count == BENCH_INBOX)
+            return;     // dropped, as a full socket buffer would
+        memcpy(box.packets[box.count], data, size);
+        box.sizes[box.count++] = size;
+    }
+
+    void tick() {
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            ParkClient& c = *clients[i];
+            if (c.connected() && (ticks + i) % 10 == 0)
+                c.move((PlayerMove)((ticks / 10 + i) % 4));
+            from = i;
+            c.update();
+            NetAddress address = { 0x0A000000u + i, 50000 };
+            for (int k = 0; k < toServer.count; k++)
+                server.receive(address, toServer.packets[k], toServer.sizes[k]);
+            toServer.count = 0;
+        }
+        server.tick();
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            for (int k = 0; k < toClient[i].count; k++)
+                clients[i]->receive(toClient[i].packets[k], toClient[i].sizes[k]);
+            toClient[i].count = 0;
+        }
+        ticks++;
+    }
+};
+
+void benchSendToServer(void* context, const NetAddress&, const unsigned char* data, int size) {
+    BenchNet::Link* link = (BenchNet::Link*)context;
+    BenchNet::post(link->net->toServer, data, size);
+}
+
+void benchSendToClient(void* context, const NetAddress& to, const unsigned char* data, int size) {
+    BenchNet* net = (BenchNet*)context;
+    BenchNet::post(net->toClient[to.host - 0x0A000000u], data, size);
+}
+
+// window depths of the park floor as the camera sees it, 1 where the sky
+// shows, for the lights-per-fragment metric without a GPU
+void groundDepths(Camera& camera, int width, int height, std::vector<float>& depth) {
+    const float* p = camera.projection();
+    Vector3f eye = camera.position(), right = camera.right(), up = camera.up(), forward = camera.forward();
+    depth.assign(width * height, 1.0f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // the ray through the pixel, one unit of view depth long
+            float rx = ((x + 0.5f) / width * 2 - 1) / p[0], ry = ((y + 0.5f) / height * 2 - 1) / p[5];
+            Vector3f ray = forward + right * rx + up * ry;
+            if (ray.y >= 0)
+                continue;
+            float viewDepth = (GROUND_LEVEL - eye.y) / ray.y;
+            float z = (-p[10] * viewDepth + p[14]) / viewDepth;
+            depth[y * width + x] = (z + 1) / 2;
+        }
+    }
+}
+
+// Runs the per-frame game logic -- the job graph over a bench park, the
+// rules, a camera transition, fireworks drawn through a frame arena, a
+// 64-player network tick -- and fails if any frame after the warm-up
+// allocates. CMake runs this after every build of park_bench.
+int checkAllocations() {
+    const int warmup = 120;
+    const int frames = 600;
+    const int attractions = 1000;
+    BenchPark park;
+    setupBenchPark(park, attractions);
+    jobs.start(JobSystem::defaultThreadCount());
+    GameState game;
+    Camera camera;
+    FrameArena arena(4 << 20);
+    BenchNet* net = new BenchNet;
+    TerrainStreamer terrain(256, NULL);
+    TerrainBatch* batches;
+    Forest forest;
+    forest.plant(50000, 3, 45, 1, proceduralHeight);
+    ImpostorVertex* quads;
+    ImpostorBatch* cells;
+    const Impostor* nearTrees[128];
+    int nearCount;
+    Navigation nav(-PARK_NAV_EXTENT, -PARK_NAV_EXTENT, PARK_NAV_EXTENT, PARK_NAV_EXTENT);
+    layOutPark(nav);
+    Crowd crowd;
+    crowd.spawn(nav, 1000, DEST_TICKET_STAND, DEST_EXIT, 3, 1);
+    unsigned long lightOverflows = lightClusters.overflows;
+
+    unsigned long allocations = 0;
+    int allocatingFrames = 0;
+    for (int f = 0; f < warmup + frames; f++) {
+        AllocationScope frame;
+        arena.reset();
+
+        park.ticks++;
+        Job* animate = jobs.createJob(benchAnimate, &park, 0, attractions, 64);
+        Job* collide = jobs.createJob(benchCollide, &park, 0, (int)park.tickets.size(), 64);
+        Job* cull = jobs.createJob(benchCull, &park, 0, attractions, 64);
+        jobs.addDependency(collide, animate);
+        jobs.addDependency(cull, animate);
+        jobs.run(collide);
+        jobs.run(cull);
+        jobs.run(animate);
+        jobs.wait(collide);
+        jobs.wait(cull);
+
+        if (f == warmup + 60)
+            game.post(GAME_EVENT_TICKET_COLLECTED);
+        game.tick();
+        while (game.nextSound() != SOUND_NONE) {}
+
+        if (f % 90 == 0)
+            camera.transitionTo(Vector3f(0.0f, 1.5f - (f % 180) * 0.005f, 1.0f), Vector3f(0, 0, 0), 0.6f);
+        camera.update(1.0f / 60);
+        camera.viewProjection();
+
+        if (f % 40 == 0)
+            particles.burst(Vector3f(0, 0.9f, -0.42f), 8000, 0.45f, 1.8f, 255, 200, 80);
+        particles.update(1.0f / 60);
+        ParticleVertex* vertices = arena.allocateArray<ParticleVertex>(particles.size());
+        if (vertices)
+            particles.fillVertices(vertices);
+
+        net->tick();
+
+        // flying across the map, so chunks keep streaming in and out
+        Vector3f eye(-50 + f * 0.1f, 3, 10);
+        terrain.update(eye.x, eye.z);
+        terrain.prepare(eye, arena, batches);
+        forest.prepare(eye, 14, arena, quads, cells, nearTrees, 128, nearCount);
+
+        // a barrier across the entrance comes and goes
+        if (f % 60 == 0) {
+            nav.setBlocked(-0.2f, 0.6f, 0.2f, 0.62f, f % 120 == 0);
+            nav.update();
+        }
+        crowd.step(nav, 0, (int)crowd.agents.size(), 0.004f);
+
+        // the night's lights, the wheel turning, binned for the camera
+        int lights = parkNightLights(parkLights, MAX_CLUSTERED_LIGHTS, f * 0.5f, 0.01f);
+        lightClusters.bin(parkLights, lights, camera.view(), camera.projection());
+
+        if (f >= warmup && frame.count() > 0) {
+            allocations += frame.count();
+            allocatingFrames++;
+        }
+    }
+    jobs.stop();
+    delete net;
+
+    printf("%d of %d steady-state frames allocated (%lu allocations), frame arena peak %u bytes\n",
+        allocatingFrames, frames, allocations, (unsigned)arena.peak);
+    if (lightClusters.overflows != lightOverflows)
+        printf("%lu light-cluster pairs did not fit\n", lightClusters.overflows - lightOverflows);
+    return allocatingFrames == 0 && arena.overflows == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--check-allocations") == 0)
+        return checkAllocations();
+    if (argc > 1)
+        filter = argv[1];
+
+    printf("{\n  \"benchmarks\": [");
+
+    runBenchmark("vector_unit", 10000000, [](long n) {
+        Vector3f v(0.3f, 0.4f, 1.2f);
+        double acc = 0;
+        for (long i = 0; i < n; i++) {
+            v.x += 1e-7f;
+            acc += v.unit().x;
+        }
+        return acc;
+    });
+
+    runBenchmark("vector_cross", 10000000, [](long n) {
+        Vector3f a(0.3f, 0.4f, 1.2f), b(-0.7f, 0.1f, 0.5f);
+        double acc = 0;
+        for (long i = 0; i < n; i++) {
+            a.x += 1e-7f;
+            acc += a.cross(b).y;
+        }
+        return acc;
+    });
+
+    runBenchmark("camera_move_x", 1000000, [](long n) {
+        Camera c;
+        for (long i = 0; i < n; i++)
+            c.moveX(i & 1 ? 0.03f : -0.03f);
+        return sum(c.position()) + sum(c.center());
+    });
+
+    runBenchmark("camera_move_z", 1000000, [](long n) {
+        Camera c;
+        for (long i = 0; i < n; i++)
+            c.moveZ(i & 1 ? 0.03f : -0.03f);
+        return sum(c.position()) + sum(c.center());
+    });
+
+    runBenchmark("camera_rotate_x", 1000000, [](long n) {
+        Camera c;
+        for (long i = 0; i < n; i++)
+            c.rotateX(i & 1 ? 1.0f : -1.0f);
+        return sum(c.center()) + sum(c.up());
+    });
+
+    runBenchmark("camera_rotate_y", 1000000, [](long n) {
+        Camera c;
+        for (long i = 0; i < n; i++)
+            c.rotateY(i & 1 ? 1.0f : -1.0f);
+        return sum(c.center()) + sum(c.up());
+    });
+
+    // view matrix rebuilt every call, as after a key press
+    runBenchmark("camera_look", 1000000, [](long n) {
+        Camera c;
+        double acc = 0;
+        for (long i = 0; i < n; i++) {
+            c.moveX(i & 1 ? 1e-4f : -1e-4f);
+            acc += c.view()[12];
+        }
+        return acc;
+    });
+
+    // view-projection and frustum when nothing moved, as on most frames
+    runBenchmark("camera_view_projection_cached", 10000000, [](long n) {
+        Camera c;
+        double acc = 0;
+        for (long i = 0; i < n; i++)
+            acc += c.viewProjection()[(int)(i & 15)] + c.frustum()[i % 6].d;
+        return acc;
+    });
+
+    runBenchmark("camera_preset_transition", 100000, [](long n) {
+        Camera c;
+        for (long i = 0; i < n; i++) {
+            if (i % 36 == 0) {
+                if ((i / 36) & 1)
+                    c.transitionTo(Vector3f(0.0160754f, 1.27918f, -0.048015f), Vector3f(0.016228f, 0.016228f, 0.016228f), 0.6f);
+                else
+                    c.transitionTo(Vector3f(-0.992256f, 0.227585f, 0.0032941f), Vector3f(0.00435436f, 0.00435436f, 0.00435436f), 0.6f);
+            }
+            c.update(1.0f / 60);
+            c.viewProjection();
+        }
+        return sum(c.position()) + sum(c.up());
+    });
+
+    runBenchmark("animate_fence", 10000000, [](long n) {
+        return animateBenchmark<Fence>(n, [](const Fence& f) { return (double)f.r + f.g + f.b; });
+    });
+
+    runBenchmark("animate_ferris_wheel", 10000000, [](long n) {
+        return animateBenchmark<FerrisWheel>(n, [](const FerrisWheel& w) { return (double)w.rotationAngle; });
+    });
+
+    runBenchmark("animate_hot_air_balloon", 10000000, [](long n) {
+        return animateBenchmark<HotAirBalloon>(n, [](const HotAirBalloon& b) { return (double)b.translationY; });
+    });
+
+    runBenchmark("animate_swing", 10000000, [](long n) {
+        return animateBenchmark<Swing>(n, [](const Swing& s) { return (double)s.rotationAngle; });
+    });
+
+    runBenchmark("animate_tree", 10000000, [](long n) {
+        return animateBenchmark<Tree>(n, [](const Tree& t) { return (double)t.scale; });
+    });
+
+    runBenchmark("animate_ticket_stand", 10000000, [](long n) {
+        return animateBenchmark<TicketStand>(n, [](const TicketStand& t) { return (double)t.scale; });
+    });
+
+    runBenchmark("animate_ticket", 10000000, [](long n) {
+        return animateBenchmark<Ticket>(n, [](const Ticket& t) { return (double)t.translationX; });
+    });
+
+    runBenchmark("check_collision", 10000000, [](long n) {
+        Player p;
+        Ticket t;
+        double hits = 0;
+        for (long i = 0; i < n; i++) {
+            p.posX = (i % 64) * 0.01f;
+            p.posZ = (i % 48) * 0.01f;
+            hits += checkCollision(p, t);
+        }
+        return hits;
+    });
+
+    // a whole 120 s round of simulation ticks, the ticket is picked up half
+    // way through and the game paused and resumed every ten seconds
+    runBenchmark("game_state_round", 1000, [](long n) {
+        double acc = 0;
+        for (long i = 0; i < n; i++) {
+            GameState g;
+            for (int t = 0; !g.countdownOver; t++) {
+                if (t == 60 * TICKS_PER_SECOND && g.canCollectTicket())
+                    g.post(GAME_EVENT_TICKET_COLLECTED);
+                if (t % (10 * TICKS_PER_SECOND) == 0)
+                    g.post(GAME_EVENT_TOGGLE_PAUSE);
+                g.tick();
+                while (g.nextSound() != SOUND_NONE)
+                    acc += 1;
+            }
+            acc += (int)g.status;
+        }
+        return acc;
+    });
+
+    // one tick of 10k timed sequences, about 300 of them resuming per tick
+    {
+        const int sequences = 10000;
+        Scheduler* scheduler = new Scheduler(sequences);
+        double fired = 0;
+        for (int i = 0; i < sequences; i++)
+            scheduler->spawn(benchSequence(*scheduler, i, fired));
+        for (int t = 0; t < 64; t++)
+            scheduler->advance();
+        runBenchmark("scheduler_tick_10k_sequences", 6000, [&](long n) {
+            for (long t = 0; t < n; t++)
+                scheduler->advance();
+            return fired;
+        });
+        delete scheduler;
+    }
+
+    // the mouth strip in drawPlayer: t = 0, 0.01, ..., 1
+    runBenchmark("bezier_mouth", 100000, [](long n) {
+        const float ctrlPoints[4][3] = {
+            {0.03f, -0.05f, 0.05f},
+            {0.01f, -0.065f, 0.05f},
+            {-0.01f, -0.065f, 0.05f},
+            {-0.03f, -0.05f, 0.05f}
+        };
+        double acc = 0;
+        for (long i = 0; i < n; i++) {
+            for (float t = 0.0; t <= 1.0; t += 0.01) {
+                acc += bezierPoint(ctrlPoints, t).y;
+            }
+        }
+        return acc;
+    });
+
+    // the full 100k pool, emitted as fireworks shells
+    runBenchmark("particles_emit_100k", 20, [](long n) {
+        double acc = 0;
+        for (long i = 0; i < n; i++) {
+            fillParticlePool();
+            acc += particles.size();
+        }
+        return acc;
+    }, PARTICLE_CAPACITY);
+
+    // one 60 Hz step of 100k live particles; the lifetime is long enough that
+    // none expire during the run
+    fillParticlePool();
+    runBenchmark("particles_update_100k", 200, [](long n) {
+        for (long i = 0; i < n; i++)
+            particles.update(1.0f / 60);
+        return (double)particles.size();
+    }, PARTICLE_CAPACITY);
+
+    fillParticlePool();
+    runBenchmark("particles_fill_vertices_100k", 200, [](long n) {
+        double acc = 0;
+        for (long i = 0; i < n; i++)
+            acc += particles.fillVertices(particleVertices);
+        return acc + particleVertices[PARTICLE_CAPACITY / 2].a;
+    }, PARTICLE_CAPACITY);
+
+    // eight parts of 200 placed primitives each, recorded and merged for submission
+    runBenchmark("draw_commands_record_merge", 10000, [](long n) {
+        double acc = 0;
+        CommandList* lists[8];
+        for (long f = 0; f < n; f++) {
+            for (int l = 0; l < 8; l++) {
+                CommandList& c = commandLists[l];
+                c.begin((unsigned)f);
+                c.translate(l * 0.1, 0, -0.4);
+                for (int i = 0; i < 200; i++) {
+                    c.push();
+                    c.translate(i * 0.01, 0.05, 0);
+                    c.rotate(i * 3.0, 0, 1, 0);
+                    c.scale(0.02, 0.1, 0.02);
+                    c.draw((i * 7 + l) % 11);
+                    c.pop();
+                }
+                lists[l] = &c;
+            }
+            int count = mergeCommandLists(lists, 8, mergedCommands);
+            acc += mergedCommands[count / 2]->matrix[12];
+        }
+        return acc;
+    });
+
+    // one simulation tick of a 64-player park, server and clients; the
+    // server's own share and the snapshot bandwidth are reported separately
+    {
+        BenchNet* net = new BenchNet;
+        for (int i = 0; i < 60; i++)
+            net->tick();
+        net->server.totalTickMs = 0;
+        net->server.ticks = 0;
+        unsigned startBytes = net->server.bytesSent;
+        unsigned long startTicks = net->ticks;
+        runBenchmark("net_tick_64_players", 600, [&](long n) {
+            for (long t = 0; t < n; t++)
+                net->tick();
+            double acc = 0;
+            for (int i = 0; i < MAX_NET_PLAYERS; i++)
+                acc += net->clients[0]->player(i).posX + net->clients[i]->predicted.posZ;
+            return acc;
+        });
+        double seconds = (double)(net->ticks - startTicks) / NET_TICK_RATE;
+        if (net->server.ticks > 0) {
+            reportMetric("net_server_tick_64_players", "us", net->server.totalTickMs * 1000 / net->server.ticks);
+            reportMetric("net_snapshot_bandwidth_per_client", "bytes/s", (net->server.bytesSent - startBytes) / seconds / MAX_NET_PLAYERS);
+        }
+        delete net;
+    }
+
+    // terrain: building a full window of chunks at their levels of detail,
+    // then the streaming bookkeeping of flying over the map at 6 units a
+    // second, with the loader generating chunks behind it
+    {
+        FrameArena arena(4 << 20);
+        TerrainBatch* batches;
+        TerrainStreamer terrain(256, NULL);
+        int window = (2 * terrain.windowRadius() + 1) * (2 * terrain.windowRadius() + 1);
+        for (int i = 0; i < 100000; i++) {
+            terrain.update(0, 0);
+            arena.reset();
+            if (terrain.prepare(Vector3f(0, 2, 0), arena, batches) == window)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        runBenchmark("terrain_prepare_window", 200, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                arena.reset();
+                int count = terrain.prepare(Vector3f(0.3f, 2, 0.1f), arena, batches);
+                for (int b = 0; b < count; b++)
+                    acc += batches[b].vertices[0].y + batches[b].level;
+            }
+            return acc;
+        });
+
+        TerrainStreamer flyover(256, NULL);
+        float x = -50;
+        runBenchmark("terrain_stream_update", 600, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                x = x > 50 ? -50 : x + 0.1f;
+                flyover.update(x, 10);
+                // not the chunks: how many are ready depends on the loader's pace
+                acc += x;
+            }
+            return acc;
+        });
+        reportMetric("terrain_peak_resident_chunks", "chunks", flyover.peakResident);
+        reportMetric("terrain_chunk_budget", "chunks", flyover.budget());
+    }
+
+    // 50k trees around the park, walking along the forest's inner edge: the
+    // quads of everything within the view distance and the trees close
+    // enough for their geometry
+    {
+        Forest forest;
+        forest.plant(50000, 3, 45, 1, proceduralHeight);
+        FrameArena arena(4 << 20);
+        ImpostorVertex* quads;
+        ImpostorBatch* cells;
+        const Impostor* nearTrees[128];
+        long totalQuads = 0, totalNear = 0, frames = 0;
+        runBenchmark("impostor_forest_50k", 600, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                float angle = i * 0.01f;
+                Vector3f eye(3.5f * cosf(angle), 0.5f, 3.5f * sinf(angle));
+                arena.reset();
+                int nearCount;
+                int count = forest.prepare(eye, 14, arena, quads, cells, nearTrees, 128, nearCount);
+                for (int c = 0; c < count; c++) {
+                    totalQuads += cells[c].count / 4;
+                    acc += quads[cells[c].first].x;
+                }
+                totalNear += nearCount;
+                frames++;
+            }
+            return acc;
+        }, 50000);
+        reportMetric("impostor_forest_quads_per_frame", "quads", (double)totalQuads / frames);
+        reportMetric("impostor_forest_geometry_trees_per_frame", "trees", (double)totalNear / frames);
+    }
+
+    // ten hours of the capacity-planning simulation, warm-up included;
+    // itemsPerOp is roughly the events each run processes
+    {
+        SimConfig config = defaultSimConfig();
+        config.hours = 10;
+        runBenchmark("park_sim_10_hours", 20, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                ThroughputSimulation simulation(config);
+                const SimResult& result = simulation.run();
+                acc += result.visitorSeconds / 3600;
+            }
+            return acc;
+        }, 18000);
+    }
+
+    // visitors on the park floor: laying it out (seven fields from
+    // scratch), repairing ten fields as a barrier goes up or comes down
+    // across the entrance, and 10k visitors steering by them
+    {
+        runBenchmark("nav_layout_park", 20, [](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                Navigation nav(-PARK_NAV_EXTENT, -PARK_NAV_EXTENT, PARK_NAV_EXTENT, PARK_NAV_EXTENT);
+                layOutPark(nav);
+                acc += nav.cost(DEST_TICKET_STAND, 0, 0);
+            }
+            return acc;
+        });
+
+        Navigation nav(-PARK_NAV_EXTENT, -PARK_NAV_EXTENT, PARK_NAV_EXTENT, PARK_NAV_EXTENT);
+        layOutPark(nav);
+        // three picnic spots make ten destinations
+        nav.addDestination(0.1f, 0.1f, 0.15f, 0.15f);
+        nav.addDestination(-0.2f, 0.65f, -0.15f, 0.7f);
+        nav.addDestination(0.7f, -0.75f, 0.75f, -0.7f);
+        long toggles = 0;
+        unsigned long repairedBefore = nav.repairedCells();
+        runBenchmark("nav_repair_10_fields", 200, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                nav.setBlocked(-0.2f, 0.6f, 0.2f, 0.62f, toggles++ % 2 == 0);
+                nav.update();
+                acc += nav.cost(DEST_SWING, 0, 0.8f);
+            }
+            return acc;
+        });
+        reportMetric("nav_repaired_cells_per_field", "cells", (double)(nav.repairedCells() - repairedBefore) / toggles / nav.destinations());
+        reportMetric("nav_grid_cells", "cells", nav.width() * nav.height());
+
+        Crowd crowd;
+        crowd.spawn(nav, 10000, DEST_TICKET_STAND, DEST_EXIT, 3, 1);
+        runBenchmark("nav_agents_10k", 600, [&](long n) {
+            for (long i = 0; i < n; i++)
+                crowd.step(nav, 0, (int)crowd.agents.size(), 0.004f);
+            double acc = 0;
+            for (size_t a = 0; a < crowd.agents.size(); a++)
+                acc += crowd.agents[a].x + crowd.agents[a].z;
+            return acc;
+        }, 10000);
+    }
+
+    // the rides as the ride shader evaluates them: how far their curves ever
+    // get from the per-tick rules they replaced over 90 minutes of ticks
+    // (not the swing, which now eases), what posing a flotilla of balloons
+    // from them costs on the CPU, and how many ride evaluations the
+    // animation levels save a camera circling the park
+    {
+        const long ticks = 90 * 60 * 60;
+        double error = std::max(steppedError(&HotAirBalloon::translationY, -0.03f, 0.03f, 0.01f, 0.0f, ticks),
+            steppedError(&Tree::scale, 0.8f, 1.2f, 0.02f, 1.0f, ticks));
+        error = std::max(error, std::max(steppedError(&TicketStand::scale, 1.0f, 1.2f, 0.01f, 1.0f, ticks),
+            steppedError(&Ticket::translationX, -0.03f, 0.03f, 0.01f, 0.0f, ticks)));
+        error = std::max(error, steppedError(&Fence::r, 0.2f, 0.8f, 0.03f, 0.5f, ticks));
+        FerrisWheel wheel;
+        double angle = 0;
+        for (long t = 0; t < ticks; t++) {
+            wheel.evaluate((double)t);
+            double degrees = fmod(wheel.rotationAngle - angle + 540.0, 360.0) - 180;
+            error = std::max(error, fabs(degrees));
+            angle += 3;
+            if (angle > 360)
+                angle -= 360;
+        }
+        reportMetric("ride_curve_max_error", "units", error);
+
+        AnimationLod lod;
+        addParkAnimationSites(lod);
+        Camera circling;
+        int due[ANIM_COUNT];
+        for (long t = 0; t < 60 * 60; t++) {
+            float angle = t * 0.002f;
+            float distance = 1.5f + 3.0f * (0.5f + 0.5f * sinf(t * 0.0007f));
+            circling.lookAt(Vector3f(distance * cosf(angle), 0.5f, distance * sinf(angle)), Vector3f(0, 0.15f, 0));
+            lod.beginViews();
+            lod.see(circling);
+            lod.due((double)t, due);
+        }
+        reportMetric("ride_evaluations_skipped", "%", lod.skippedPercent());
+
+        const int balloons = 10000;
+        std::vector<RideInstance> flotilla(balloons);
+        balloonFlotilla(&flotilla[0], balloons, HotAirBalloon().bob, 0.3f);
+        long tick = 0;
+        runBenchmark("ride_pose_flotilla_10k", 200, [&](long n) {
+            double acc = 0;
+            float rest[3] = { 0, 0, 0 }, p[3];
+            for (long i = 0; i < n; i++) {
+                for (int b = 0; b < balloons; b++) {
+                    placeRidePoint(flotilla[b], (double)tick, rest, p);
+                    acc += p[1];
+                }
+                tick++;
+            }
+            return acc;
+        }, balloons);
+    }
+
+    // the park at night: binning its lights into the clusters of a camera
+    // circling it, and how many of them the shading loop then reads for a
+    // fragment of the park floor on average
+    {
+        int lights = parkNightLights(parkLights, MAX_CLUSTERED_LIGHTS, 0, 0);
+        Camera camera;
+        long views = 0;
+        runBenchmark("light_binning_park", 2000, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                float angle = views++ * 0.01f;
+                camera.lookAt(Vector3f(1.1f * cosf(angle), 0.4f, 1.1f * sinf(angle)), Vector3f(0, 0.1f, 0));
+                lightClusters.bin(parkLights, lights, camera.view(), camera.projection());
+                acc += lightClusters.indexCount;
+            }
+            return acc;
+        }, lights);
+        reportMetric("light_park_lights", "lights", lights);
+
+        Camera player;
+        std::vector<float> depth;
+        groundDepths(player, 640, 320, depth);
+        lightClusters.bin(parkLights, lights, player.view(), player.projection());
+        reportMetric("light_clusters_per_view", "clusters", CLUSTER_COUNT);
+        reportMetric("light_cluster_pairs_per_view", "pairs", lightClusters.indexCount);
+        reportMetric("light_lights_per_fragment", "lights", lightClusters.lightsPerFragment(&depth[0], 640, 320, 1));
+    }
+
+    // startup: tessellating every mesh, as the game does without a pack,
+    // against mapping a baked pack and reading every vertex of it
+    {
+        MeshData mesh;
+        runBenchmark("mesh_generate_all", 5, [&](long n) {
+            double acc = 0;
+            for (long i = 0; i < n; i++) {
+                for (int id = 0; id < MESH_COUNT; id++) {
+                    generateMesh(id, mesh);
+                    for (size_t v = 0; v < mesh.vertices.size(); v++)
+                        acc += mesh.vertices[v].position[1];
+                }
+            }
+            return acc;
+        });
+
+        const char* path = "park_bench.pack";
+        AssetPackWriter writer;
+        std::vector<unsigned char> bytes;
+        for (int id = 0; id < MESH_COUNT; id++) {
+            generateMesh(id, mesh);
+            writeMesh(mesh, bytes);
+            writer.add(meshNames[id], &bytes[0], bytes.size());
+        }
+        if (writer.save(path)) {
+            runBenchmark("asset_pack_map_all", 5, [&](long n) {
+                double acc = 0;
+                for (long i = 0; i < n; i++) {
+                    AssetPack pack;
+                    pack.open(path);
+                    for (int id = 0; id < MESH_COUNT; id++) {
+                        size_t size = 0;
+                        const void* data = pack.find(meshNames[id], &size);
+                        MeshView view;
+                        if (!readMesh(data, size, view))
+                            continue;
+                        for (unsigned v = 0; v < view.vertexCount; v++)
+                            acc += view.vertices[v].position[1];
+                    }
+                }
+                return acc;
+            });
+            remove(path);
+        }
+    }
+
+    const int attractions = 10000;
+    const int grain = 64;
+    for (int threads = 1; threads <= MAX_JOB_THREADS; threads *= 2) {
+        char name[64];
+        snprintf(name, sizeof(name), "jobs_frame_10k/threads:%d", threads);
+        BenchPark park;
+        setupBenchPark(park, attractions);
+        jobs.start(threads);
+        runBenchmark(name, 200, [&](long n) {
+            for (long f = 0; f < n; f++) {
+                park.ticks++;
+                Job* animate = jobs.createJob(benchAnimate, &park, 0, attractions, grain);
+                Job* collide = jobs.createJob(benchCollide, &park, 0, (int)park.tickets.size(), grain);
+                Job* cull = jobs.createJob(benchCull, &park, 0, attractions, grain);
+                jobs.addDependency(collide, animate);
+                jobs.addDependency(cull, animate);
+                jobs.run(collide);
+                jobs.run(cull);
+                jobs.run(animate);
+                jobs.wait(collide);
+                jobs.wait(cull);
+            }
+            double visible = 0;
+            for (int i = 0; i < attractions; i++)
+                visible += park.visible[i];
+            for (size_t i = 0; i < park.hits.size(); i++)
+                visible += park.hits[i];
+            return visible;
+        });
+        jobs.stop();
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
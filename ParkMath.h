@@ -0,0 +1,172 @@
+#ifndef PARK_MATH_H
+#define PARK_MATH_H
+
+#include <math.h>
+
+#define DEG2RAD(a) (a * 0.0174532925)
+
+class Vector3f {
+public:
+    float x, y, z;
+
+    Vector3f(float _x = 0.0f, float _y = 0.0f, float _z = 0.0f) {
+        x = _x;
+        y = _y;
+        z = _z;
+    }
+
+    Vector3f operator+(const Vector3f& v) const {
+        return Vector3f(x + v.x, y + v.y, z + v.z);
+    }
+
+    Vector3f operator-(const Vector3f& v) const {
+        return Vector3f(x - v.x, y - v.y, z - v.z);
+    }
+
+    Vector3f operator*(float n) const {
+        return Vector3f(x * n, y * n, z * n);
+    }
+
+    Vector3f operator/(float n) const {
+        return Vector3f(x / n, y / n, z / n);
+    }
+
+    Vector3f unit() const {
+        float magnitude = sqrt(x * x + y * y + z * z);
+        return (*this) / magnitude;
+    }
+
+    float dot(const Vector3f& v) const {
+        return x * v.x + y * v.y + z * v.z;
+    }
+
+    Vector3f cross(const Vector3f& v) const {
+        return Vector3f(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+    }
+};
+
+class Quaternion {
+public:
+    float w, x, y, z;
+
+    Quaternion(float _w = 1.0f, float _x = 0.0f, float _y = 0.0f, float _z = 0.0f) {
+        w = _w;
+        x = _x;
+        y = _y;
+        z = _z;
+    }
+
+    // rotation of the given angle in degrees about a unit axis
+    static Quaternion axisAngle(const Vector3f& axis, float degrees) {
+        float half = (float)DEG2RAD(degrees) * 0.5f;
+        float s = sin(half);
+        return Quaternion(cos(half), axis.x * s, axis.y * s, axis.z * s);
+    }
+
+    // rotation whose matrix has the given orthonormal columns
+    static Quaternion fromBasis(const Vector3f& right, const Vector3f& up, const Vector3f& back) {
+        float trace = right.x + up.y + back.z;
+        Quaternion q;
+        if (trace > 0) {
+            float s = sqrt(trace + 1.0f) * 2.0f;
+            q = Quaternion(0.25f * s, (up.z - back.y) / s, (back.x - right.z) / s, (right.y - up.x) / s);
+        }
+        else if (right.x > up.y && right.x > back.z) {
+            float s = sqrt(1.0f + right.x - up.y - back.z) * 2.0f;
+            q = Quaternion((up.z - back.y) / s, 0.25f * s, (up.x + right.y) / s, (back.x + right.z) / s);
+        }
+        else if (up.y > back.z) {
+            float s = sqrt(1.0f + up.y - right.x - back.z) * 2.0f;
+            q = Quaternion((back.x - right.z) / s, (up.x + right.y) / s, 0.25f * s, (back.y + up.z) / s);
+        }
+        else {
+            float s = sqrt(1.0f + back.z - right.x - up.y) * 2.0f;
+            q = Quaternion((right.y - up.x) / s, (back.x + right.z) / s, (back.y + up.z) / s, 0.25f * s);
+        }
+        return q.unit();
+    }
+
+    Quaternion operator*(const Quaternion& q) const {
+        return Quaternion(
+            w * q.w - x * q.x - y * q.y - z * q.z,
+            w * q.x + x * q.w + y * q.z - z * q.y,
+            w * q.y - x * q.z + y * q.w + z * q.x,
+            w * q.z + x * q.y - y * q.x + z * q.w);
+    }
+
+    Quaternion unit() const {
+        float magnitude = sqrt(w * w + x * x + y * y + z * z);
+        return Quaternion(w / magnitude, x / magnitude, y / magnitude, z / magnitude);
+    }
+
+    Vector3f rotate(const Vector3f& v) const {
+        Vector3f axis(x, y, z);
+        Vector3f t = axis.cross(v) * 2.0f;
+        return v + t * w + axis.cross(t);
+    }
+
+    static Quaternion slerp(const Quaternion& a, Quaternion b, float t) {
+        float d = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+        if (d < 0) {
+            b = Quaternion(-b.w, -b.x, -b.y, -b.z);
+            d = -d;
+        }
+        float wa = 1.0f - t, wb = t;
+        if (d < 0.9995f) {
+            float angle = acos(d);
+            float s = sin(angle);
+            wa = sin((1.0f - t) * angle) / s;
+            wb = sin(t * angle) / s;
+        }
+        return Quaternion(a.w * wa + b.w * wb, a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb).unit();
+    }
+};
+
+class Plane {
+public:
+    Vector3f normal;
+    float d;
+
+    Plane() : d(0.0f) {}
+
+    float distance(const Vector3f& p) const {
+        return normal.dot(p) + d;
+    }
+};
+
+// 4x4 matrices are float[16] in OpenGL's column-major order
+
+inline void multiplyMatrices(const float a[16], const float b[16], float out[16]) {
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+        }
+    }
+}
+
+// same matrix as gluPerspective
+inline void perspectiveMatrix(float fovY, float aspect, float zNear, float zFar, float m[16]) {
+    float f = 1.0f / tan((float)DEG2RAD(fovY) * 0.5f);
+    for (int i = 0; i < 16; i++)
+        m[i] = 0;
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zFar + zNear) / (zNear - zFar);
+    m[11] = -1;
+    m[14] = 2 * zFar * zNear / (zNear - zFar);
+}
+
+// planes of a view-projection matrix, normals pointing inwards
+inline void extractFrustum(const float m[16], Plane planes[6]) {
+    for (int i = 0; i < 6; i++) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        Vector3f n(m[3] + sign * m[row], m[7] + sign * m[4 + row], m[11] + sign * m[8 + row]);
+        float d = m[15] + sign * m[12 + row];
+        float length = sqrt(n.dot(n));
+        planes[i].normal = n / length;
+        planes[i].d = d / length;
+    }
+}
+
+#endif
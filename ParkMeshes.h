@@ -0,0 +1,302 @@
+#ifndef PARK_MESHES_H
+#define PARK_MESHES_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "Park.h"
+
+// The park's primitives as plain vertex arrays, tessellated the way GLUT 3.7
+// and GLU tessellate glutSolidSphere, glutSolidCone, glutWireTorus, gluDisk
+// and gluSphere, so a mesh baked into the asset pack (see AssetPack.h and
+// ParkBake.cpp) draws like the GLUT call it replaces. Nothing here needs GL.
+
+// every primitive the draw functions use, compiled into display lists
+enum MeshId {
+    MESH_CUBE,
+    MESH_HEAD_SPHERE,
+    MESH_SMALL_SPHERE,
+    MESH_BALLOON_SPHERE,
+    MESH_CONE,
+    MESH_SLEEVE_CONE,
+    MESH_WHEEL_TORUS,
+    MESH_HUB_TORUS,
+    MESH_WINDOW_DISK,
+    MESH_SKY,
+    MESH_MOUTH,
+    MESH_COUNT
+};
+
+const char* const meshNames[MESH_COUNT] = {
+    "mesh/cube", "mesh/head_sphere", "mesh/small_sphere", "mesh/balloon_sphere", "mesh/cone", "mesh/sleeve_cone",
+    "mesh/wheel_torus", "mesh/hub_torus", "mesh/window_disk", "mesh/sky", "mesh/mouth"
+};
+
+// the same values as the GL primitive types
+enum MeshPrimitive {
+    PRIMITIVE_LINE_STRIP = 0x0003,
+    PRIMITIVE_TRIANGLE_FAN = 0x0006,
+    PRIMITIVE_QUADS = 0x0007,
+    PRIMITIVE_QUAD_STRIP = 0x0008
+};
+
+enum MeshFlags {
+    MESH_NORMALS = 1,       // without, the current GL normal applies
+    MESH_TEXCOORDS = 2,
+    MESH_WIREFRAME = 4      // polygons drawn as lines, as glutWireTorus does
+};
+
+struct MeshVertex {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+// one glDrawArrays call
+struct MeshRun {
+    unsigned primitive;
+    unsigned first;
+    unsigned count;
+    unsigned reserved;
+};
+
+struct MeshData {
+    unsigned flags;
+    std::vector<MeshRun> runs;
+    std::vector<MeshVertex> vertices;
+};
+
+// a mesh as stored in a pack, pointing into the pack's memory
+struct MeshView {
+    unsigned flags;
+    unsigned runCount;
+    unsigned vertexCount;
+    const MeshRun* runs;
+    const MeshVertex* vertices;
+};
+
+// the serialized form: this header, the runs, then the vertices, all of
+// them multiples of 16 bytes so the vertices stay aligned
+struct MeshHeader {
+    unsigned flags;
+    unsigned runCount;
+    unsigned vertexCount;
+    unsigned reserved;
+};
+
+inline void beginRun(MeshData& mesh, unsigned primitive) {
+    MeshRun run = { primitive, (unsigned)mesh.vertices.size(), 0, 0 };
+    mesh.runs.push_back(run);
+}
+
+inline void addVertex(MeshData& mesh, float x, float y, float z, float nx, float ny, float nz, float s = 0, float t = 0) {
+    MeshVertex v = { { x, y, z }, { nx, ny, nz }, { s, t } };
+    mesh.vertices.push_back(v);
+    mesh.runs.back().count++;
+}
+
+inline void generateCube(MeshData& mesh, float size) {
+    static const float n[6][3] = { { -1, 0, 0 }, { 0, 1, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    static const int faces[6][4] = { { 0, 1, 2, 3 }, { 3, 2, 6, 7 }, { 7, 6, 5, 4 }, { 4, 5, 1, 0 }, { 5, 6, 2, 1 }, { 7, 4, 0, 3 } };
+    float v[8][3];
+    for (int i = 0; i < 8; i++) {
+        v[i][0] = i < 4 ? -size / 2 : size / 2;
+        v[i][1] = (i & 3) == 0 || (i & 3) == 1 ? -size / 2 : size / 2;
+        v[i][2] = (i & 3) == 0 || (i & 3) == 3 ? -size / 2 : size / 2;
+    }
+    mesh.flags = MESH_NORMALS;
+    beginRun(mesh, PRIMITIVE_QUADS);
+    for (int i = 5; i >= 0; i--) {
+        for (int k = 0; k < 4; k++) {
+            const float* p = v[faces[i][k]];
+            addVertex(mesh, p[0], p[1], p[2], n[i][0], n[i][1], n[i][2]);
+        }
+    }
+}
+
+// gluSphere with smooth normals; without texture coordinates the poles are
+// triangle fans, with them quad strips all the way
+inline void generateSphere(MeshData& mesh, float radius, int slices, int stacks, bool textured) {
+    const float pi = 3.14159265358979f;
+    std::vector<float> sinA(slices + 1), cosA(slices + 1), sinB(stacks + 1), cosB(stacks + 1);
+    for (int i = 0; i < slices; i++) {
+        sinA[i] = sinf(2 * pi * i / slices);
+        cosA[i] = cosf(2 * pi * i / slices);
+    }
+    sinA[slices] = sinA[0];
+    cosA[slices] = cosA[0];
+    for (int j = 0; j <= stacks; j++) {
+        sinB[j] = sinf(pi * j / stacks);
+        cosB[j] = cosf(pi * j / stacks);
+    }
+    // so it comes to a point
+    sinB[0] = 0;
+    sinB[stacks] = 0;
+
+    mesh.flags = MESH_NORMALS | (textured ? MESH_TEXCOORDS : 0);
+    int start = 0, finish = stacks;
+    if (!textured) {
+        start = 1;
+        finish = stacks - 1;
+        beginRun(mesh, PRIMITIVE_TRIANGLE_FAN);
+        addVertex(mesh, 0, 0, radius, 0, 0, 1);
+        for (int i = slices; i >= 0; i--)
+            addVertex(mesh, radius * sinB[1] * sinA[i], radius * sinB[1] * cosA[i], radius * cosB[1], sinA[i] * sinB[1], cosA[i] * sinB[1], cosB[1]);
+        beginRun(mesh, PRIMITIVE_TRIANGLE_FAN);
+        addVertex(mesh, 0, 0, -radius, 0, 0, -1);
+        int j = stacks - 1;
+        for (int i = 0; i <= slices; i++)
+            addVertex(mesh, radius * sinB[j] * sinA[i], radius * sinB[j] * cosA[i], radius * cosB[j], sinA[i] * sinB[j], cosA[i] * sinB[j], cosB[j]);
+    }
+    for (int j = start; j < finish; j++) {
+        beginRun(mesh, PRIMITIVE_QUAD_STRIP);
+        for (int i = 0; i <= slices; i++) {
+            float s = 1 - (float)i / slices;
+            addVertex(mesh, radius * sinB[j + 1] * sinA[i], radius * sinB[j + 1] * cosA[i], radius * cosB[j + 1],
+                sinA[i] * sinB[j + 1], cosA[i] * sinB[j + 1], cosB[j + 1], s, 1 - (float)(j + 1) / stacks);
+            addVertex(mesh, radius * sinB[j] * sinA[i], radius * sinB[j] * cosA[i], radius * cosB[j],
+                sinA[i] * sinB[j], cosA[i] * sinB[j], cosB[j], s, 1 - (float)j / stacks);
+        }
+    }
+}
+
+// glutSolidCone: an open gluCylinder narrowing to a point, no base
+inline void generateCone(MeshData& mesh, float base, float height, int slices, int stacks) {
+    const float pi = 3.14159265358979f;
+    float length = sqrtf(base * base + height * height);
+    float zNormal = base / length, xyNormal = height / length;
+    mesh.flags = MESH_NORMALS;
+    for (int j = 0; j < stacks; j++) {
+        float zLow = j * height / stacks, zHigh = (j + 1) * height / stacks;
+        float radiusLow = base - base * ((float)j / stacks), radiusHigh = base - base * ((float)(j + 1) / stacks);
+        beginRun(mesh, PRIMITIVE_QUAD_STRIP);
+        for (int i = 0; i <= slices; i++) {
+            float a = i == slices ? 0 : 2 * pi * i / slices;
+            float s = sinf(a), c = cosf(a);
+            addVertex(mesh, radiusLow * s, radiusLow * c, zLow, xyNormal * s, xyNormal * c, zNormal);
+            addVertex(mesh, radiusHigh * s, radiusHigh * c, zHigh, xyNormal * s, xyNormal * c, zNormal);
+        }
+    }
+}
+
+// gluDisk with no hole: a fan in the middle and quad strips around it
+inline void generateDisk(MeshData& mesh, float radius, int slices, int loops) {
+    const float pi = 3.14159265358979f;
+    std::vector<float> sinA(slices + 1), cosA(slices + 1);
+    for (int i = 0; i < slices; i++) {
+        sinA[i] = sinf(2 * pi * i / slices);
+        cosA[i] = cosf(2 * pi * i / slices);
+    }
+    sinA[slices] = sinA[0];
+    cosA[slices] = cosA[0];
+
+    mesh.flags = MESH_NORMALS;
+    beginRun(mesh, PRIMITIVE_TRIANGLE_FAN);
+    addVertex(mesh, 0, 0, 0, 0, 0, 1);
+    float inner = radius - radius * ((float)(loops - 1) / loops);
+    for (int i = slices; i >= 0; i--)
+        addVertex(mesh, inner * sinA[i], inner * cosA[i], 0, 0, 0, 1);
+    for (int j = 0; j < loops - 1; j++) {
+        float radiusLow = radius - radius * ((float)j / loops), radiusHigh = radius - radius * ((float)(j + 1) / loops);
+        beginRun(mesh, PRIMITIVE_QUAD_STRIP);
+        for (int i = 0; i <= slices; i++) {
+            addVertex(mesh, radiusLow * sinA[i], radiusLow * cosA[i], 0, 0, 0, 1);
+            addVertex(mesh, radiusHigh * sinA[i], radiusHigh * cosA[i], 0, 0, 0, 1);
+        }
+    }
+}
+
+// glutWireTorus: one quad strip per ring, drawn as lines
+inline void generateWireTorus(MeshData& mesh, float innerRadius, float outerRadius, int sides, int rings) {
+    const float pi = 3.14159265358979f;
+    float ringDelta = 2 * pi / rings, sideDelta = 2 * pi / sides;
+    float theta = 0, cosTheta = 1, sinTheta = 0;
+    mesh.flags = MESH_NORMALS | MESH_WIREFRAME;
+    for (int i = rings - 1; i >= 0; i--) {
+        float theta1 = theta + ringDelta;
+        float cosTheta1 = cosf(theta1), sinTheta1 = sinf(theta1);
+        beginRun(mesh, PRIMITIVE_QUAD_STRIP);
+        float phi = 0;
+        for (int j = sides; j >= 0; j--) {
+            phi += sideDelta;
+            float cosPhi = cosf(phi), sinPhi = sinf(phi);
+            float dist = outerRadius + innerRadius * cosPhi;
+            addVertex(mesh, cosTheta1 * dist, -sinTheta1 * dist, innerRadius * sinPhi, cosTheta1 * cosPhi, -sinTheta1 * cosPhi, sinPhi);
+            addVertex(mesh, cosTheta * dist, -sinTheta * dist, innerRadius * sinPhi, cosTheta * cosPhi, -sinTheta * cosPhi, sinPhi);
+        }
+        theta = theta1;
+        cosTheta = cosTheta1;
+        sinTheta = sinTheta1;
+    }
+}
+
+// the player's smile, a Bezier curve as a line strip without normals
+inline void generateMouth(MeshData& mesh) {
+    static const float ctrlPoints[4][3] = {
+        { 0.03f, -0.05f, 0.05f },
+        { 0.01f, -0.065f, 0.05f },
+        { -0.01f, -0.065f, 0.05f },
+        { -0.03f, -0.05f, 0.05f }
+    };
+    mesh.flags = 0;
+    beginRun(mesh, PRIMITIVE_LINE_STRIP);
+    for (float t = 0.0f; t <= 1.0f; t += 0.01f) {
+        Vector3f p = bezierPoint(ctrlPoints, t);
+        addVertex(mesh, p.x, p.y, p.z, 0, 0, 0);
+    }
+}
+
+// the arguments match the GLUT and GLU calls in drawMeshImmediate, except
+// that the tori get 32 sides around the tube instead of 1000: the tube is a
+// few pixels thick, and a million line segments per torus would not fit a
+// pack or a display list
+inline void generateMesh(int id, MeshData& mesh) {
+    mesh.runs.clear();
+    mesh.vertices.clear();
+    switch (id) {
+    case MESH_CUBE: generateCube(mesh, 1.0f); break;
+    case MESH_HEAD_SPHERE: generateSphere(mesh, 0.1f, 100, 100, false); break;
+    case MESH_SMALL_SPHERE: generateSphere(mesh, 0.02f, 20, 20, false); break;
+    case MESH_BALLOON_SPHERE: generateSphere(mesh, 40.0f, 100, 100, false); break;
+    case MESH_CONE: generateCone(mesh, 0.5f, 1.5f, 50, 50); break;
+    case MESH_SLEEVE_CONE: generateCone(mesh, 0.6f, 1.6f, 50, 50); break;
+    case MESH_WHEEL_TORUS: generateWireTorus(mesh, 0.02f, 0.2f, 32, 1000); break;
+    case MESH_HUB_TORUS: generateWireTorus(mesh, 0.009f, 0.1f, 32, 1000); break;
+    case MESH_WINDOW_DISK: generateDisk(mesh, 0.1f, 50, 50); break;
+    case MESH_SKY: generateSphere(mesh, 100.0f, 100, 100, true); break;
+    case MESH_MOUTH: generateMouth(mesh); break;
+    }
+}
+
+inline void writeMesh(const MeshData& mesh, std::vector<unsigned char>& out) {
+    MeshHeader header = { mesh.flags, (unsigned)mesh.runs.size(), (unsigned)mesh.vertices.size(), 0 };
+    size_t runBytes = mesh.runs.size() * sizeof(MeshRun), vertexBytes = mesh.vertices.size() * sizeof(MeshVertex);
+    out.resize(sizeof(header) + runBytes + vertexBytes);
+    memcpy(&out[0], &header, sizeof(header));
+    if (runBytes)
+        memcpy(&out[sizeof(header)], &mesh.runs[0], runBytes);
+    if (vertexBytes)
+        memcpy(&out[sizeof(header) + runBytes], &mesh.vertices[0], vertexBytes);
+}
+
+// false when the bytes are not a whole mesh; data must be 16-byte aligned
+inline bool readMesh(const void* data, size_t size, MeshView& view) {
+    if (!data || size < sizeof(MeshHeader))
+        return false;
+    const MeshHeader* header = (const MeshHeader*)data;
+    size_t runBytes = (size_t)header->runCount * sizeof(MeshRun), vertexBytes = (size_t)header->vertexCount * sizeof(MeshVertex);
+    if (sizeof(MeshHeader) + runBytes + vertexBytes != size)
+        return false;
+    view.flags = header->flags;
+    view.runCount = header->runCount;
+    view.vertexCount = header->vertexCount;
+    view.runs = (const MeshRun*)(header + 1);
+    view.vertices = (const MeshVertex*)((const unsigned char*)view.runs + runBytes);
+    for (unsigned i = 0; i < view.runCount; i++) {
+        if (view.runs[i].first + view.runs[i].count > view.vertexCount)
+            return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,732 @@
+#ifndef PARK_NET_H
+#define PARK_NET_H
+
+#include <string.h>
+#include <chrono>
+#include "Park.h"
+
+// One park shared by several kiosks. An authoritative server simulates the
+// rides, the ticket and up to 64 players and sends every client a snapshot
+// at a fixed rate. Values are quantized to a few bits, and a snapshot only
+// carries what changed since the last one the client acknowledged, so a
+// quiet park costs a few bytes. Clients predict their own player from the
+// inputs the server has not confirmed yet and draw everything else
+// interpolated between snapshots, a little in the past. Nothing here knows
+// about sockets: packets go out through a callback and come in through
+// receive(), so server and clients also run in memory (see ParkBench.cpp).
+// No allocation after construction.
+
+const int MAX_NET_PLAYERS = 64;
+const int NET_TICK_RATE = 60;                   // simulation ticks per second
+const int SNAPSHOT_INTERVAL = 3;                // ticks between snapshots
+const int SNAPSHOT_HISTORY = 32;                // snapshots kept as delta baselines
+const int INTERPOLATION_DELAY = 2 * SNAPSHOT_INTERVAL;  // ticks the others are drawn behind
+const int MAX_PENDING_INPUTS = 15;
+const int NET_TIMEOUT_TICKS = 5 * NET_TICK_RATE;
+const int NET_RETRY_TICKS = NET_TICK_RATE / 2;
+const int MAX_PACKET_SIZE = 1200;
+
+enum NetMessage {
+    NET_CONNECT,
+    NET_WELCOME,
+    NET_FULL,
+    NET_INPUT,
+    NET_SNAPSHOT
+};
+
+struct NetAddress {
+    unsigned host;          // IPv4, host byte order
+    unsigned short port;
+};
+
+inline bool sameAddress(const NetAddress& a, const NetAddress& b) {
+    return a.host == b.host && a.port == b.port;
+}
+
+typedef void (*NetSendFunction)(void* context, const NetAddress& to, const unsigned char* data, int size);
+
+// true when sequence a comes after b, across the 16-bit wrap
+inline bool sequenceAfter(unsigned short a, unsigned short b) {
+    return (short)(a - b) > 0;
+}
+
+// packs values of up to 32 bits, most significant bit first
+class BitWriter {
+public:
+    bool overflowed;
+
+    BitWriter(unsigned char* buffer, int capacity) : overflowed(false), data(buffer), capacity(capacity), size(0), scratch(0), scratchBits(0) {}
+
+    void write(unsigned value, int bits) {
+        scratch = (scratch << bits) | (value & ((1ull << bits) - 1));
+        scratchBits += bits;
+        while (scratchBits >= 8) {
+            scratchBits -= 8;
+            if (size < capacity)
+                data[size++] = (unsigned char)(scratch >> scratchBits);
+            else
+                overflowed = true;
+        }
+    }
+
+    // pads the last byte; returns the packet size
+    int finish() {
+        if (scratchBits > 0)
+            write(0, 8 - scratchBits);
+        return size;
+    }
+
+private:
+    unsigned char* data;
+    int capacity, size;
+    unsigned long long scratch;
+    int scratchBits;
+};
+
+class BitReader {
+public:
+    bool overrun;           // read past the end: the packet is truncated
+
+    BitReader(const unsigned char* buffer, int size) : overrun(false), data(buffer), size(size), position(0), scratch(0), scratchBits(0) {}
+
+    unsigned read(int bits) {
+        while (scratchBits < bits) {
+            unsigned char byte = 0;
+            if (position < size)
+                byte = data[position];
+            else
+                overrun = true;
+            position++;
+            scratch = (scratch << 8) | byte;
+            scratchBits += 8;
+        }
+        scratchBits -= bits;
+        return (unsigned)((scratch >> scratchBits) & ((1ull << bits) - 1));
+    }
+
+private:
+    const unsigned char* data;
+    int size, position;
+    unsigned long long scratch;
+    int scratchBits;
+};
+
+struct NetRange {
+    float low, high;
+    int bits;
+};
+
+inline unsigned quantize(float value, const NetRange& range) {
+    float t = (value - range.low) / (range.high - range.low);
+    if (t < 0)
+        t = 0;
+    if (t > 1)
+        t = 1;
+    return (unsigned)(t * ((1u << range.bits) - 1) + 0.5f);
+}
+
+inline float dequantize(unsigned q, const NetRange& range) {
+    return range.low + (range.high - range.low) * q / (float)((1u << range.bits) - 1);
+}
+
+enum RideField {
+    RIDE_FENCE_R,
+    RIDE_FENCE_G,
+    RIDE_FENCE_B,
+    RIDE_WHEEL_ANGLE,
+    RIDE_BALLOON_Y,
+    RIDE_SWING_ANGLE,
+    RIDE_TREE_SCALE,
+    RIDE_STAND_SCALE,
+    RIDE_TICKET_SHIFT,
+    RIDE_TICKET_X,
+    RIDE_TICKET_Z,
+    RIDE_FIELDS
+};
+
+const NetRange rideRanges[RIDE_FIELDS] = {
+    { -0.5f, 1.0f, 10 }, { -0.5f, 1.0f, 10 }, { -0.5f, 1.0f, 10 },
+    { 0.0f, 360.0f, 12 },
+    { -0.05f, 0.05f, 10 },
+    { -25.0f, 25.0f, 10 },
+    { 0.7f, 1.3f, 10 },
+    { 0.9f, 1.3f, 10 },
+    { -0.05f, 0.05f, 10 },
+    { -0.5f, 0.5f, 12 }, { -0.5f, 0.5f, 12 }
+};
+
+enum PlayerField {
+    PLAYER_X,
+    PLAYER_Z,
+    PLAYER_ANGLE,
+    PLAYER_TICKETS,
+    PLAYER_FIELDS
+};
+
+const NetRange playerRanges[PLAYER_FIELDS] = {
+    { -0.6f, 0.6f, 12 }, { -0.6f, 0.6f, 12 },
+    { 0.0f, 360.0f, 8 },
+    { 0.0f, 255.0f, 8 }
+};
+
+// the park as sent, already quantized; inactive players are all zero
+struct NetSnapshot {
+    unsigned tick;
+    unsigned short rides[RIDE_FIELDS];
+    bool active[MAX_NET_PLAYERS];
+    unsigned short players[MAX_NET_PLAYERS][PLAYER_FIELDS];
+};
+
+inline void writeField(BitWriter& out, unsigned value, unsigned base, int bits) {
+    out.write(value != base, 1);
+    if (value != base)
+        out.write(value, bits);
+}
+
+inline unsigned readField(BitReader& in, unsigned base, int bits) {
+    return in.read(1) ? in.read(bits) : base;
+}
+
+// current as changes to baseline: one bit for anything unchanged
+inline void writeSnapshot(BitWriter& out, const NetSnapshot& current, const NetSnapshot& baseline) {
+    for (int f = 0; f < RIDE_FIELDS; f++)
+        writeField(out, current.rides[f], baseline.rides[f], rideRanges[f].bits);
+    for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+        bool changed = current.active[i] != baseline.active[i]
+            || memcmp(current.players[i], baseline.players[i], sizeof(current.players[i])) != 0;
+        out.write(changed, 1);
+        if (!changed)
+            continue;
+        out.write(current.active[i], 1);
+        if (!current.active[i])
+            continue;
+        for (int f = 0; f < PLAYER_FIELDS; f++)
+            writeField(out, current.players[i][f], baseline.players[i][f], playerRanges[f].bits);
+    }
+}
+
+inline void readSnapshot(BitReader& in, NetSnapshot& out, const NetSnapshot& baseline) {
+    for (int f = 0; f < RIDE_FIELDS; f++)
+        out.rides[f] = (unsigned short)readField(in, baseline.rides[f], rideRanges[f].bits);
+    for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+        if (!in.read(1)) {
+            out.active[i] = baseline.active[i];
+            memcpy(out.players[i], baseline.players[i], sizeof(out.players[i]));
+            continue;
+        }
+        out.active[i] = in.read(1) != 0;
+        memset(out.players[i], 0, sizeof(out.players[i]));
+        if (!out.active[i])
+            continue;
+        for (int f = 0; f < PLAYER_FIELDS; f++)
+            out.players[i][f] = (unsigned short)readField(in, baseline.players[i][f], playerRanges[f].bits);
+    }
+}
+
+// the shared park: the single-player rides and ticket, and a player per slot
+class ParkSimulation {
+public:
+    unsigned tick;
+    Fence fence;
+    FerrisWheel ferrisWheel;
+    HotAirBalloon hotAirBalloon;
+    Swing swing;
+    Tree tree;
+    TicketStand ticketStand;
+    Ticket ticket;
+    Player players[MAX_NET_PLAYERS];
+    bool active[MAX_NET_PLAYERS];
+    int tickets[MAX_NET_PLAYERS];
+
+    ParkSimulation() : tick(0), ticketSpot(0) {
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            active[i] = false;
+            tickets[i] = 0;
+        }
+    }
+
+    void join(int id) {
+        active[id] = true;
+        players[id] = Player();
+        tickets[id] = 0;
+    }
+
+    void leave(int id) {
+        active[id] = false;
+    }
+
+    void step() {
+        tick++;
+        fence.evaluate(tick);
+        ferrisWheel.evaluate(tick);
+        hotAirBalloon.evaluate(tick);
+        swing.evaluate(tick);
+        tree.evaluate(tick);
+        ticketStand.evaluate(tick);
+        ticket.evaluate(tick);
+
+        // first come, first served; players on the ticket in the same tick
+        // take turns by slot so no slot always wins
+        for (int k = 0; k < MAX_NET_PLAYERS; k++) {
+            int i = (tick + k) % MAX_NET_PLAYERS;
+            if (active[i] && checkCollision(players[i], ticket)) {
+                tickets[i]++;
+                moveTicket();
+                break;
+            }
+        }
+    }
+
+    void capture(NetSnapshot& s) const {
+        s.tick = tick;
+        float rides[RIDE_FIELDS] = {
+            fence.r, fence.g, fence.b, ferrisWheel.rotationAngle, hotAirBalloon.translationY,
+            swing.rotationAngle, tree.scale, ticketStand.scale, ticket.translationX, ticket.posX, ticket.posZ
+        };
+        for (int f = 0; f < RIDE_FIELDS; f++)
+            s.rides[f] = (unsigned short)quantize(rides[f], rideRanges[f]);
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            s.active[i] = active[i];
+            if (!active[i]) {
+                memset(s.players[i], 0, sizeof(s.players[i]));
+                continue;
+            }
+            s.players[i][PLAYER_X] = (unsigned short)quantize(players[i].posX, playerRanges[PLAYER_X]);
+            s.players[i][PLAYER_Z] = (unsigned short)quantize(players[i].posZ, playerRanges[PLAYER_Z]);
+            s.players[i][PLAYER_ANGLE] = (unsigned short)quantize(players[i].rotY, playerRanges[PLAYER_ANGLE]);
+            s.players[i][PLAYER_TICKETS] = (unsigned short)quantize((float)tickets[i], playerRanges[PLAYER_TICKETS]);
+        }
+    }
+
+private:
+    int ticketSpot;
+
+    void moveTicket() {
+        static const float spots[4][2] = { { 0.3f, 0.3f }, { -0.3f, -0.25f }, { 0.25f, -0.35f }, { -0.2f, 0.3f } };
+        ticketSpot = (ticketSpot + 1) % 4;
+        ticket.posX = spots[ticketSpot][0];
+        ticket.posZ = spots[ticketSpot][1];
+    }
+};
+
+class ParkServer {
+public:
+    ParkSimulation park;
+    unsigned bytesSent, packetsSent;
+    double lastTickMs, totalTickMs;     // simulation and snapshot encoding
+    unsigned ticks;
+
+    ParkServer(NetSendFunction sendFunction, void* sendContext) : bytesSent(0), packetsSent(0), lastTickMs(0), totalTickMs(0), ticks(0),
+        send(sendFunction), context(sendContext) {
+        for (int i = 0; i < MAX_NET_PLAYERS; i++)
+            clients[i].connected = false;
+        for (int i = 0; i < SNAPSHOT_HISTORY; i++)
+            history[i].tick = ~0u;
+        memset(&empty, 0, sizeof(empty));
+    }
+
+    int clientCount() const {
+        int n = 0;
+        for (int i = 0; i < MAX_NET_PLAYERS; i++)
+            n += clients[i].connected;
+        return n;
+    }
+
+    unsigned clientBytes(int id) const {
+        return clients[id].bytesSent;
+    }
+
+    void receive(const NetAddress& from, const unsigned char* data, int size) {
+        BitReader in(data, size);
+        unsigned type = in.read(4);
+        int id = find(from);
+        if (type == NET_CONNECT) {
+            if (id < 0)
+                id = connect(from);
+            unsigned char reply[2];
+            BitWriter out(reply, sizeof(reply));
+            out.write(id < 0 ? NET_FULL : NET_WELCOME, 4);
+            out.write(id < 0 ? 0 : id, 6);
+            deliver(from, reply, out.finish(), id);
+            return;
+        }
+        if (type != NET_INPUT || id < 0)
+            return;
+
+        Client& c = clients[id];
+        bool acked = in.read(1) != 0;
+        unsigned ackedTick = in.read(32);
+        unsigned short first = (unsigned short)in.read(16);
+        int count = in.read(4);
+        unsigned char moves[MAX_PENDING_INPUTS];
+        for (int i = 0; i < count; i++)
+            moves[i] = (unsigned char)in.read(2);
+        if (in.overrun)
+            return;
+
+        c.lastHeard = park.tick;
+        if (acked && (!c.acked || ackedTick > c.ackedTick)) {
+            c.acked = true;
+            c.ackedTick = ackedTick;
+        }
+        // inputs are resent until acknowledged; keep only the new ones
+        for (int i = 0; i < count; i++) {
+            unsigned short sequence = (unsigned short)(first + i);
+            if (!sequenceAfter(sequence, c.inputSequence))
+                continue;
+            if (c.pendingCount < MAX_PENDING_INPUTS)
+                c.pending[c.pendingCount++] = moves[i];
+            c.inputSequence = sequence;
+        }
+    }
+
+    void tick() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            Client& c = clients[i];
+            if (!c.connected)
+                continue;
+            if (park.tick - c.lastHeard > (unsigned)NET_TIMEOUT_TICKS) {
+                c.connected = false;
+                park.leave(i);
+                continue;
+            }
+            for (int k = 0; k < c.pendingCount; k++)
+                movePlayer(park.players[i], (PlayerMove)c.pending[k]);
+            c.pendingCount = 0;
+        }
+        park.step();
+        if (park.tick % SNAPSHOT_INTERVAL == 0)
+            sendSnapshots();
+        lastTickMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        totalTickMs += lastTickMs;
+        ticks++;
+    }
+
+private:
+    struct Client {
+        bool connected;
+        NetAddress address;
+        unsigned lastHeard;
+        bool acked;
+        unsigned ackedTick;             // newest snapshot the client has
+        unsigned short inputSequence;   // newest input received
+        unsigned char pending[MAX_PENDING_INPUTS];
+        int pendingCount;
+        unsigned bytesSent;
+    };
+
+    NetSendFunction send;
+    void* context;
+    Client clients[MAX_NET_PLAYERS];
+    NetSnapshot history[SNAPSHOT_HISTORY];
+    NetSnapshot empty;
+    unsigned char packet[MAX_PACKET_SIZE];
+
+    int find(const NetAddress& address) const {
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            if (clients[i].connected && sameAddress(clients[i].address, address))
+                return i;
+        }
+        return -1;
+    }
+
+    int connect(const NetAddress& address) {
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            Client& c = clients[i];
+            if (c.connected)
+                continue;
+            c.connected = true;
+            c.address = address;
+            c.lastHeard = park.tick;
+            c.acked = false;
+            c.ackedTick = 0;
+            c.inputSequence = 0;
+            c.pendingCount = 0;
+            c.bytesSent = 0;
+            park.join(i);
+            return i;
+        }
+        return -1;
+    }
+
+    void deliver(const NetAddress& to, const unsigned char* data, int size, int id) {
+        send(context, to, data, size);
+        bytesSent += size;
+        packetsSent++;
+        if (id >= 0)
+            clients[id].bytesSent += size;
+    }
+
+    void sendSnapshots() {
+        NetSnapshot& current = history[park.tick / SNAPSHOT_INTERVAL % SNAPSHOT_HISTORY];
+        park.capture(current);
+        for (int i = 0; i < MAX_NET_PLAYERS; i++) {
+            Client& c = clients[i];
+            if (!c.connected)
+                continue;
+            // the acknowledged snapshot is the baseline while it is still
+            // in the history, otherwise everything is sent
+            const NetSnapshot* baseline = NULL;
+            if (c.acked) {
+                const NetSnapshot& s = history[c.ackedTick / SNAPSHOT_INTERVAL % SNAPSHOT_HISTORY];
+                if (s.tick == c.ackedTick)
+                    baseline = &s;
+            }
+            BitWriter out(packet, sizeof(packet));
+            out.write(NET_SNAPSHOT, 4);
+            out.write(current.tick, 32);
+            out.write(baseline != NULL, 1);
+            if (baseline)
+                out.write(baseline->tick, 32);
+            out.write(i, 6);
+            out.write(c.inputSequence, 16);
+            writeSnapshot(out, current, baseline ? *baseline : empty);
+            int size = out.finish();
+            if (!out.overflowed)
+                deliver(c.address, packet, size, i);
+        }
+    }
+};
+
+class ParkClient {
+public:
+    int playerId;           // -1 until the server has welcomed this client
+    bool rejected;          // the server is full
+    Player predicted;       // this client's player, ahead of the snapshots
+    unsigned bytesReceived, bytesSent, snapshotsReceived, snapshotsDropped;
+
+    ParkClient(NetSendFunction sendFunction, void* sendContext, const NetAddress& serverAddress)
+        : playerId(-1), rejected(false), bytesReceived(0), bytesSent(0), snapshotsReceived(0), snapshotsDropped(0),
+        send(sendFunction), context(sendContext), server(serverAddress), ticks(0), latestTick(0), renderTick(0),
+        nextSequence(1), pendingCount(0), inputsChanged(false) {
+        for (int i = 0; i < SNAPSHOT_HISTORY; i++)
+            received[i].tick = ~0u;
+    }
+
+    bool connected() const {
+        return playerId >= 0;
+    }
+
+    bool hasSnapshot() const {
+        return latestTick != 0;
+    }
+
+    void receive(const unsigned char* data, int size) {
+        bytesReceived += size;
+        BitReader in(data, size);
+        unsigned type = in.read(4);
+        if (type == NET_WELCOME) {
+            playerId = in.read(6);
+            return;
+        }
+        if (type == NET_FULL) {
+            rejected = true;
+            return;
+        }
+        if (type != NET_SNAPSHOT)
+            return;
+
+        unsigned tick = in.read(32);
+        const NetSnapshot* baseline = &empty();
+        if (in.read(1)) {
+            unsigned baselineTick = in.read(32);
+            baseline = find(baselineTick);
+            if (!baseline) {
+                snapshotsDropped++;
+                return;
+            }
+        }
+        playerId = in.read(6);
+        unsigned short inputAck = (unsigned short)in.read(16);
+        if (hasSnapshot() && tick <= latestTick) {
+            snapshotsDropped++;     // late or duplicate
+            return;
+        }
+        NetSnapshot& s = received[tick / SNAPSHOT_INTERVAL % SNAPSHOT_HISTORY];
+        NetSnapshot decoded;
+        readSnapshot(in, decoded, *baseline);
+        if (in.overrun) {
+            snapshotsDropped++;
+            return;
+        }
+        decoded.tick = tick;
+        s = decoded;
+        latestTick = tick;
+        snapshotsReceived++;
+        reconcile(s, inputAck);
+    }
+
+    // a move of this client's player: shown at once, confirmed by the server later
+    void move(PlayerMove m) {
+        if (!connected() || pendingCount == MAX_PENDING_INPUTS)
+            return;
+        movePlayer(predicted, m);
+        pending[pendingCount].sequence = nextSequence++;
+        pending[pendingCount].move = (unsigned char)m;
+        pendingCount++;
+        inputsChanged = true;
+    }
+
+    // once per simulation tick: connects, sends unconfirmed inputs and
+    // acknowledgements, and advances the interpolation clock
+    void update() {
+        ticks++;
+        if (!connected()) {
+            if (!rejected && ticks % NET_RETRY_TICKS == 1) {
+                unsigned char request[1];
+                BitWriter out(request, sizeof(request));
+                out.write(NET_CONNECT, 4);
+                transmit(request, out.finish());
+            }
+            return;
+        }
+        // inputs go out every tick until acknowledged; a heartbeat otherwise
+        if (pendingCount > 0 || inputsChanged || ticks % SNAPSHOT_INTERVAL == 0)
+            sendInputs();
+        inputsChanged = false;
+
+        renderTick += 1;
+        float target = (float)latestTick - INTERPOLATION_DELAY;
+        if (renderTick > latestTick || renderTick < target - 2 * SNAPSHOT_INTERVAL)
+            renderTick = target;
+    }
+
+    bool playerActive(int id) const {
+        const NetSnapshot* s = find(latestTick);
+        return s && s->active[id];
+    }
+
+    int playerTickets(int id) const {
+        const NetSnapshot* s = find(latestTick);
+        return s ? (int)dequantize(s->players[id][PLAYER_TICKETS], playerRanges[PLAYER_TICKETS]) : 0;
+    }
+
+    // another player as of the render time; this client's own is predicted
+    Player player(int id) const {
+        if (id == playerId)
+            return predicted;
+        Player p;
+        const NetSnapshot* a;
+        const NetSnapshot* b;
+        float t = bracket(a, b);
+        if (!a)
+            return p;
+        p.posX = lerp(a->players[id][PLAYER_X], b->players[id][PLAYER_X], t, playerRanges[PLAYER_X]);
+        p.posZ = lerp(a->players[id][PLAYER_Z], b->players[id][PLAYER_Z], t, playerRanges[PLAYER_Z]);
+        // facing snaps rather than turning through the in-between angles
+        p.rotY = dequantize((t < 0.5f ? a : b)->players[id][PLAYER_ANGLE], playerRanges[PLAYER_ANGLE]);
+        return p;
+    }
+
+    float ride(RideField field) const {
+        const NetSnapshot* a;
+        const NetSnapshot* b;
+        float t = bracket(a, b);
+        if (!a)
+            return dequantize(0, rideRanges[field]);
+        if (field == RIDE_WHEEL_ANGLE) {
+            // the wheel wraps from 360 to 0
+            float from = dequantize(a->rides[field], rideRanges[field]);
+            float to = dequantize(b->rides[field], rideRanges[field]);
+            if (to < from - 180)
+                to += 360;
+            float angle = from + (to - from) * t;
+            return angle >= 360 ? angle - 360 : angle;
+        }
+        if (field == RIDE_TICKET_X || field == RIDE_TICKET_Z)
+            return dequantize(b->rides[field], rideRanges[field]);     // jumps, never slides
+        return lerp(a->rides[field], b->rides[field], t, rideRanges[field]);
+    }
+
+private:
+    struct Input {
+        unsigned short sequence;
+        unsigned char move;
+    };
+
+    NetSendFunction send;
+    void* context;
+    NetAddress server;
+    unsigned ticks;
+    NetSnapshot received[SNAPSHOT_HISTORY];
+    unsigned latestTick;
+    float renderTick;
+    unsigned short nextSequence;
+    Input pending[MAX_PENDING_INPUTS];
+    int pendingCount;
+    bool inputsChanged;
+
+    static const NetSnapshot& empty() {
+        static NetSnapshot zero;    // zero-initialized
+        return zero;
+    }
+
+    const NetSnapshot* find(unsigned tick) const {
+        if (tick == 0)
+            return NULL;
+        const NetSnapshot& s = received[tick / SNAPSHOT_INTERVAL % SNAPSHOT_HISTORY];
+        return s.tick == tick ? &s : NULL;
+    }
+
+    // the snapshots on either side of the render time and how far between
+    float bracket(const NetSnapshot*& a, const NetSnapshot*& b) const {
+        float clamped = renderTick < 0 ? 0 : renderTick;
+        unsigned before = (unsigned)clamped / SNAPSHOT_INTERVAL * SNAPSHOT_INTERVAL;
+        a = find(before);
+        b = find(before + SNAPSHOT_INTERVAL);
+        if (!a) {
+            a = b ? b : find(latestTick);
+            b = a;
+            return 0;
+        }
+        if (!b) {
+            b = a;
+            return 0;
+        }
+        return (clamped - before) / SNAPSHOT_INTERVAL;
+    }
+
+    static float lerp(unsigned qa, unsigned qb, float t, const NetRange& range) {
+        float a = dequantize(qa, range);
+        return a + (dequantize(qb, range) - a) * t;
+    }
+
+    // the server's position of this client's player plus the inputs it had
+    // not applied yet
+    void reconcile(const NetSnapshot& s, unsigned short inputAck) {
+        if (playerId < 0 || !s.active[playerId])
+            return;
+        int kept = 0;
+        for (int i = 0; i < pendingCount; i++) {
+            if (sequenceAfter(pending[i].sequence, inputAck))
+                pending[kept++] = pending[i];
+        }
+        pendingCount = kept;
+        predicted.posX = dequantize(s.players[playerId][PLAYER_X], playerRanges[PLAYER_X]);
+        predicted.posZ = dequantize(s.players[playerId][PLAYER_Z], playerRanges[PLAYER_Z]);
+        predicted.rotY = dequantize(s.players[playerId][PLAYER_ANGLE], playerRanges[PLAYER_ANGLE]);
+        for (int i = 0; i < pendingCount; i++)
+            movePlayer(predicted, (PlayerMove)pending[i].move);
+    }
+
+    void sendInputs() {
+        unsigned char packet[16];
+        BitWriter out(packet, sizeof(packet));
+        out.write(NET_INPUT, 4);
+        out.write(hasSnapshot(), 1);
+        out.write(latestTick, 32);
+        out.write(pendingCount > 0 ? pending[0].sequence : (unsigned short)(nextSequence - 1), 16);
+        out.write(pendingCount, 4);
+        for (int i = 0; i < pendingCount; i++)
+            out.write(pending[i].move, 2);
+        transmit(packet, out.finish());
+    }
+
+    void transmit(const unsigned char* data, int size) {
+        send(context, server, data, size);
+        bytesSent += size;
+    }
+};
+
+#endif
@@ -0,0 +1,128 @@
+// Capacity planning: how many visitors an hour the ticket stand and the
+// rides can serve, from the headless simulation in ParkSim.h.
+//
+//     park_sim [--rate visitors/hour] [--hours h] [--replications n]
+//              [--threads n] [--seed s]
+//
+// Every replication is an independent run of the park with its own random
+// numbers; they are spread over the job system's threads and the table
+// shows each statistic's mean over them with a 95% confidence interval.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "ParkSim.h"
+#include "JobSystem.h"
+
+JobSystem jobs;
+
+struct Replications {
+    SimConfig config;
+    std::vector<SimResult> results;
+};
+
+void runReplications(void* data, int begin, int end) {
+    Replications* r = (Replications*)data;
+    for (int i = begin; i < end; i++) {
+        SimConfig config = r->config;
+        config.seed = r->config.seed + i;
+        ThroughputSimulation simulation(config);
+        r->results[i] = simulation.run();
+    }
+}
+
+// mean and half-width of its 95% interval, normal approximation
+void summarize(const std::vector<double>& values, double& mean, double& halfWidth) {
+    double n = (double)values.size(), sum = 0, squares = 0;
+    for (size_t i = 0; i < values.size(); i++)
+        sum += values[i];
+    mean = sum / n;
+    for (size_t i = 0; i < values.size(); i++)
+        squares += (values[i] - mean) * (values[i] - mean);
+    halfWidth = n > 1 ? 1.96 * sqrt(squares / (n - 1) / n) : 0;
+}
+
+void printColumn(const std::vector<double>& values) {
+    double mean, halfWidth;
+    summarize(values, mean, halfWidth);
+    printf(" %9.1f +-%6.1f", mean, halfWidth);
+}
+
+int main(int argc, char** argv) {
+    Replications r;
+    r.config = defaultSimConfig();
+    int replications = 16;
+    int threads = JobSystem::defaultThreadCount();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            r.config.arrivalsPerHour = atof(argv[++i]);
+        else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc)
+            r.config.hours = atof(argv[++i]);
+        else if (strcmp(argv[i], "--replications") == 0 && i + 1 < argc)
+            replications = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            r.config.seed = (unsigned)atoi(argv[++i]);
+        else {
+            printf("usage: park_sim [--rate visitors/hour] [--hours h] [--replications n] [--threads n] [--seed s]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (replications < 1 || r.config.hours <= 0 || r.config.arrivalsPerHour <= 0) {
+        printf("nothing to simulate\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int a = 0; a < SIM_ATTRACTIONS; a++) {
+        const AttractionModel& m = r.config.attractions[a];
+        double capacity = 3600.0 * m.servers * m.seats / (m.serviceSeconds + m.loadSeconds);
+        printf("%-16s %d x %2d seats, %5.0f s a run, wanted by %3.0f%%, capacity %6.0f an hour\n",
+            simAttractionNames[a], m.servers, m.seats, m.serviceSeconds + m.loadSeconds, 100 * m.popularity, capacity);
+    }
+    printf("%.0f visitors an hour, %d replications of %.0f hours on %d threads\n\n",
+        r.config.arrivalsPerHour, replications, r.config.hours, threads);
+
+    r.results.resize(replications);
+    jobs.start(threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    jobs.parallelFor(replications, 1, runReplications, &r);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    jobs.stop();
+
+    printf("%-16s %17s %17s %17s %17s %17s %17s\n", "", "served/hour", "mean wait s", "max wait s", "mean queue", "max queue", "utilization %");
+    for (int a = 0; a < SIM_ATTRACTIONS; a++) {
+        const AttractionModel& m = r.config.attractions[a];
+        std::vector<double> columns[6];
+        for (int i = 0; i < replications; i++) {
+            const QueueStats& q = r.results[i].attractions[a];
+            double hours = r.results[i].seconds / 3600;
+            columns[0].push_back(q.served / hours);
+            columns[1].push_back(q.served ? q.waitSum / q.served : 0);
+            columns[2].push_back(q.waitMax);
+            columns[3].push_back(q.queueArea / r.results[i].seconds);
+            columns[4].push_back(q.queueMax);
+            columns[5].push_back(100 * q.seatSeconds / (r.results[i].seconds * m.servers * m.seats));
+        }
+        printf("%-16s", simAttractionNames[a]);
+        for (int c = 0; c < 6; c++)
+            printColumn(columns[c]);
+        printf("\n");
+    }
+
+    double visitorHours = 0, events = 0;
+    std::vector<double> inPark;
+    for (int i = 0; i < replications; i++) {
+        visitorHours += r.results[i].visitorSeconds / 3600;
+        events += r.results[i].events;
+        inPark.push_back(r.results[i].visitorSeconds / r.results[i].seconds);
+    }
+    double mean, halfWidth;
+    summarize(inPark, mean, halfWidth);
+    printf("\nvisitors in the park %.1f +-%.1f; %.0f visitor-hours and %.0f events in %.2f s (%.1f million events/s)\n",
+        mean, halfWidth, visitorHours, events, seconds, events / seconds / 1e6);
+    return 0;
+}
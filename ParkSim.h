@@ -0,0 +1,390 @@
+#ifndef PARK_SIM_H
+#define PARK_SIM_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "Park.h"
+
+// Headless discrete-event simulation of how many visitors the park can
+// serve. Visitors arrive at random, queue at the ticket stand, then walk to
+// and queue for the rides they want; a ride takes a full load of whoever
+// is waiting each time it stops. Nothing is drawn and time jumps from one
+// event to the next, so an hour of park time costs microseconds.
+//
+// The service times come from the attractions in Park.h: each ride's cycle
+// is the period of its oscillator (or turn) in ticks, with one
+// tick standing for one second of park time (on screen the rides run 60
+// times faster than they would for real).
+//
+// Events are kept in a binary heap of 16-byte keys, ordered by time and
+// then by the order they were scheduled, so equal times run first come,
+// first served and a replication is the same on every run. Events and
+// visitors come from pools that only grow until the park reaches its
+// steady state.
+
+enum SimAttraction {
+    SIM_TICKET_STAND,
+    SIM_FERRIS_WHEEL,
+    SIM_SWING,
+    SIM_HOT_AIR_BALLOON,
+    SIM_ATTRACTIONS
+};
+
+const char* const simAttractionNames[SIM_ATTRACTIONS] = { "ticket stand", "Ferris wheel", "swing", "hot air balloon" };
+
+const double PARK_SECONDS_PER_TICK = 1.0;
+const int SIM_MAX_SERVERS = 8;
+const int SIM_MAX_SEATS = 32;
+
+struct AttractionModel {
+    int servers;            // ticket windows; rides run one at a time
+    int seats;              // visitors per run
+    double serviceSeconds;  // mean per sale or per ride
+    bool randomService;     // exponential, or always serviceSeconds
+    double loadSeconds;     // boarding before each ride
+    double popularity;      // chance a visitor wants to ride it
+};
+
+struct SimConfig {
+    double arrivalsPerHour;
+    double hours;           // measured, after the warm-up
+    double warmupHours;     // to fill the queues before measuring
+    double walkSeconds;     // mean, between two attractions
+    unsigned seed;
+    AttractionModel attractions[SIM_ATTRACTIONS];
+};
+
+// one sale takes a pulse of the ticket stand on average, a Ferris wheel
+// ride is two turns, a swing ride six swings and a balloon flight twenty
+// bobs; every ride can carry more than the visitors who want it. The
+// default run (16 replications) covers over a million visitor-hours.
+inline SimConfig defaultSimConfig() {
+    double sale = TicketStand().pulse.period;
+    double turn = FerrisWheel().turnTicks();
+    double swing = Swing().swinging.period;
+    double bob = HotAirBalloon().bob.period;
+
+    SimConfig c;
+    c.arrivalsPerHour = 240;
+    c.hours = 1100;
+    c.warmupHours = 2;
+    c.walkSeconds = 120;
+    c.seed = 1;
+    AttractionModel ticketStand = { 4, 1, sale * PARK_SECONDS_PER_TICK, true, 0, 1.0 };
+    AttractionModel ferrisWheel = { 1, 32, 2 * turn * PARK_SECONDS_PER_TICK, false, 60, 0.8 };
+    AttractionModel swingRide = { 1, 12, 6 * swing * PARK_SECONDS_PER_TICK, false, 45, 0.6 };
+    AttractionModel balloon = { 1, 8, 20 * bob * PARK_SECONDS_PER_TICK, false, 30, 0.3 };
+    c.attractions[SIM_TICKET_STAND] = ticketStand;
+    c.attractions[SIM_FERRIS_WHEEL] = ferrisWheel;
+    c.attractions[SIM_SWING] = swingRide;
+    c.attractions[SIM_HOT_AIR_BALLOON] = balloon;
+    return c;
+}
+
+struct QueueStats {
+    unsigned long served;
+    double waitSum;         // seconds
+    double waitMax;
+    double queueArea;       // visitor-seconds spent queueing
+    int queueMax;
+    double seatSeconds;     // occupied seats times ride time, for utilization
+};
+
+struct SimResult {
+    QueueStats attractions[SIM_ATTRACTIONS];
+    unsigned long arrivals;
+    unsigned long events;
+    double visitorSeconds;  // time spent in the park by all visitors
+    double seconds;         // measured
+};
+
+// one replication; independent of every other, so they can run in parallel
+class ThroughputSimulation {
+public:
+    ThroughputSimulation(const SimConfig& c) : config(c), now(0), sequence(0), inPark(0), lastChange(0) {
+        rng = c.seed * 2654435761u + 0x9e3779b9u;
+        if (rng == 0)
+            rng = 1;
+        memset(&result, 0, sizeof(result));
+        for (int a = 0; a < SIM_ATTRACTIONS; a++) {
+            Attraction& at = attractions[a];
+            at.head = 0;
+            at.count = 0;
+            for (int s = 0; s < SIM_MAX_SERVERS; s++) {
+                at.riders[s] = 0;
+                at.running[s] = false;
+            }
+        }
+    }
+
+    const SimResult& run() {
+        double warmup = config.warmupHours * 3600, end = warmup + config.hours * 3600;
+        schedule(exponential(3600 / config.arrivalsPerHour), SIM_ARRIVAL, 0, 0, 0);
+        schedule(warmup, SIM_START_MEASURING, 0, 0, 0);
+        while (!heap.empty()) {
+            HeapKey next = pop();
+            if (next.time > end)
+                break;
+            advanceTo(next.time);
+            Event e = events[next.event];
+            freeEvents.push_back(next.event);
+            result.events++;
+            handle(e);
+        }
+        advanceTo(end);
+        result.seconds = config.hours * 3600;
+        return result;
+    }
+
+private:
+    enum EventType {
+        SIM_ARRIVAL,
+        SIM_JOIN,           // a visitor reaches an attraction's queue
+        SIM_FINISHED,       // a sale or a ride is over
+        SIM_START_MEASURING
+    };
+
+    struct Event {
+        int type;
+        int attraction;
+        int server;
+        int visitor;
+    };
+
+    // what the heap moves around: the ordering and where the event is
+    struct HeapKey {
+        double time;
+        unsigned sequence;
+        unsigned event;
+    };
+
+    struct Visitor {
+        double arrived;
+        double queued;
+        unsigned wanted;    // rides still to go on, one bit each
+        int next;           // free list
+    };
+
+    struct Attraction {
+        std::vector<int> queue;     // ring
+        int head, count;
+        int riders[SIM_MAX_SERVERS];
+        int seated[SIM_MAX_SERVERS][SIM_MAX_SEATS];
+        bool running[SIM_MAX_SERVERS];
+    };
+
+    SimConfig config;
+    SimResult result;
+    double now;
+    unsigned sequence;
+    unsigned rng;
+    std::vector<HeapKey> heap;
+    std::vector<Event> events;
+    std::vector<unsigned> freeEvents;
+    std::vector<Visitor> visitors;
+    int freeVisitor = -1;
+    int inPark;
+    double lastChange;
+    bool measuring = false;
+    Attraction attractions[SIM_ATTRACTIONS];
+
+    double uniform() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return (rng >> 8) * (1.0 / 16777216.0);
+    }
+
+    double exponential(double mean) {
+        return -mean * log(1.0 - uniform());
+    }
+
+    // queue lengths and the visitors in the park only change at events
+    void advanceTo(double time) {
+        if (measuring) {
+            double dt = time - lastChange;
+            result.visitorSeconds += inPark * dt;
+            for (int a = 0; a < SIM_ATTRACTIONS; a++)
+                result.attractions[a].queueArea += attractions[a].count * dt;
+        }
+        lastChange = time;
+        now = time;
+    }
+
+    void schedule(double time, int type, int attraction, int server, int visitor) {
+        unsigned slot;
+        if (freeEvents.empty()) {
+            slot = (unsigned)events.size();
+            events.push_back(Event());
+        }
+        else {
+            slot = freeEvents.back();
+            freeEvents.pop_back();
+        }
+        Event& e = events[slot];
+        e.type = type;
+        e.attraction = attraction;
+        e.server = server;
+        e.visitor = visitor;
+
+        HeapKey key = { time, sequence++, slot };
+        size_t i = heap.size();
+        heap.push_back(key);
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!earlier(key, heap[parent]))
+                break;
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = key;
+    }
+
+    HeapKey pop() {
+        HeapKey top = heap[0];
+        HeapKey last = heap.back();
+        heap.pop_back();
+        size_t n = heap.size(), i = 0;
+        if (n > 0) {
+            for (;;) {
+                size_t child = 2 * i + 1;
+                if (child >= n)
+                    break;
+                if (child + 1 < n && earlier(heap[child + 1], heap[child]))
+                    child++;
+                if (!earlier(heap[child], last))
+                    break;
+                heap[i] = heap[child];
+                i = child;
+            }
+            heap[i] = last;
+        }
+        return top;
+    }
+
+    static bool earlier(const HeapKey& a, const HeapKey& b) {
+        return a.time < b.time || (a.time == b.time && a.sequence < b.sequence);
+    }
+
+    int newVisitor() {
+        if (freeVisitor < 0) {
+            visitors.push_back(Visitor());
+            return (int)visitors.size() - 1;
+        }
+        int v = freeVisitor;
+        freeVisitor = visitors[v].next;
+        return v;
+    }
+
+    void handle(const Event& e) {
+        switch (e.type) {
+        case SIM_ARRIVAL: {
+            schedule(now + exponential(3600 / config.arrivalsPerHour), SIM_ARRIVAL, 0, 0, 0);
+            int v = newVisitor();
+            Visitor& visitor = visitors[v];
+            visitor.arrived = now;
+            visitor.wanted = 0;
+            for (int a = SIM_TICKET_STAND + 1; a < SIM_ATTRACTIONS; a++) {
+                if (uniform() < config.attractions[a].popularity)
+                    visitor.wanted |= 1u << a;
+            }
+            inPark++;
+            if (measuring)
+                result.arrivals++;
+            join(SIM_TICKET_STAND, v);
+            break;
+        }
+        case SIM_JOIN:
+            join(e.attraction, e.visitor);
+            break;
+        case SIM_FINISHED:
+            finish(e.attraction, e.server);
+            break;
+        case SIM_START_MEASURING:
+            measuring = true;
+            break;
+        }
+    }
+
+    void join(int a, int v) {
+        Attraction& at = attractions[a];
+        if (at.count == (int)at.queue.size()) {
+            // unwrap into a ring twice the size
+            std::vector<int> bigger(at.queue.empty() ? 64 : at.queue.size() * 2);
+            for (int i = 0; i < at.count; i++)
+                bigger[i] = at.queue[(at.head + i) % at.queue.size()];
+            at.queue.swap(bigger);
+            at.head = 0;
+        }
+        at.queue[(at.head + at.count) % at.queue.size()] = v;
+        at.count++;
+        visitors[v].queued = now;
+        if (measuring && at.count > result.attractions[a].queueMax)
+            result.attractions[a].queueMax = at.count;
+        dispatch(a);
+    }
+
+    // every free server takes as many as it seats from the front of the queue
+    void dispatch(int a) {
+        Attraction& at = attractions[a];
+        const AttractionModel& model = config.attractions[a];
+        for (int s = 0; s < model.servers && at.count > 0; s++) {
+            if (at.running[s])
+                continue;
+            int riders = at.count < model.seats ? at.count : model.seats;
+            QueueStats& stats = result.attractions[a];
+            for (int i = 0; i < riders; i++) {
+                int v = at.queue[at.head];
+                at.head = (at.head + 1) % (int)at.queue.size();
+                at.count--;
+                at.seated[s][i] = v;
+                if (measuring) {
+                    double wait = now - visitors[v].queued;
+                    stats.served++;
+                    stats.waitSum += wait;
+                    if (wait > stats.waitMax)
+                        stats.waitMax = wait;
+                }
+            }
+            double duration = (model.randomService ? exponential(model.serviceSeconds) : model.serviceSeconds) + model.loadSeconds;
+            if (measuring)
+                stats.seatSeconds += riders * duration;
+            at.riders[s] = riders;
+            at.running[s] = true;
+            schedule(now + duration, SIM_FINISHED, a, s, 0);
+        }
+    }
+
+    // the riders walk on to the next ride they want, or go home
+    void finish(int a, int s) {
+        Attraction& at = attractions[a];
+        for (int i = 0; i < at.riders[s]; i++) {
+            int v = at.seated[s][i];
+            Visitor& visitor = visitors[v];
+            if (visitor.wanted == 0) {
+                inPark--;
+                visitor.next = freeVisitor;
+                freeVisitor = v;
+                continue;
+            }
+            // the wanted rides in a random order
+            int choices = 0, order[SIM_ATTRACTIONS];
+            for (int r = 0; r < SIM_ATTRACTIONS; r++) {
+                if (visitor.wanted & (1u << r))
+                    order[choices++] = r;
+            }
+            int next = order[(int)(uniform() * choices)];
+            visitor.wanted &= ~(1u << next);
+            schedule(now + exponential(config.walkSeconds), SIM_JOIN, next, 0, v);
+        }
+        at.riders[s] = 0;
+        at.running[s] = false;
+        dispatch(a);
+    }
+
+    ThroughputSimulation(const ThroughputSimulation&);
+    ThroughputSimulation& operator=(const ThroughputSimulation&);
+};
+
+#endif
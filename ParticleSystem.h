@@ -0,0 +1,205 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <math.h>
+#include "ParkMath.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PARTICLES_SSE 1
+#endif
+
+// Fixed pool of particles stored as one array per attribute, so the
+// integration step runs four particles per SSE instruction. Live particles
+// are kept packed at the front of the arrays: a dead particle is replaced by
+// the last live one. Nothing is allocated after construction; the object is
+// several megabytes, so keep it global or static.
+
+const int PARTICLE_CAPACITY = 100000;   // must be a multiple of 4
+
+struct ParticleVertex {
+    float x, y, z;
+    unsigned char r, g, b, a;
+};
+
+class ParticleSystem {
+public:
+    float gravity;
+
+    ParticleSystem() : gravity(-0.5f), count(0), seed(0x2545F491u) {}
+
+    int size() const {
+        return count;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    // round burst of sparks, e.g. a firework shell
+    void burst(const Vector3f& origin, int n, float speed, float lifetime,
+        unsigned char r, unsigned char g, unsigned char b) {
+        for (int i = 0; i < n && count < PARTICLE_CAPACITY; i++) {
+            // uniform direction on the sphere
+            float z = random(-1, 1);
+            float angle = random(0, 6.2831853f);
+            float radius = sqrt(1 - z * z);
+            float s = speed * random(0.85f, 1.0f);
+            spawn(origin, Vector3f(radius * cos(angle) * s, z * s, radius * sin(angle) * s),
+                lifetime * random(0.7f, 1.0f), 1.2f, r, g, b);
+        }
+    }
+
+    // upward fountain of slow, many-colored flakes
+    void confetti(const Vector3f& origin, int n, float speed, float lifetime) {
+        static const unsigned char palette[6][3] = {
+            { 255, 60, 60 }, { 255, 220, 40 }, { 60, 220, 90 },
+            { 60, 140, 255 }, { 220, 90, 255 }, { 255, 255, 255 }
+        };
+        for (int i = 0; i < n && count < PARTICLE_CAPACITY; i++) {
+            const unsigned char* c = palette[next() % 6];
+            Vector3f velocity(random(-0.3f, 0.3f) * speed, random(0.7f, 1.0f) * speed, random(-0.3f, 0.3f) * speed);
+            spawn(origin, velocity, lifetime * random(0.6f, 1.0f), 2.5f, c[0], c[1], c[2]);
+        }
+    }
+
+    // advances every particle by dt seconds and drops the expired ones;
+    // returns false when there was nothing to update
+    bool update(float dt) {
+        if (count == 0)
+            return false;
+        int padded = (count + 3) & ~3;
+        int firstExpired = count;     // only the tail from here on is compacted
+
+#ifdef PARTICLES_SSE
+        __m128 dtv = _mm_set1_ps(dt);
+        __m128 fall = _mm_set1_ps(gravity * dt);
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 zero = _mm_setzero_ps();
+        for (int i = 0; i < padded; i += 4) {
+            __m128 damping = _mm_sub_ps(one, _mm_mul_ps(_mm_load_ps(drag + i), dtv));
+            __m128 vxi = _mm_mul_ps(_mm_load_ps(vx + i), damping);
+            __m128 vyi = _mm_add_ps(_mm_mul_ps(_mm_load_ps(vy + i), damping), fall);
+            __m128 vzi = _mm_mul_ps(_mm_load_ps(vz + i), damping);
+            _mm_store_ps(vx + i, vxi);
+            _mm_store_ps(vy + i, vyi);
+            _mm_store_ps(vz + i, vzi);
+            _mm_store_ps(px + i, _mm_add_ps(_mm_load_ps(px + i), _mm_mul_ps(vxi, dtv)));
+            _mm_store_ps(py + i, _mm_add_ps(_mm_load_ps(py + i), _mm_mul_ps(vyi, dtv)));
+            _mm_store_ps(pz + i, _mm_add_ps(_mm_load_ps(pz + i), _mm_mul_ps(vzi, dtv)));
+            __m128 left = _mm_sub_ps(_mm_load_ps(life + i), dtv);
+            _mm_store_ps(life + i, left);
+            if (_mm_movemask_ps(_mm_cmple_ps(left, zero)) && i < firstExpired)
+                firstExpired = i;
+        }
+#else
+        float fall = gravity * dt;
+        for (int i = 0; i < padded; i++) {
+            float damping = 1 - drag[i] * dt;
+            vx[i] *= damping;
+            vy[i] = vy[i] * damping + fall;
+            vz[i] *= damping;
+            px[i] += vx[i] * dt;
+            py[i] += vy[i] * dt;
+            pz[i] += vz[i] * dt;
+            life[i] -= dt;
+            if (life[i] <= 0 && i < firstExpired)
+                firstExpired = i;
+        }
+#endif
+
+        for (int i = firstExpired; i < count;) {
+            if (life[i] > 0)
+                i++;
+            else
+                moveLast(i);
+        }
+        return true;
+    }
+
+    // writes the live particles as points, fading out over their lifetime;
+    // returns the number of vertices written
+    int fillVertices(ParticleVertex* out) const {
+        for (int i = 0; i < count; i++) {
+            float fade = life[i] * invLifetime[i];
+            out[i].x = px[i];
+            out[i].y = py[i];
+            out[i].z = pz[i];
+            out[i].r = r[i];
+            out[i].g = g[i];
+            out[i].b = b[i];
+            out[i].a = (unsigned char)(fade > 1 ? 255 : fade * 255);
+        }
+        return count;
+    }
+
+private:
+    int count;
+    unsigned seed;
+
+#ifdef _MSC_VER
+#define PARTICLE_ALIGN __declspec(align(16))
+#else
+#define PARTICLE_ALIGN __attribute__((aligned(16)))
+#endif
+    PARTICLE_ALIGN float px[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float py[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float pz[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float vx[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float vy[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float vz[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float drag[PARTICLE_CAPACITY];
+    PARTICLE_ALIGN float life[PARTICLE_CAPACITY];
+    float invLifetime[PARTICLE_CAPACITY];
+    unsigned char r[PARTICLE_CAPACITY];
+    unsigned char g[PARTICLE_CAPACITY];
+    unsigned char b[PARTICLE_CAPACITY];
+#undef PARTICLE_ALIGN
+
+    // xorshift, so bursts are the same on every run and in replays
+    unsigned next() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    float random(float low, float high) {
+        return low + (high - low) * (next() & 0xFFFFFF) / 16777216.0f;
+    }
+
+    void spawn(const Vector3f& p, const Vector3f& v, float lifetime, float d,
+        unsigned char red, unsigned char green, unsigned char blue) {
+        int i = count++;
+        px[i] = p.x;
+        py[i] = p.y;
+        pz[i] = p.z;
+        vx[i] = v.x;
+        vy[i] = v.y;
+        vz[i] = v.z;
+        drag[i] = d;
+        life[i] = lifetime;
+        invLifetime[i] = 1 / lifetime;
+        r[i] = red;
+        g[i] = green;
+        b[i] = blue;
+    }
+
+    void moveLast(int i) {
+        int last = --count;
+        px[i] = px[last];
+        py[i] = py[last];
+        pz[i] = pz[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        vz[i] = vz[last];
+        drag[i] = drag[last];
+        life[i] = life[last];
+        invLifetime[i] = invLifetime[last];
+        r[i] = r[last];
+        g[i] = g[last];
+        b[i] = b[last];
+    }
+};
+
+#endif
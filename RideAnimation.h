@@ -0,0 +1,272 @@
+#ifndef RIDE_ANIMATION_H
+#define RIDE_ANIMATION_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Park.h"
+#include "Camera.h"
+
+// The rides as the ride shader sees them: an animated instance carries its
+// placement, a pivot, an axis and the curve of its Park.h class, and its
+// pose at any tick follows from those alone. RideShader.h evaluates the
+// curves in a vertex shader, so ride geometry can be recorded once at rest
+// and moved by a single time uniform; rideValue() and placeRidePoint() are
+// the CPU side of it. AnimationLod below decides which rides the CPU
+// evaluates each tick.
+
+enum RideMotion {
+    MOTION_STILL,       // placed, not moved
+    MOTION_TURN,        // value degrees about the axis through the pivot
+    MOTION_SHIFT,       // value times the axis
+    MOTION_SCALE        // uniformly by value about the pivot
+};
+
+enum RideCurveKind {
+    CURVE_SPIN,         // start + rate * ticks, wrapped to [0, wrap)
+    CURVE_LINEAR,       // an Oscillator, by its easing
+    CURVE_SINE
+};
+
+// the four vec4 attributes of the ride shader, in this order
+struct RideInstance {
+    float place[4];     // geometry is scaled by w and moved by xyz first
+    float pivot[4];     // w: RideMotion
+    float axis[4];      // w: RideCurveKind
+    float curve[4];     // start, rate, wrap or center, amplitude, period, phase
+};
+
+// the ride's value at ticks; both modulos keep the shader's float time
+// exact for as long as the tick count itself is
+inline float rideValue(const RideInstance& r, double ticks) {
+    const float* c = r.curve;
+    int kind = (int)r.axis[3];
+    if (kind == CURVE_SPIN) {
+        double v = fmod(c[0] + c[1] * fmod(ticks, c[2] / c[1]), c[2]);
+        return (float)(v < 0 ? v + c[2] : v);
+    }
+    Oscillator o = { c[0], c[1], c[2], c[3], kind == CURVE_SINE ? EASE_SINE : EASE_LINEAR };
+    return o.at(ticks);
+}
+
+// where a world-space point of the rest pose is after ticks
+inline void placeRidePoint(const RideInstance& r, double ticks, const float* in, float* out) {
+    float p[3], arm[3];
+    for (int i = 0; i < 3; i++) {
+        p[i] = in[i] * r.place[3] + r.place[i];
+        arm[i] = p[i] - r.pivot[i];
+    }
+    float v = rideValue(r, ticks);
+    switch ((int)r.pivot[3]) {
+    case MOTION_TURN: {
+        Vector3f k = Vector3f(r.axis[0], r.axis[1], r.axis[2]).unit();
+        Vector3f a(arm[0], arm[1], arm[2]);
+        float c = (float)cos(DEG2RAD(v)), s = (float)sin(DEG2RAD(v));
+        Vector3f turned = a * c + k.cross(a) * s + k * (k.dot(a) * (1 - c));
+        p[0] = r.pivot[0] + turned.x;
+        p[1] = r.pivot[1] + turned.y;
+        p[2] = r.pivot[2] + turned.z;
+        break;
+    }
+    case MOTION_SHIFT:
+        for (int i = 0; i < 3; i++)
+            p[i] += r.axis[i] * v;
+        break;
+    case MOTION_SCALE:
+        for (int i = 0; i < 3; i++)
+            p[i] = r.pivot[i] + arm[i] * v;
+        break;
+    }
+    for (int i = 0; i < 3; i++)
+        out[i] = p[i];
+}
+
+inline RideInstance rideInstance(RideMotion motion, const Vector3f& pivot, const Vector3f& axis,
+    RideCurveKind kind, const float* curve) {
+    RideInstance r = {
+        { 0, 0, 0, 1 },
+        { pivot.x, pivot.y, pivot.z, (float)motion },
+        { axis.x, axis.y, axis.z, (float)kind },
+        { curve[0], curve[1], curve[2], curve[3] }
+    };
+    return r;
+}
+
+inline RideInstance spinningInstance(RideMotion motion, const Vector3f& pivot, const Vector3f& axis, const FerrisWheel& wheel) {
+    float curve[4] = { 0, wheel.degreesPerTick, 360, 0 };
+    return rideInstance(motion, pivot, axis, CURVE_SPIN, curve);
+}
+
+inline RideInstance oscillatingInstance(RideMotion motion, const Vector3f& pivot, const Vector3f& axis, const Oscillator& o) {
+    float curve[4] = { o.center, o.amplitude, o.period, o.phase };
+    return rideInstance(motion, pivot, axis, o.easing == EASE_SINE ? CURVE_SINE : CURVE_LINEAR, curve);
+}
+
+// count balloons drifting in rings round the park, each bobbing on a curve
+// of its own around bob; for trying the ride shader at scale
+inline void balloonFlotilla(RideInstance* out, int count, const Oscillator& bob, float scale) {
+    for (int i = 0; i < count; i++) {
+        unsigned h = (unsigned)i * 2654435761u;
+        float angle = i * 2.39996323f;     // the golden angle
+        float radius = 1.2f + 0.02f * sqrtf((float)i);
+        Oscillator o = bob;
+        o.amplitude *= 1 + (h >> 8 & 255) / 255.0f;
+        o.period *= 1 + (h >> 16 & 255) / 512.0f;
+        o.phase = (float)(h >> 24);
+        RideInstance& r = out[i];
+        r = oscillatingInstance(MOTION_SHIFT, Vector3f(), Vector3f(0, scale, 0), o);
+        r.place[0] = radius * cosf(angle);
+        r.place[1] = 0.5f + 0.6f * (h & 255) / 255.0f;
+        r.place[2] = radius * sinf(angle);
+        r.place[3] = scale;
+    }
+}
+
+// Animation level of detail. The CPU evaluates a ride only when a view will
+// show it: at every tick while some view sees it close up, every
+// REDUCED_ANIMATION_TICKS ticks while the views see it only from far away,
+// and not at all while none sees it. The curves are closed form, so a ride
+// coming back into view is evaluated once at the current tick with nothing
+// to catch up on.
+
+enum AnimationLevel {
+    ANIMATE_FULL,
+    ANIMATE_REDUCED,
+    ANIMATE_FROZEN
+};
+
+// the park's animated rides in the order the game evaluates them; the
+// balloons and the trees each share one ride
+enum ParkAnimation {
+    ANIM_FENCE,
+    ANIM_WHEEL,
+    ANIM_BALLOONS,
+    ANIM_SWING,
+    ANIM_TREES,
+    ANIM_TICKET_STAND,
+    ANIM_TICKET,
+    ANIM_COUNT
+};
+
+const int MAX_ANIMATION_SITES = 3;
+const int REDUCED_ANIMATION_TICKS = 4;
+const float REDUCED_ANIMATION_DISTANCE = 3.0f;     // from the eye to the sphere
+
+// a world-space sphere round one place a ride is drawn
+struct AnimationSite {
+    float x, y, z, radius;
+};
+
+class AnimationLod {
+public:
+    AnimationSite sites[ANIM_COUNT][MAX_ANIMATION_SITES];
+    int siteCount[ANIM_COUNT];
+    AnimationLevel level[ANIM_COUNT];
+    double posedTick[ANIM_COUNT];       // -1 before the first evaluation
+    int evaluated, skipped;             // by the last due()
+    unsigned long totalEvaluated, totalSkipped;
+
+    AnimationLod() : evaluated(0), skipped(0), totalEvaluated(0), totalSkipped(0) {
+        for (int i = 0; i < ANIM_COUNT; i++) {
+            siteCount[i] = 0;
+            level[i] = ANIMATE_FULL;
+            posedTick[i] = -1;
+        }
+    }
+
+    void addSite(int ride, float x, float y, float z, float radius) {
+        if (siteCount[ride] >= MAX_ANIMATION_SITES) {
+            fprintf(stderr, "ride %d has more than %d animation sites\n", ride, MAX_ANIMATION_SITES);
+            abort();
+        }
+        AnimationSite site = { x, y, z, radius };
+        sites[ride][siteCount[ride]++] = site;
+    }
+
+    void moveSite(int ride, int site, float x, float y, float z) {
+        sites[ride][site].x = x;
+        sites[ride][site].y = y;
+        sites[ride][site].z = z;
+    }
+
+    // every ride at full rate, as when nothing decides otherwise
+    void animateAll() {
+        for (int i = 0; i < ANIM_COUNT; i++)
+            level[i] = ANIMATE_FULL;
+    }
+
+    // levels for the coming frame: freeze everything, then see() it from
+    // each view's camera
+    void beginViews() {
+        for (int i = 0; i < ANIM_COUNT; i++)
+            level[i] = ANIMATE_FROZEN;
+    }
+
+    void see(Camera& camera) {
+        Vector3f eye = camera.position();
+        for (int i = 0; i < ANIM_COUNT; i++) {
+            for (int k = 0; k < siteCount[i] && level[i] != ANIMATE_FULL; k++) {
+                const AnimationSite& s = sites[i][k];
+                Vector3f center(s.x, s.y, s.z);
+                if (!camera.sphereVisible(center, s.radius))
+                    continue;
+                Vector3f d = center - eye;
+                bool distant = sqrtf(d.dot(d)) - s.radius > REDUCED_ANIMATION_DISTANCE;
+                AnimationLevel seen = distant ? ANIMATE_REDUCED : ANIMATE_FULL;
+                if (seen < level[i])
+                    level[i] = seen;
+            }
+        }
+    }
+
+    // fills rides with the rides to evaluate at tick by their levels and
+    // marks them posed there; the stale ones left alone count as skipped
+    int due(double tick, int* rides) {
+        int count = 0;
+        skipped = 0;
+        for (int i = 0; i < ANIM_COUNT; i++) {
+            if (posedTick[i] == tick)
+                continue;
+            bool evaluate;
+            switch (level[i]) {
+            case ANIMATE_FULL: evaluate = true; break;
+            case ANIMATE_REDUCED: evaluate = posedTick[i] < 0 || tick - posedTick[i] >= REDUCED_ANIMATION_TICKS; break;
+            default: evaluate = false; break;
+            }
+            if (evaluate) {
+                posedTick[i] = tick;
+                rides[count++] = i;
+            }
+            else {
+                skipped++;
+            }
+        }
+        evaluated = count;
+        totalEvaluated += evaluated;
+        totalSkipped += skipped;
+        return count;
+    }
+
+    double skippedPercent() const {
+        unsigned long total = totalEvaluated + totalSkipped;
+        return total ? 100.0 * totalSkipped / total : 0.0;
+    }
+};
+
+// the park's rides where the game draws them
+inline void addParkAnimationSites(AnimationLod& lod) {
+    lod.addSite(ANIM_FENCE, 0, 0.15f, -0.5f, 0.65f);
+    lod.addSite(ANIM_FENCE, -0.5f, 0.15f, 0, 0.65f);
+    lod.addSite(ANIM_FENCE, 0.5f, 0.15f, 0, 0.65f);
+    lod.addSite(ANIM_WHEEL, 0, 0.37f, -0.42f, 0.4f);
+    lod.addSite(ANIM_BALLOONS, 0.5f, 0.4f, 0.2f, 0.15f);
+    lod.addSite(ANIM_BALLOONS, 0.6f, 0.43f, 0.3f, 0.15f);
+    lod.addSite(ANIM_BALLOONS, -0.4f, 0.43f, -0.6f, 0.15f);
+    lod.addSite(ANIM_SWING, -0.35f, 0.2f, 0, 0.25f);
+    lod.addSite(ANIM_TREES, 0.3f, 0.2f, -0.2f, 0.25f);
+    lod.addSite(ANIM_TREES, 0.42f, 0.2f, 0.1f, 0.25f);
+    lod.addSite(ANIM_TICKET_STAND, -0.42f, 0.12f, 0.35f, 0.2f);
+    lod.addSite(ANIM_TICKET, 0.3f, 0.03f, 0.3f, 0.1f);
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef RIDE_SHADER_H
+#define RIDE_SHADER_H
+
+#include "GLExt.h"
+#include "RideAnimation.h"
+
+// Moves ride geometry recorded at rest by the curves of RideAnimation.h in
+// a vertex shader. While it is bound the modelview matrix holds only the
+// model-to-world transform of what is drawn: the shader places and animates
+// the world position, then applies the view set in begin(). An instance's
+// parameters are constant vertex attributes, so switching instances is four
+// calls and moving them all is one time uniform. Lighting is LIGHT0 with
+// the day's material as fixed-function OpenGL computes it; the fragment
+// stage stays fixed-function.
+
+const GLuint RIDE_ATTRIBUTE_PLACE = 1;     // aliases the vertex weight and
+const GLuint RIDE_ATTRIBUTE_PIVOT = 5;     // fog coordinate on drivers that
+const GLuint RIDE_ATTRIBUTE_AXIS = 6;      // alias, neither of which the
+const GLuint RIDE_ATTRIBUTE_CURVE = 7;     // park uses
+
+class RideShading {
+public:
+    RideShading() : program(0), failed(false), bound(false), instance(NULL) {}
+
+    bool supported() const {
+        return ext.shaders;
+    }
+
+    // compiles on first use; false when the driver has no GLSL or rejects it
+    bool ready() {
+        if (program == 0 && !failed)
+            create();
+        return program != 0;
+    }
+
+    bool active() const {
+        return bound;
+    }
+
+    // binds the program for a view (column-major world to eye) at ticks
+    // since the start
+    void begin(const float* view, double ticks) {
+        ext.useProgram(program);
+        bound = true;
+        ext.uniformMatrix4fv(viewLocation, 1, GL_FALSE, view);
+        ext.uniform1f(timeLocation, (float)ticks);
+        ext.uniform1f(litLocation, 1.0f);
+        instance = NULL;
+        setInstance(NULL);
+    }
+
+    // what moves the following draws, NULL for nothing; the instance must
+    // stay where it is while the program is bound
+    void setInstance(const RideInstance* r) {
+        if (!r)
+            r = &still;
+        if (r == instance)
+            return;
+        instance = r;
+        ext.vertexAttrib4fv(RIDE_ATTRIBUTE_PLACE, r->place);
+        ext.vertexAttrib4fv(RIDE_ATTRIBUTE_PIVOT, r->pivot);
+        ext.vertexAttrib4fv(RIDE_ATTRIBUTE_AXIS, r->axis);
+        ext.vertexAttrib4fv(RIDE_ATTRIBUTE_CURVE, r->curve);
+    }
+
+    void setLit(bool lit) {
+        ext.uniform1f(litLocation, lit ? 1.0f : 0.0f);
+    }
+
+    void end() {
+        ext.useProgram(0);
+        bound = false;
+    }
+
+private:
+    GLuint program;
+    bool failed;
+    bool bound;
+    const RideInstance* instance;
+    RideInstance still;
+    GLint viewLocation, timeLocation, litLocation;
+
+    RideShading(const RideShading&);
+    RideShading& operator=(const RideShading&);
+
+    void create() {
+        static const char* source =
+            "attribute vec4 ridePlace;\n"
+            "attribute vec4 ridePivot;\n"
+            "attribute vec4 rideAxis;\n"
+            "attribute vec4 rideCurve;\n"
+            "uniform mat4 view;\n"
+            "uniform float time;\n"
+            "uniform float lit;\n"
+            "float rideValue() {\n"
+            "    if (rideAxis.w < 0.5)\n"
+            "        return mod(rideCurve.x + rideCurve.y * mod(time, rideCurve.z / rideCurve.y), rideCurve.z);\n"
+            "    float x = mod(time - rideCurve.w, rideCurve.z) / rideCurve.z;\n"
+            "    if (rideAxis.w > 1.5)\n"
+            "        return rideCurve.x + rideCurve.y * sin(6.2831853 * x);\n"
+            "    return rideCurve.x + rideCurve.y * (1.0 - 4.0 * abs(fract(x + 0.25) - 0.5));\n"
+            "}\n"
+            "void main() {\n"
+            "    vec3 p = (gl_ModelViewMatrix * gl_Vertex).xyz * ridePlace.w + ridePlace.xyz;\n"
+            "    vec3 n = gl_NormalMatrix * gl_Normal;\n"
+            "    if (ridePivot.w > 0.5) {\n"
+            "        float v = rideValue();\n"
+            "        vec3 arm = p - ridePivot.xyz;\n"
+            "        if (ridePivot.w < 1.5) {\n"
+            "            vec3 k = normalize(rideAxis.xyz);\n"
+            "            float c = cos(radians(v));\n"
+            "            float s = sin(radians(v));\n"
+            "            p = ridePivot.xyz + arm * c + cross(k, arm) * s + k * (dot(k, arm) * (1.0 - c));\n"
+            "            n = n * c + cross(k, n) * s + k * (dot(k, n) * (1.0 - c));\n"
+            "        }\n"
+            "        else if (ridePivot.w < 2.5)\n"
+            "            p += rideAxis.xyz * v;\n"
+            "        else\n"
+            "            p = ridePivot.xyz + arm * v;\n"
+            "    }\n"
+            "    vec4 eye = view * vec4(p, 1.0);\n"
+            "    gl_Position = gl_ProjectionMatrix * eye;\n"
+            "    if (lit < 0.5) {\n"
+            "        gl_FrontColor = gl_Color;\n"
+            "        return;\n"
+            "    }\n"
+            "    n = normalize((view * vec4(n, 0.0)).xyz);\n"
+            "    vec4 light = gl_LightSource[0].position;\n"
+            "    vec3 l = normalize(light.xyz - eye.xyz * light.w);\n"
+            "    float diffuse = max(dot(n, l), 0.0);\n"
+            "    float specular = 0.0;\n"
+            "    if (diffuse > 0.0)\n"
+            "        specular = pow(max(dot(n, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0), gl_FrontMaterial.shininess);\n"
+            "    vec3 color = gl_Color.rgb * (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb\n"
+            "        + diffuse * gl_LightSource[0].diffuse.rgb)\n"
+            "        + specular * gl_LightSource[0].specular.rgb * gl_FrontMaterial.specular.rgb;\n"
+            "    gl_FrontColor = vec4(color, gl_Color.a);\n"
+            "}\n";
+
+        RideInstance none = {
+            { 0, 0, 0, 1 }, { 0, 0, 0, MOTION_STILL }, { 0, 0, 1, CURVE_SPIN }, { 0, 1, 1, 0 }
+        };
+        still = none;
+        if (!supported()) {
+            failed = true;
+            return;
+        }
+        GLuint shader = ext.createShader(GL_VERTEX_SHADER);
+        ext.shaderSource(shader, 1, &source, NULL);
+        ext.compileShader(shader);
+        GLint ok = 0;
+        ext.getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (ok) {
+            program = ext.createProgram();
+            ext.attachShader(program, shader);
+            ext.bindAttribLocation(program, RIDE_ATTRIBUTE_PLACE, "ridePlace");
+            ext.bindAttribLocation(program, RIDE_ATTRIBUTE_PIVOT, "ridePivot");
+            ext.bindAttribLocation(program, RIDE_ATTRIBUTE_AXIS, "rideAxis");
+            ext.bindAttribLocation(program, RIDE_ATTRIBUTE_CURVE, "rideCurve");
+            ext.linkProgram(program);
+            ext.getProgramiv(program, GL_LINK_STATUS, &ok);
+        }
+        ext.deleteShader(shader);
+        if (!ok) {
+            program = 0;
+            failed = true;
+            return;
+        }
+        viewLocation = ext.getUniformLocation(program, "view");
+        timeLocation = ext.getUniformLocation(program, "time");
+        litLocation = ext.getUniformLocation(program, "lit");
+    }
+};
+
+#endif
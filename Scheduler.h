@@ -0,0 +1,275 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <coroutine>
+
+// Timed sequences as C++20 coroutines on the simulation clock. A sequence
+// is a function returning Sequence whose first parameter is the Scheduler;
+// it co_awaits scheduler.wait(ticks) wherever it would otherwise count a
+// delay down by hand, so "play a jingle, wait a second, resume the music"
+// reads as three lines. The clock only moves when advance() is called, once
+// per simulation tick, so sequences pause, replay and skip frames with the
+// rest of the simulation instead of following the wall clock.
+//
+// Waiting sequences sit in a hierarchical timing wheel: four levels of 64
+// slots, level 0 one tick per slot and every level above 64 times coarser,
+// cascading down as the clock reaches them. Scheduling and firing cost the
+// same however many sequences wait. The timer is a node inside the awaiter,
+// which lives in the coroutine frame, and frames come from blocks allocated
+// once with the scheduler, so neither starting a sequence nor waiting
+// touches the heap. A frame that does not fit falls back to the heap and is
+// counted, like a FrameArena overflow.
+
+const int WHEEL_BITS = 6;
+const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+const int WHEEL_LEVELS = 4;
+const unsigned long long WHEEL_SPAN = 1ull << (WHEEL_BITS * WHEEL_LEVELS);  // ticks the wheel can hold
+const size_t FRAME_BLOCK_SIZE = 512;
+const size_t FRAME_HEADER_SIZE = 16;    // keeps the frame 16-byte aligned
+
+class Scheduler;
+
+struct TimerNode {
+    TimerNode* next;
+    unsigned long long due;
+    std::coroutine_handle<> handle;
+};
+
+class Sequence {
+public:
+    struct promise_type {
+        Sequence get_return_object() {
+            return Sequence(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        // Scheduler::spawn starts it; a finished sequence frees its frame
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { abort(); }
+
+        template <class... Args>
+        static void* operator new(size_t size, Scheduler& scheduler, Args&...);
+        static void operator delete(void* frame, size_t size);
+    };
+
+    Sequence(Sequence&& other) : handle(other.handle) {
+        other.handle = NULL;
+    }
+
+    // a sequence that was never spawned
+    ~Sequence() {
+        if (handle)
+            handle.destroy();
+    }
+
+    std::coroutine_handle<> release() {
+        std::coroutine_handle<> h = handle;
+        handle = NULL;
+        return h;
+    }
+
+private:
+    std::coroutine_handle<> handle;
+
+    explicit Sequence(std::coroutine_handle<> h) : handle(h) {}
+    Sequence(const Sequence&);
+    Sequence& operator=(const Sequence&);
+};
+
+class Delay;
+
+class Scheduler {
+public:
+    unsigned frameOverflows;    // frames that came from the heap
+
+    // frameCapacity sequences can be alive at once without the heap
+    Scheduler(int frameCapacity = 64) : frameOverflows(0), tick(0), waitingCount(0), blockCount(frameCapacity), freeBlocks(NULL) {
+        for (int level = 0; level < WHEEL_LEVELS; level++) {
+            for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+                heads[level][slot] = NULL;
+                tails[level][slot] = NULL;
+            }
+        }
+        blocks = (unsigned char*)malloc(blockCount * FRAME_BLOCK_SIZE);
+        if (!blocks)
+            blockCount = 0;
+        for (int i = blockCount - 1; i >= 0; i--) {
+            FreeBlock* block = (FreeBlock*)(blocks + i * FRAME_BLOCK_SIZE);
+            block->next = freeBlocks;
+            freeBlocks = block;
+        }
+    }
+
+    // sequences still waiting are destroyed without running further
+    ~Scheduler() {
+        for (int level = 0; level < WHEEL_LEVELS; level++) {
+            for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+                TimerNode* node = heads[level][slot];
+                heads[level][slot] = NULL;
+                while (node) {
+                    TimerNode* next = node->next;
+                    node->handle.destroy();
+                    node = next;
+                }
+            }
+        }
+        free(blocks);
+    }
+
+    unsigned long long now() const {
+        return tick;
+    }
+
+    int waiting() const {
+        return waitingCount;
+    }
+
+    // runs the sequence up to its first wait
+    void spawn(Sequence sequence) {
+        sequence.release().resume();
+    }
+
+    // co_await scheduler.wait(n) resumes in the advance() n ticks from now;
+    // wait(0) does not suspend
+    Delay wait(unsigned ticks);
+
+    // one simulation tick: resumes every sequence due now, in the order
+    // they started waiting
+    void advance() {
+        tick++;
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (((tick >> (WHEEL_BITS * (level - 1))) & (WHEEL_SLOTS - 1)) != 0)
+                break;
+            cascade(level, (tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+        }
+
+        int slot = tick & (WHEEL_SLOTS - 1);
+        TimerNode* node = heads[0][slot];
+        heads[0][slot] = NULL;
+        tails[0][slot] = NULL;
+        while (node) {
+            // resuming may finish the sequence and free the node
+            TimerNode* next = node->next;
+            waitingCount--;
+            node->handle.resume();
+            node = next;
+        }
+    }
+
+    void schedule(TimerNode& node, unsigned ticks) {
+        node.due = tick + ticks;
+        waitingCount++;
+        insert(node);
+    }
+
+    void* allocateFrame(size_t size) {
+        unsigned char* block;
+        if (size + FRAME_HEADER_SIZE <= FRAME_BLOCK_SIZE && freeBlocks) {
+            block = (unsigned char*)freeBlocks;
+            freeBlocks = freeBlocks->next;
+        }
+        else {
+            frameOverflows++;
+            block = (unsigned char*)malloc(size + FRAME_HEADER_SIZE);
+            if (!block)
+                abort();
+        }
+        *(Scheduler**)block = this;
+        return block + FRAME_HEADER_SIZE;
+    }
+
+    static void releaseFrame(void* frame) {
+        unsigned char* block = (unsigned char*)frame - FRAME_HEADER_SIZE;
+        Scheduler* owner = *(Scheduler**)block;
+        if (block >= owner->blocks && block < owner->blocks + owner->blockCount * FRAME_BLOCK_SIZE) {
+            FreeBlock* released = (FreeBlock*)block;
+            released->next = owner->freeBlocks;
+            owner->freeBlocks = released;
+        }
+        else
+            free(block);
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    unsigned long long tick;
+    int waitingCount;
+    TimerNode* heads[WHEEL_LEVELS][WHEEL_SLOTS];
+    TimerNode* tails[WHEEL_LEVELS][WHEEL_SLOTS];
+    unsigned char* blocks;
+    int blockCount;
+    FreeBlock* freeBlocks;
+
+    // the finest level whose span covers the delay; a delay past the top
+    // level waits in its last slot and is placed again when that cascades
+    void insert(TimerNode& node) {
+        unsigned long long delta = node.due - tick;
+        unsigned long long due = delta < WHEEL_SPAN ? node.due : tick + WHEEL_SPAN - 1;
+        int level = 0;
+        while (level < WHEEL_LEVELS - 1 && (due - tick) >= (1ull << (WHEEL_BITS * (level + 1))))
+            level++;
+        int slot = (due >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+        node.next = NULL;
+        if (tails[level][slot])
+            tails[level][slot]->next = &node;
+        else
+            heads[level][slot] = &node;
+        tails[level][slot] = &node;
+    }
+
+    void cascade(int level, int slot) {
+        TimerNode* node = heads[level][slot];
+        heads[level][slot] = NULL;
+        tails[level][slot] = NULL;
+        while (node) {
+            TimerNode* next = node->next;
+            insert(*node);
+            node = next;
+        }
+    }
+
+    Scheduler(const Scheduler&);
+    Scheduler& operator=(const Scheduler&);
+};
+
+class Delay {
+public:
+    Delay(Scheduler& s, unsigned t) : scheduler(s), ticks(t) {}
+
+    bool await_ready() const {
+        return ticks == 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        node.handle = handle;
+        scheduler.schedule(node, ticks);
+    }
+
+    void await_resume() {}
+
+private:
+    Scheduler& scheduler;
+    unsigned ticks;
+    TimerNode node;
+};
+
+inline Delay Scheduler::wait(unsigned ticks) {
+    return Delay(*this, ticks);
+}
+
+template <class... Args>
+void* Sequence::promise_type::operator new(size_t size, Scheduler& scheduler, Args&...) {
+    return scheduler.allocateFrame(size);
+}
+
+inline void Sequence::promise_type::operator delete(void* frame, size_t) {
+    Scheduler::releaseFrame(frame);
+}
+
+#endif
@@ -0,0 +1,605 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <math.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ParkMath.h"
+#include "Camera.h"
+#include "AssetPack.h"
+
+// Heightmap terrain around the park, TERRAIN_CHUNKS x TERRAIN_CHUNKS chunks
+// of CHUNK_SIZE units. The park itself stands on a flat plateau at the old
+// ground height, with hills beyond it.
+//
+// Chunks are baked into tile files (park_bake --terrain), each an asset pack
+// holding TILE_CHUNKS x TILE_CHUNKS chunks, and streamed in on a background
+// thread as the viewer moves: only the chunks within a window around the
+// viewer are kept, in a fixed number of slots, so memory is set by the chunk
+// budget and not by the size of the map. A chunk whose tile is missing is
+// generated from the same function the baker uses.
+//
+// Each chunk is drawn at a level of detail picked by its distance from the
+// eye, every level halving the vertices of the one before. Towards the end
+// of its range a level morphs its in-between vertices onto the coarser
+// level's surface, so switching levels never pops; skirts hanging from the
+// chunk edges hide the cracks between neighbours at different levels.
+
+const int TERRAIN_CHUNKS = 64;                  // per side
+const float CHUNK_SIZE = 2.0f;                  // world units per side
+const float TERRAIN_EXTENT = TERRAIN_CHUNKS * CHUNK_SIZE;
+const int CHUNK_QUADS = 32;                     // per side at the finest level
+const int CHUNK_SAMPLES = CHUNK_QUADS + 1;
+const int BORDERED_SAMPLES = CHUNK_SAMPLES + 2; // baked with a ring of neighbours for the normals
+const int TERRAIN_LEVELS = 4;
+const float TERRAIN_LOD_RANGE = 2 * CHUNK_SIZE; // level 0 range; each level doubles it
+const float TERRAIN_MORPH_START = 0.7f;         // part of a level's range before it starts morphing
+const float TERRAIN_SKIRT = 0.5f;
+const int TILE_CHUNKS = 8;                      // per side, per tile file
+const int MAX_OPEN_TILES = 4;
+const float GROUND_LEVEL = 0.01f;               // the top of the old ground cube
+const float PLATEAU_SIZE = 1.0f;                // half width of the flat park area
+const float PLATEAU_RISE = 2.0f;                // distance over which the hills rise
+
+// pseudo-random in [-1, 1] per lattice point
+inline float latticeNoise(int x, int z) {
+    unsigned h = (unsigned)x * 374761393u + (unsigned)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (h & 0xffffff) / (float)0xffffff * 2 - 1;
+}
+
+inline float valueNoise(float x, float z) {
+    float fx = floorf(x), fz = floorf(z);
+    int x0 = (int)fx, z0 = (int)fz;
+    float tx = x - fx, tz = z - fz;
+    tx = tx * tx * (3 - 2 * tx);
+    tz = tz * tz * (3 - 2 * tz);
+    float a = latticeNoise(x0, z0) + (latticeNoise(x0 + 1, z0) - latticeNoise(x0, z0)) * tx;
+    float b = latticeNoise(x0, z0 + 1) + (latticeNoise(x0 + 1, z0 + 1) - latticeNoise(x0, z0 + 1)) * tx;
+    return a + (b - a) * tz;
+}
+
+// the baked heights come from this; the plateau is square like the fences
+inline float proceduralHeight(float x, float z) {
+    float r = fabsf(x) > fabsf(z) ? fabsf(x) : fabsf(z);
+    float t = (r - PLATEAU_SIZE) / PLATEAU_RISE;
+    if (t <= 0)
+        return GROUND_LEVEL;
+    if (t > 1)
+        t = 1;
+    float mask = t * t * (3 - 2 * t);
+    float hills = 0, amplitude = 2.0f, frequency = 1.0f / 12;
+    for (int octave = 0; octave < 5; octave++) {
+        hills += amplitude * valueNoise(x * frequency + octave * 17.3f, z * frequency);
+        amplitude *= 0.5f;
+        frequency *= 2;
+    }
+    return GROUND_LEVEL + mask * (hills + 1.0f);
+}
+
+// lower corner of a chunk in world space
+inline float chunkOrigin(int c) {
+    return -TERRAIN_EXTENT / 2 + c * CHUNK_SIZE;
+}
+
+// the chunk containing a world coordinate, possibly outside the map
+inline int chunkAt(float x) {
+    return (int)floorf((x + TERRAIN_EXTENT / 2) / CHUNK_SIZE);
+}
+
+inline void tilePath(char* path, size_t size, const char* directory, int tileX, int tileZ) {
+    snprintf(path, size, "%s/terrain_%d_%d.pack", directory, tileX, tileZ);
+}
+
+// chunks are 0 to TERRAIN_CHUNKS - 1 a side, so the name always fits an
+// asset name
+inline void chunkName(char* name, size_t size, int cx, int cz) {
+    cx = cx < 0 ? 0 : (cx < TERRAIN_CHUNKS ? cx : TERRAIN_CHUNKS - 1);
+    cz = cz < 0 ? 0 : (cz < TERRAIN_CHUNKS ? cz : TERRAIN_CHUNKS - 1);
+    snprintf(name, size, "chunk/%d_%d", (unsigned char)cx, (unsigned char)cz);
+}
+
+// a baked chunk: this header, then BORDERED_SAMPLES^2 heights as
+// baseHeight + value * heightStep, row by row along +x
+struct TerrainChunkHeader {
+    float baseHeight;
+    float heightStep;
+    unsigned samples;
+    unsigned reserved;
+};
+
+inline void generateBorderedHeights(int cx, int cz, float* heights) {
+    float spacing = CHUNK_SIZE / CHUNK_QUADS;
+    for (int j = 0; j < BORDERED_SAMPLES; j++) {
+        for (int i = 0; i < BORDERED_SAMPLES; i++)
+            heights[j * BORDERED_SAMPLES + i] = proceduralHeight(chunkOrigin(cx) + (i - 1) * spacing, chunkOrigin(cz) + (j - 1) * spacing);
+    }
+}
+
+// the tile's chunks as an asset pack, quantized to 16 bits per height
+inline bool bakeTerrainTile(const char* directory, int tileX, int tileZ) {
+    AssetPackWriter pack;
+    std::vector<float> heights(BORDERED_SAMPLES * BORDERED_SAMPLES);
+    std::vector<unsigned char> bytes(sizeof(TerrainChunkHeader) + heights.size() * sizeof(unsigned short));
+    for (int cz = tileZ * TILE_CHUNKS; cz < (tileZ + 1) * TILE_CHUNKS && cz < TERRAIN_CHUNKS; cz++) {
+        for (int cx = tileX * TILE_CHUNKS; cx < (tileX + 1) * TILE_CHUNKS && cx < TERRAIN_CHUNKS; cx++) {
+            generateBorderedHeights(cx, cz, &heights[0]);
+            float low = heights[0], high = heights[0];
+            for (size_t i = 1; i < heights.size(); i++) {
+                low = heights[i] < low ? heights[i] : low;
+                high = heights[i] > high ? heights[i] : high;
+            }
+            TerrainChunkHeader header = { low, (high - low) / 65535, BORDERED_SAMPLES, 0 };
+            memcpy(&bytes[0], &header, sizeof(header));
+            unsigned short* values = (unsigned short*)&bytes[sizeof(header)];
+            for (size_t i = 0; i < heights.size(); i++)
+                values[i] = header.heightStep > 0 ? (unsigned short)((heights[i] - low) / header.heightStep + 0.5f) : 0;
+            char name[ASSET_NAME_LENGTH];
+            chunkName(name, sizeof(name), cx, cz);
+            pack.add(name, &bytes[0], bytes.size());
+        }
+    }
+    char path[512];
+    tilePath(path, sizeof(path), directory, tileX, tileZ);
+    return pack.save(path);
+}
+
+enum ChunkState {
+    CHUNK_FREE,
+    CHUNK_LOADING,  // owned by the loader thread
+    CHUNK_READY
+};
+
+struct TerrainChunk {
+    int cx, cz;
+    ChunkState state;
+    bool fromTile;          // read from a tile rather than generated
+    float minHeight, maxHeight;
+    float heights[CHUNK_SAMPLES * CHUNK_SAMPLES];
+    float normals[CHUNK_SAMPLES * CHUNK_SAMPLES][3];
+};
+
+struct TerrainVertex {
+    float x, y, z;
+    float nx, ny, nz;
+};
+
+// one chunk to draw this frame
+struct TerrainBatch {
+    const TerrainVertex* vertices;
+    int level;
+    Vector3f center;
+    float radius;
+};
+
+class TerrainStreamer {
+public:
+    unsigned chunksFromTiles, chunksGenerated, chunksEvicted;    // counted as update() takes them
+    int peakResident;
+
+    // budget chunks are resident at most; the viewer's window is the largest
+    // square of chunks that fits in it
+    TerrainStreamer(int budget, const char* tileDirectory)
+        : chunksFromTiles(0), chunksGenerated(0), chunksEvicted(0), peakResident(0), directory(tileDirectory),
+        revision(0), requestHead(0), requestCount(0), doneHead(0), doneCount(0), stopping(false) {
+        if (budget < 9)
+            budget = 9;
+        radius = ((int)sqrtf((float)budget) - 1) / 2;
+        window = 2 * radius + 3;
+        chunks.resize(budget);
+        for (size_t i = 0; i < chunks.size(); i++)
+            chunks[i].state = CHUNK_FREE;
+        windowSlots.assign(window * window, -1);
+        requests.resize(budget);
+        done.resize(budget);
+        for (int level = 0; level < TERRAIN_LEVELS; level++)
+            buildIndices(level);
+        for (int i = 0; i < MAX_OPEN_TILES; i++) {
+            tileX[i] = tileZ[i] = -1;
+            tileUse[i] = 0;
+        }
+        tileClock = 0;
+        loader = std::thread(&TerrainStreamer::loadChunks, this);
+    }
+
+    ~TerrainStreamer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        loader.join();
+    }
+
+    int budget() const {
+        return (int)chunks.size();
+    }
+
+    int windowRadius() const {
+        return radius;
+    }
+
+    int resident() const {
+        int n = 0;
+        for (size_t i = 0; i < chunks.size(); i++)
+            n += chunks[i].state != CHUNK_FREE;
+        return n;
+    }
+
+    // once per simulation tick: takes in the chunks the loader finished,
+    // frees the ones that left the window and asks for the missing ones,
+    // nearest first; true when the set of drawable chunks changed
+    bool update(float viewerX, float viewerZ) {
+        bool changed = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (; doneCount > 0; doneCount--) {
+                TerrainChunk& c = chunks[done[doneHead]];
+                c.state = CHUNK_READY;
+                if (c.fromTile)
+                    chunksFromTiles++;
+                else
+                    chunksGenerated++;
+                doneHead = (doneHead + 1) % (int)done.size();
+                changed = true;
+            }
+        }
+
+        int vx = chunkAt(viewerX), vz = chunkAt(viewerZ);
+        for (size_t i = 0; i < chunks.size(); i++) {
+            TerrainChunk& c = chunks[i];
+            if (c.state != CHUNK_READY || (abs(c.cx - vx) <= radius && abs(c.cz - vz) <= radius))
+                continue;
+            int& entry = windowSlot(c.cx, c.cz);
+            if (entry == (int)i)
+                entry = -1;
+            c.state = CHUNK_FREE;
+            chunksEvicted++;
+            changed = true;
+        }
+
+        int requested = 0;
+        size_t freeSlot = 0;
+        for (int ring = 0; ring <= radius; ring++) {
+            for (int dz = -ring; dz <= ring; dz++) {
+                for (int dx = -ring; dx <= ring; dx++) {
+                    if (abs(dx) != ring && abs(dz) != ring)
+                        continue;
+                    int cx = vx + dx, cz = vz + dz;
+                    if (cx < 0 || cz < 0 || cx >= TERRAIN_CHUNKS || cz >= TERRAIN_CHUNKS)
+                        continue;
+                    int& entry = windowSlot(cx, cz);
+                    // loaded, loading, or the slot's last chunk is still on its way
+                    if (entry >= 0)
+                        continue;
+                    while (freeSlot < chunks.size() && chunks[freeSlot].state != CHUNK_FREE)
+                        freeSlot++;
+                    if (freeSlot == chunks.size())
+                        break;
+                    TerrainChunk& c = chunks[freeSlot];
+                    c.cx = cx;
+                    c.cz = cz;
+                    c.state = CHUNK_LOADING;
+                    entry = (int)freeSlot;
+                    requestSlots[requested++ % REQUEST_BATCH] = (int)freeSlot;
+                    if (requested % REQUEST_BATCH == 0)
+                        submit(requestSlots, REQUEST_BATCH);
+                }
+            }
+        }
+        if (requested % REQUEST_BATCH != 0)
+            submit(requestSlots, requested % REQUEST_BATCH);
+
+        int n = resident();
+        if (n > peakResident)
+            peakResident = n;
+        if (changed)
+            revision++;
+        return changed;
+    }
+
+    unsigned chunkRevision() const {
+        return revision;
+    }
+
+    // the resident height under a point, or the generated one while its
+    // chunk is still on its way; follows the triangles that are drawn at
+    // the finest level
+    float height(float x, float z) {
+        int cx = chunkAt(x), cz = chunkAt(z);
+        const TerrainChunk* c = readyChunk(cx, cz);
+        if (!c)
+            return proceduralHeight(x, z);
+        float spacing = CHUNK_SIZE / CHUNK_QUADS;
+        float u = (x - chunkOrigin(cx)) / spacing, v = (z - chunkOrigin(cz)) / spacing;
+        int i = (int)u, j = (int)v;
+        i = i < 0 ? 0 : i >= CHUNK_QUADS ? CHUNK_QUADS - 1 : i;
+        j = j < 0 ? 0 : j >= CHUNK_QUADS ? CHUNK_QUADS - 1 : j;
+        float fu = u - i, fv = v - j;
+        float h00 = c->heights[j * CHUNK_SAMPLES + i], h10 = c->heights[j * CHUNK_SAMPLES + i + 1];
+        float h01 = c->heights[(j + 1) * CHUNK_SAMPLES + i], h11 = c->heights[(j + 1) * CHUNK_SAMPLES + i + 1];
+        // split along the (i, j) - (i + 1, j + 1) diagonal
+        if (fu > fv)
+            return h00 + (h10 - h00) * fu + (h11 - h10) * fv;
+        return h00 + (h11 - h01) * fu + (h01 - h00) * fv;
+    }
+
+    // vertices of every ready chunk for an eye at this position, into
+    // memory from alloc (a FrameArena); chunks that do not fit are left out
+    template <class Allocator>
+    int prepare(const Vector3f& eye, Allocator& alloc, TerrainBatch*& batches) {
+        batches = alloc.template allocateArray<TerrainBatch>(chunks.size());
+        if (!batches)
+            return 0;
+        int count = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const TerrainChunk& c = chunks[i];
+            if (c.state != CHUNK_READY)
+                continue;
+            TerrainBatch& b = batches[count];
+            float half = CHUNK_SIZE / 2, rise = (c.maxHeight - c.minHeight) / 2 + TERRAIN_SKIRT / 2;
+            b.center = Vector3f(chunkOrigin(c.cx) + half, (c.minHeight + c.maxHeight - TERRAIN_SKIRT) / 2, chunkOrigin(c.cz) + half);
+            b.radius = sqrtf(2 * half * half + rise * rise);
+            Vector3f d = b.center - eye;
+            float morph;
+            b.level = selectLevel(sqrtf(d.dot(d)), morph);
+            TerrainVertex* vertices = alloc.template allocateArray<TerrainVertex>(vertexCount(b.level));
+            if (!vertices)
+                continue;
+            buildVertices(c, b.level, morph, vertices);
+            b.vertices = vertices;
+            count++;
+        }
+        return count;
+    }
+
+    static int vertexCount(int level) {
+        int n = CHUNK_QUADS >> level;
+        return (n + 1) * (n + 1) + 4 * (n + 1);
+    }
+
+    int indexCount(int level) const {
+        return (int)indices[level].size();
+    }
+
+    const unsigned short* levelIndices(int level) const {
+        return &indices[level][0];
+    }
+
+    // the level for a chunk this far from the eye, and how far it has
+    // morphed towards the next one
+    static int selectLevel(float distance, float& morph) {
+        float range = TERRAIN_LOD_RANGE;
+        int level = 0;
+        while (level < TERRAIN_LEVELS - 1 && distance >= range) {
+            range *= 2;
+            level++;
+        }
+        morph = 0;
+        if (level < TERRAIN_LEVELS - 1) {
+            morph = (distance - range * TERRAIN_MORPH_START) / (range * (1 - TERRAIN_MORPH_START));
+            morph = morph < 0 ? 0 : morph > 1 ? 1 : morph;
+        }
+        return level;
+    }
+
+private:
+    static const int REQUEST_BATCH = 16;
+
+    const char* directory;
+    int radius, window;
+    std::vector<TerrainChunk> chunks;
+    std::vector<int> windowSlots;   // toroidal over the window, chunk -> slot
+    std::vector<unsigned short> indices[TERRAIN_LEVELS];
+    unsigned revision;
+
+    // main thread -> loader and back, slot numbers in fixed rings
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<int> requests, done;
+    int requestHead, requestCount, doneHead, doneCount;
+    bool stopping;
+    int requestSlots[REQUEST_BATCH];
+    std::thread loader;
+
+    // the loader's own
+    AssetPack tiles[MAX_OPEN_TILES];
+    int tileX[MAX_OPEN_TILES], tileZ[MAX_OPEN_TILES];
+    unsigned tileUse[MAX_OPEN_TILES], tileClock;
+    float bordered[BORDERED_SAMPLES * BORDERED_SAMPLES];
+
+    int& windowSlot(int cx, int cz) {
+        return windowSlots[(cz % window) * window + cx % window];
+    }
+
+    const TerrainChunk* readyChunk(int cx, int cz) {
+        if (cx < 0 || cz < 0 || cx >= TERRAIN_CHUNKS || cz >= TERRAIN_CHUNKS)
+            return NULL;
+        int slot = windowSlot(cx, cz);
+        if (slot < 0)
+            return NULL;
+        const TerrainChunk& c = chunks[slot];
+        return c.state == CHUNK_READY && c.cx == cx && c.cz == cz ? &c : NULL;
+    }
+
+    void submit(const int* slots, int count) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < count; i++) {
+                requests[(requestHead + requestCount) % requests.size()] = slots[i];
+                requestCount++;
+            }
+        }
+        wake.notify_one();
+    }
+
+    void loadChunks() {
+        for (;;) {
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || requestCount > 0; });
+                if (stopping)
+                    return;
+                slot = requests[requestHead];
+                requestHead = (requestHead + 1) % (int)requests.size();
+                requestCount--;
+            }
+            loadChunk(chunks[slot]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done[(doneHead + doneCount) % done.size()] = slot;
+                doneCount++;
+            }
+        }
+    }
+
+    // the least recently used of the open tiles when this one is not open
+    AssetPack* openTile(int tx, int tz) {
+        tileClock++;
+        int oldest = 0;
+        for (int i = 0; i < MAX_OPEN_TILES; i++) {
+            if (tileX[i] == tx && tileZ[i] == tz) {
+                tileUse[i] = tileClock;
+                return tiles[i].isOpen() ? &tiles[i] : NULL;
+            }
+            if (tileUse[i] < tileUse[oldest])
+                oldest = i;
+        }
+        char path[512];
+        tilePath(path, sizeof(path), directory ? directory : ".", tx, tz);
+        // a missing tile is remembered too, so it is not looked for per chunk
+        if (!directory || !tiles[oldest].open(path))
+            tiles[oldest].close();
+        tileX[oldest] = tx;
+        tileZ[oldest] = tz;
+        tileUse[oldest] = tileClock;
+        return tiles[oldest].isOpen() ? &tiles[oldest] : NULL;
+    }
+
+    bool readTile(int cx, int cz) {
+        AssetPack* tile = openTile(cx / TILE_CHUNKS, cz / TILE_CHUNKS);
+        if (!tile)
+            return false;
+        char name[ASSET_NAME_LENGTH];
+        chunkName(name, sizeof(name), cx, cz);
+        size_t size = 0;
+        const TerrainChunkHeader* header = (const TerrainChunkHeader*)tile->find(name, &size);
+        if (!header || header->samples != BORDERED_SAMPLES
+            || size != sizeof(TerrainChunkHeader) + BORDERED_SAMPLES * BORDERED_SAMPLES * sizeof(unsigned short))
+            return false;
+        const unsigned short* values = (const unsigned short*)(header + 1);
+        for (int i = 0; i < BORDERED_SAMPLES * BORDERED_SAMPLES; i++)
+            bordered[i] = header->baseHeight + values[i] * header->heightStep;
+        return true;
+    }
+
+    void loadChunk(TerrainChunk& c) {
+        c.fromTile = readTile(c.cx, c.cz);
+        if (!c.fromTile)
+            generateBorderedHeights(c.cx, c.cz, bordered);
+        float spacing = CHUNK_SIZE / CHUNK_QUADS;
+        c.minHeight = c.maxHeight = bordered[BORDERED_SAMPLES + 1];
+        for (int j = 0; j < CHUNK_SAMPLES; j++) {
+            for (int i = 0; i < CHUNK_SAMPLES; i++) {
+                const float* h = &bordered[(j + 1) * BORDERED_SAMPLES + i + 1];
+                c.heights[j * CHUNK_SAMPLES + i] = *h;
+                c.minHeight = *h < c.minHeight ? *h : c.minHeight;
+                c.maxHeight = *h > c.maxHeight ? *h : c.maxHeight;
+                Vector3f n = Vector3f((h[-1] - h[1]) / (2 * spacing), 1, (h[-BORDERED_SAMPLES] - h[BORDERED_SAMPLES]) / (2 * spacing)).unit();
+                c.normals[j * CHUNK_SAMPLES + i][0] = n.x;
+                c.normals[j * CHUNK_SAMPLES + i][1] = n.y;
+                c.normals[j * CHUNK_SAMPLES + i][2] = n.z;
+            }
+        }
+    }
+
+    void buildVertices(const TerrainChunk& c, int level, float morph, TerrainVertex* out) const {
+        int step = 1 << level, n = CHUNK_QUADS >> level;
+        float spacing = CHUNK_SIZE / CHUNK_QUADS;
+        float x0 = chunkOrigin(c.cx), z0 = chunkOrigin(c.cz);
+        for (int j = 0; j <= n; j++) {
+            for (int i = 0; i <= n; i++) {
+                int s = j * step * CHUNK_SAMPLES + i * step;
+                float h = c.heights[s];
+                const float* normal = c.normals[s];
+                float nx = normal[0], ny = normal[1], nz = normal[2];
+                // in-between vertices slide onto the coarser level's edges,
+                // split along the same diagonal as the triangles
+                if (morph > 0 && ((i | j) & 1)) {
+                    int a, b;
+                    if ((i & 1) && (j & 1)) {
+                        a = s - step * CHUNK_SAMPLES - step;
+                        b = s + step * CHUNK_SAMPLES + step;
+                    }
+                    else if (i & 1) {
+                        a = s - step;
+                        b = s + step;
+                    }
+                    else {
+                        a = s - step * CHUNK_SAMPLES;
+                        b = s + step * CHUNK_SAMPLES;
+                    }
+                    h += ((c.heights[a] + c.heights[b]) / 2 - h) * morph;
+                    nx += ((c.normals[a][0] + c.normals[b][0]) / 2 - nx) * morph;
+                    ny += ((c.normals[a][1] + c.normals[b][1]) / 2 - ny) * morph;
+                    nz += ((c.normals[a][2] + c.normals[b][2]) / 2 - nz) * morph;
+                }
+                TerrainVertex& v = out[j * (n + 1) + i];
+                v.x = x0 + i * step * spacing;
+                v.y = h;
+                v.z = z0 + j * step * spacing;
+                v.nx = nx;
+                v.ny = ny;
+                v.nz = nz;
+            }
+        }
+        // skirts: the four edges again, hanging down
+        TerrainVertex* skirt = out + (n + 1) * (n + 1);
+        for (int k = 0; k <= n; k++) {
+            skirt[k] = out[k];
+            skirt[(n + 1) + k] = out[n * (n + 1) + k];
+            skirt[2 * (n + 1) + k] = out[k * (n + 1)];
+            skirt[3 * (n + 1) + k] = out[k * (n + 1) + n];
+        }
+        for (int k = 0; k < 4 * (n + 1); k++)
+            skirt[k].y -= TERRAIN_SKIRT;
+    }
+
+    void buildIndices(int level) {
+        int n = CHUNK_QUADS >> level;
+        std::vector<unsigned short>& out = indices[level];
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                unsigned short a = (unsigned short)(j * (n + 1) + i), b = (unsigned short)(a + 1);
+                unsigned short c = (unsigned short)(a + n + 1), d = (unsigned short)(c + 1);
+                out.push_back(a); out.push_back(c); out.push_back(d);
+                out.push_back(a); out.push_back(d); out.push_back(b);
+            }
+        }
+        // each edge vertex k joined to its skirt copy; the edges run along
+        // z = 0, z = n, x = 0 and x = n
+        int base = (n + 1) * (n + 1);
+        for (int e = 0; e < 4; e++) {
+            for (int k = 0; k < n; k++) {
+                unsigned short top0, top1;
+                if (e == 0) { top0 = (unsigned short)k; top1 = (unsigned short)(k + 1); }
+                else if (e == 1) { top0 = (unsigned short)(n * (n + 1) + k); top1 = (unsigned short)(top0 + 1); }
+                else if (e == 2) { top0 = (unsigned short)(k * (n + 1)); top1 = (unsigned short)((k + 1) * (n + 1)); }
+                else { top0 = (unsigned short)(k * (n + 1) + n); top1 = (unsigned short)((k + 1) * (n + 1) + n); }
+                unsigned short low0 = (unsigned short)(base + e * (n + 1) + k), low1 = (unsigned short)(low0 + 1);
+                out.push_back(top0); out.push_back(low0); out.push_back(low1);
+                out.push_back(top0); out.push_back(low1); out.push_back(top1);
+            }
+        }
+    }
+
+    TerrainStreamer(const TerrainStreamer&);
+    TerrainStreamer& operator=(const TerrainStreamer&);
+};
+
+#endif
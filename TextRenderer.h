@@ -0,0 +1,231 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <string.h>
+#include <glut.h>
+
+// Screen text from a glyph atlas. The GLUT bitmap font is rasterized once
+// into an alpha texture; every string is a slot whose quads are only laid
+// out again when its text, position or color changes. The slots' quads are
+// then packed into one array, drawn with a single glDrawArrays per frame.
+
+const int TEXT_SLOTS = 10;
+const int TEXT_SLOT_LENGTH = 128;
+const int TEXT_FIRST_GLYPH = 32;
+const int TEXT_GLYPH_COUNT = 95;
+const int TEXT_ATLAS_COLUMNS = 16;
+const int TEXT_CELL = 24;           // pixels per glyph cell
+const int TEXT_DESCENT = 6;         // baseline offset inside a cell
+const int TEXT_ATLAS_WIDTH = 512;
+const int TEXT_ATLAS_HEIGHT = 256;
+
+struct TextVertex {
+    float x, y, u, v;
+    unsigned char r, g, b, a;
+};
+
+class TextRenderer {
+public:
+    unsigned layouts;   // slots laid out again since start
+
+    TextRenderer() : layouts(0), texture(0), vertexCount(0), dirty(false) {
+        for (int i = 0; i < TEXT_SLOTS; i++) {
+            Slot& s = slots[i];
+            s.x = s.y = 0;
+            memset(s.color, 0, sizeof(s.color));
+            memset(s.text, 0, sizeof(s.text));
+            s.dirty = false;
+            s.vertexCount = 0;
+        }
+    }
+
+    bool ready() const {
+        return texture != 0;
+    }
+
+    // needs a visible window at least as big as the atlas; the caller
+    // redraws the frame afterwards
+    void init(void* font, int screenWidth, int screenHeight) {
+        int usedHeight = (TEXT_GLYPH_COUNT + TEXT_ATLAS_COLUMNS - 1) / TEXT_ATLAS_COLUMNS * TEXT_CELL;
+        int usedWidth = TEXT_ATLAS_COLUMNS * TEXT_CELL;
+
+        glPushAttrib(GL_ALL_ATTRIB_BITS);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0, screenWidth, 0, screenHeight, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_TEXTURE_2D);
+
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, usedWidth, usedHeight);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glColor3f(1, 1, 1);
+        for (int i = 0; i < TEXT_GLYPH_COUNT; i++) {
+            glRasterPos2i((i % TEXT_ATLAS_COLUMNS) * TEXT_CELL + 2, (i / TEXT_ATLAS_COLUMNS) * TEXT_CELL + TEXT_DESCENT);
+            glutBitmapCharacter(font, TEXT_FIRST_GLYPH + i);
+            advance[i] = (float)glutBitmapWidth(font, TEXT_FIRST_GLYPH + i);
+        }
+
+        static unsigned char atlas[TEXT_ATLAS_WIDTH * TEXT_ATLAS_HEIGHT];
+        memset(atlas, 0, sizeof(atlas));
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_PACK_ROW_LENGTH, TEXT_ATLAS_WIDTH);
+        glReadPixels(0, 0, usedWidth, usedHeight, GL_RED, GL_UNSIGNED_BYTE, atlas);
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, TEXT_ATLAS_WIDTH, TEXT_ATLAS_HEIGHT, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas);
+
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+        for (int i = 0; i < TEXT_SLOTS; i++)
+            slots[i].dirty = true;
+        dirty = true;
+    }
+
+    void setText(int slot, float x, float y, float r, float g, float b, const char* text) {
+        Slot& s = slots[slot];
+        unsigned char color[3] = { (unsigned char)(r * 255), (unsigned char)(g * 255), (unsigned char)(b * 255) };
+        if (s.x == x && s.y == y && memcmp(s.color, color, 3) == 0 && strncmp(s.text, text, TEXT_SLOT_LENGTH - 1) == 0)
+            return;
+        s.x = x;
+        s.y = y;
+        memcpy(s.color, color, 3);
+        strncpy(s.text, text, TEXT_SLOT_LENGTH - 1);
+        s.text[TEXT_SLOT_LENGTH - 1] = '\0';
+        s.dirty = true;
+        dirty = true;
+    }
+
+    void clear(int slot) {
+        if (slots[slot].text[0] != '\0') {
+            slots[slot].text[0] = '\0';
+            slots[slot].dirty = true;
+            dirty = true;
+        }
+    }
+
+    float width(const char* text) const {
+        float w = 0;
+        for (const char* c = text; *c; c++)
+            w += glyphAdvance(*c);
+        return w;
+    }
+
+    // expects a pixel-space orthographic projection
+    void draw() {
+        if (!ready())
+            return;
+        if (dirty)
+            layout();
+        if (vertexCount == 0)
+            return;
+
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(TextVertex), &vertices[0].x);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), &vertices[0].u);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(TextVertex), &vertices[0].r);
+        glDrawArrays(GL_QUADS, 0, vertexCount);
+        glPopClientAttrib();
+
+        glPopAttrib();
+    }
+
+private:
+    struct Slot {
+        float x, y;
+        unsigned char color[3];
+        char text[TEXT_SLOT_LENGTH];
+        bool dirty;
+        int vertexCount;
+        TextVertex vertices[TEXT_SLOT_LENGTH * 4];
+    };
+
+    GLuint texture;
+    float advance[TEXT_GLYPH_COUNT];
+    Slot slots[TEXT_SLOTS];
+    TextVertex vertices[TEXT_SLOTS * TEXT_SLOT_LENGTH * 4];
+    int vertexCount;
+    bool dirty;
+
+    float glyphAdvance(char c) const {
+        int i = (unsigned char)c - TEXT_FIRST_GLYPH;
+        return i >= 0 && i < TEXT_GLYPH_COUNT ? advance[i] : 0.0f;
+    }
+
+    // lays out the slots that changed, then packs every slot's quads
+    void layout() {
+        vertexCount = 0;
+        for (int s = 0; s < TEXT_SLOTS; s++) {
+            Slot& slot = slots[s];
+            if (slot.dirty)
+                layoutSlot(slot);
+            memcpy(&vertices[vertexCount], slot.vertices, slot.vertexCount * sizeof(TextVertex));
+            vertexCount += slot.vertexCount;
+        }
+        dirty = false;
+    }
+
+    void layoutSlot(Slot& slot) {
+        slot.vertexCount = 0;
+        float penX = slot.x;
+        for (const char* c = slot.text; *c; c++) {
+            int i = (unsigned char)*c - TEXT_FIRST_GLYPH;
+            if (i < 0 || i >= TEXT_GLYPH_COUNT)
+                continue;
+            float x0 = penX - 2, y0 = slot.y - TEXT_DESCENT;
+            float x1 = x0 + TEXT_CELL, y1 = y0 + TEXT_CELL;
+            float u0 = (float)(i % TEXT_ATLAS_COLUMNS) * TEXT_CELL / TEXT_ATLAS_WIDTH;
+            float v0 = (float)(i / TEXT_ATLAS_COLUMNS) * TEXT_CELL / TEXT_ATLAS_HEIGHT;
+            float u1 = u0 + (float)TEXT_CELL / TEXT_ATLAS_WIDTH;
+            float v1 = v0 + (float)TEXT_CELL / TEXT_ATLAS_HEIGHT;
+            addVertex(slot, x0, y0, u0, v0);
+            addVertex(slot, x1, y0, u1, v0);
+            addVertex(slot, x1, y1, u1, v1);
+            addVertex(slot, x0, y1, u0, v1);
+            penX += advance[i];
+        }
+        if (slot.text[0] != '\0')
+            layouts++;
+        slot.dirty = false;
+    }
+
+    static void addVertex(Slot& slot, float x, float y, float u, float v) {
+        TextVertex& vertex = slot.vertices[slot.vertexCount++];
+        vertex.x = x;
+        vertex.y = y;
+        vertex.u = u;
+        vertex.v = v;
+        vertex.r = slot.color[0];
+        vertex.g = slot.color[1];
+        vertex.b = slot.color[2];
+        vertex.a = 255;
+    }
+};
+
+#endif